@@ -73,6 +73,31 @@ public:
 
     CV_WRAP virtual double getNoiseSigma() const = 0;
     CV_WRAP virtual void setNoiseSigma(double noiseSigma) = 0;
+
+    /**
+     * Saves the parameters and the learned per-pixel mixtures to a binary file.
+     * The model planes are stored raw after a fixed-size header, so restoring them
+     * costs about as much as reading the file.
+     */
+    CV_WRAP virtual void saveModel(const String& filename) const = 0;
+    //! Restores the state written by saveModel(); the next frame continues the learned model.
+    CV_WRAP virtual void loadModel(const String& filename) = 0;
+
+    /**
+     * Restricts processing to the non-zero pixels of the CV_8UC1 mask of the frame size.
+     * Pixels outside the mask are neither updated nor classified and are reported as
+     * background. An empty mask (the default) enables all pixels.
+     */
+    CV_WRAP virtual void setProcessingMask(InputArray mask) = 0;
+    CV_WRAP virtual void getProcessingMask(OutputArray mask) const = 0;
+
+    /**
+     * Sets the CV_32FC1 map of the frame size with per-pixel multipliers of the learning rate.
+     * Zero freezes the model of the pixel, which is then only classified. An empty map
+     * (the default) applies the same learning rate to all pixels.
+     */
+    CV_WRAP virtual void setLearningRateMap(InputArray rates) = 0;
+    CV_WRAP virtual void getLearningRateMap(OutputArray rates) const = 0;
 };
 
 CV_EXPORTS_W Ptr<BackgroundSubtractorMOG>
@@ -89,6 +114,7 @@ CV_EXPORTS_W Ptr<BackgroundSubtractorMOG>
 class CV_EXPORTS_W BackgroundSubtractorGMG : public BackgroundSubtractor
 {
 public:
+    //! changing the maximum number of features discards the learned model
     CV_WRAP virtual int getMaxFeatures() const = 0;
     CV_WRAP virtual void setMaxFeatures(int maxFeatures) = 0;
 
@@ -98,6 +124,9 @@ public:
     CV_WRAP virtual int getNumFrames() const = 0;
     CV_WRAP virtual void setNumFrames(int nframes) = 0;
 
+    //! each channel is quantized to nlevels + 1 values over [minVal, maxVal]; values outside
+    //! the range are clamped to it, so e.g. float values above maxVal all get the top level.
+    //! Changing the number of levels discards the learned model.
     CV_WRAP virtual int getQuantizationLevels() const = 0;
     CV_WRAP virtual void setQuantizationLevels(int nlevels) = 0;
 
@@ -118,11 +147,52 @@ public:
 
     CV_WRAP virtual double getMaxVal() const = 0;
     CV_WRAP virtual void setMaxVal(double val) = 0;
+
+    /**
+     * Saves the parameters and the per-pixel color histograms to a binary file.
+     * The histograms are stored raw after a fixed-size header, so restoring them
+     * costs about as much as reading the file.
+     */
+    CV_WRAP virtual void saveModel(const String& filename) const = 0;
+    //! Restores the state written by saveModel(), including the number of processed frames.
+    CV_WRAP virtual void loadModel(const String& filename) = 0;
+
+    /**
+     * Restricts processing to the non-zero pixels of the CV_8UC1 mask of the frame size.
+     * Pixels outside the mask are neither updated nor classified and are reported as
+     * background. An empty mask (the default) enables all pixels.
+     */
+    CV_WRAP virtual void setProcessingMask(InputArray mask) = 0;
+    CV_WRAP virtual void getProcessingMask(OutputArray mask) const = 0;
+
+    /**
+     * Sets the CV_32FC1 map of the frame size with per-pixel multipliers of the learning rate.
+     * Zero freezes the model of the pixel, which is then only classified. An empty map
+     * (the default) applies the same learning rate to all pixels.
+     */
+    CV_WRAP virtual void setLearningRateMap(InputArray rates) = 0;
+    CV_WRAP virtual void getLearningRateMap(OutputArray rates) const = 0;
 };
 
 CV_EXPORTS_W Ptr<BackgroundSubtractorGMG> createBackgroundSubtractorGMG(int initializationFrames=120,
                                                                         double decisionThreshold=0.8);                                  
 
+/**
+ * Updates several independent background models (one frame per model) in a single call.
+ * Row stripes of all the frames are scheduled on the thread pool together, so the dispatch
+ * overhead is paid once per batch and small frames of many streams still use all cores.
+ * Subtractors created by this module are processed this way; other ones fall back to
+ * a sequential apply() call.
+ * @param subtractors background subtractors, one per stream; the same subtractor
+ * must not be passed twice, as its streams would update one model concurrently
+ * @param images next frame of every stream
+ * @param fgmasks output foreground masks, one per stream
+ * @param learningRate learning rate passed to every subtractor, see BackgroundSubtractor::apply
+ */
+CV_EXPORTS void applyBatch(const std::vector<Ptr<BackgroundSubtractor> >& subtractors,
+                           InputArrayOfArrays images, OutputArrayOfArrays fgmasks,
+                           double learningRate=-1);
+
 }
 }
 
@@ -0,0 +1,142 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                          License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000, Intel Corporation, all rights reserved.
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+
+#include "precomp.hpp"
+
+namespace cv
+{
+namespace bgsegm
+{
+
+struct BatchStripe
+{
+    int stream;
+    Range rows;
+};
+
+class BatchInvoker : public ParallelLoopBody
+{
+public:
+    BatchInvoker(const std::vector<Ptr<ParallelLoopBody> >& bodies, const std::vector<BatchStripe>& stripes)
+        : bodies_(bodies), stripes_(stripes)
+    {
+    }
+
+    void operator() (const Range& range) const
+    {
+        for (int i = range.start; i < range.end; ++i)
+        {
+            const BatchStripe& stripe = stripes_[i];
+            (*bodies_[stripe.stream])(stripe.rows);
+        }
+    }
+
+private:
+    const std::vector<Ptr<ParallelLoopBody> >& bodies_;
+    const std::vector<BatchStripe>& stripes_;
+};
+
+void applyBatch(const std::vector<Ptr<BackgroundSubtractor> >& subtractors,
+                InputArrayOfArrays _images, OutputArrayOfArrays _fgmasks, double learningRate)
+{
+    std::vector<Mat> images;
+    _images.getMatVector(images);
+
+    const int nstreams = (int)subtractors.size();
+    CV_Assert((int)images.size() == nstreams);
+
+    // the stripes of all the streams run concurrently, a subtractor may appear only once
+    std::vector<BackgroundSubtractor*> distinct(nstreams);
+    for (int i = 0; i < nstreams; ++i)
+        distinct[i] = subtractors[i].get();
+    std::sort(distinct.begin(), distinct.end());
+    CV_Assert(std::adjacent_find(distinct.begin(), distinct.end()) == distinct.end());
+
+    _fgmasks.create(nstreams, 1, CV_8UC1);
+
+    std::vector<ParallelBackgroundSubtractor*> parallel(nstreams, (ParallelBackgroundSubtractor*)0);
+    std::vector<Ptr<ParallelLoopBody> > bodies(nstreams);
+    std::vector<Mat> fgmasks(nstreams);
+    std::vector<BatchStripe> stripes;
+
+    for (int i = 0; i < nstreams; ++i)
+    {
+        CV_Assert(!subtractors[i].empty());
+        const Mat& image = images[i];
+
+        _fgmasks.create(image.size(), CV_8UC1, i);
+        fgmasks[i] = _fgmasks.getMat(i);
+
+        parallel[i] = dynamic_cast<ParallelBackgroundSubtractor*>(subtractors[i].get());
+        if (!parallel[i])
+        {
+            subtractors[i]->apply(image, fgmasks[i], learningRate);
+            continue;
+        }
+
+        bodies[i] = parallel[i]->prepare(image, fgmasks[i], learningRate);
+
+        // same granularity as a single apply() call: about 64K pixels per stripe
+        int stripeRows = std::max((1 << 16) / std::max(image.cols, 1), 1);
+        for (int y = 0; y < image.rows; y += stripeRows)
+        {
+            BatchStripe stripe;
+            stripe.stream = i;
+            stripe.rows = Range(y, std::min(y + stripeRows, image.rows));
+            stripes.push_back(stripe);
+        }
+    }
+
+    parallel_for_(Range(0, (int)stripes.size()), BatchInvoker(bodies, stripes));
+
+    for (int i = 0; i < nstreams; ++i)
+    {
+        if (parallel[i])
+            parallel[i]->finish(fgmasks[i]);
+    }
+}
+
+}
+}
+
+/* End of file. */
@@ -41,6 +41,7 @@
 //M*/
 
 #include "precomp.hpp"
+#include "opencv2/core/utility.hpp"
 #include <float.h>
 
 // to make sure we can use these short names
@@ -69,7 +70,7 @@ static const double defaultVarThreshold = 2.5*2.5;
 static const double defaultNoiseSigma = 30*0.5;
 static const double defaultInitialWeight = 0.05;
 
-class BackgroundSubtractorMOGImpl : public BackgroundSubtractorMOG
+class BackgroundSubtractorMOGImpl : public BackgroundSubtractorMOG, public ParallelBackgroundSubtractor
 {
 public:
     //! the default constructor
@@ -104,6 +105,9 @@ public:
     //! the update operator
     virtual void apply(InputArray image, OutputArray fgmask, double learningRate=0);
 
+    virtual Ptr<ParallelLoopBody> prepare(const Mat& image, Mat& fgmask, double learningRate);
+    virtual void finish(Mat&) {}
+
     //! re-initiaization method
     virtual void initialize(Size _frameSize, int _frameType)
     {
@@ -141,6 +145,20 @@ public:
     virtual double getNoiseSigma() const { return noiseSigma; }
     virtual void setNoiseSigma(double _noiseSigma) { noiseSigma = _noiseSigma; }
 
+    virtual void getProcessingMask(OutputArray mask) const { processingMask.copyTo(mask); }
+    virtual void setProcessingMask(InputArray mask)
+    {
+        CV_Assert( mask.empty() || mask.type() == CV_8UC1 );
+        mask.getMat().copyTo(processingMask);
+    }
+
+    virtual void getLearningRateMap(OutputArray rates) const { learningRateMap.copyTo(rates); }
+    virtual void setLearningRateMap(InputArray rates)
+    {
+        CV_Assert( rates.empty() || rates.type() == CV_32FC1 );
+        rates.getMat().copyTo(learningRateMap);
+    }
+
     virtual void write(FileStorage& fs) const
     {
         fs << "name" << name_
@@ -159,6 +177,46 @@ public:
         noiseSigma = (double)fn["noiseSigma"];
     }
 
+    virtual void saveModel(const String& filename) const
+    {
+        BackgroundModelData data(BackgroundModelData::ALGO_MOG);
+        data.ints[0] = frameSize.width;
+        data.ints[1] = frameSize.height;
+        data.ints[2] = frameType;
+        data.ints[3] = nframes;
+        data.ints[4] = history;
+        data.ints[5] = nmixtures;
+        data.doubles[0] = varThreshold;
+        data.doubles[1] = backgroundRatio;
+        data.doubles[2] = noiseSigma;
+        data.mats.push_back(bgmodel);
+        saveBackgroundModel(filename, data);
+    }
+
+    virtual void loadModel(const String& filename)
+    {
+        BackgroundModelData data(BackgroundModelData::ALGO_MOG);
+        loadBackgroundModel(filename, data);
+
+        Size _frameSize(data.ints[0], data.ints[1]);
+        int _frameType = data.ints[2], _nmixtures = data.ints[5];
+        CV_Assert( data.mats.size() == 1 && _nmixtures > 0 );
+        const Mat& model = data.mats[0];
+        CV_Assert( model.empty() ||
+                   (model.type() == CV_32F && model.rows == 1 &&
+                    model.cols == _frameSize.area()*_nmixtures*(2 + 2*CV_MAT_CN(_frameType))) );
+
+        frameSize = _frameSize;
+        frameType = _frameType;
+        nframes = model.empty() ? 0 : data.ints[3];
+        history = data.ints[4];
+        nmixtures = _nmixtures;
+        varThreshold = data.doubles[0];
+        backgroundRatio = data.doubles[1];
+        noiseSigma = data.doubles[2];
+        bgmodel = model;
+    }
+
 protected:
     Size frameSize;
     int frameType;
@@ -169,298 +227,232 @@ protected:
     double varThreshold;
     double backgroundRatio;
     double noiseSigma;
+    Mat processingMask;
+    Mat learningRateMap;
     String name_;
 };
 
 
-template<typename VT> struct MixData
+template<int cn> struct MixData
 {
     float sortKey;
     float weight;
-    VT mean;
-    VT var;
+    float mean[cn];
+    float var[cn];
 };
 
-
-static void process8uC1( const Mat& image, Mat& fgmask, double learningRate,
-                         Mat& bgmodel, int nmixtures, double backgroundRatio,
-                         double varThreshold, double noiseSigma )
+template<int cn> class MOGInvoker : public ParallelLoopBody
 {
-    int x, y, k, k1, rows = image.rows, cols = image.cols;
-    float alpha = (float)learningRate, T = (float)backgroundRatio, vT = (float)varThreshold;
-    int K = nmixtures;
-    MixData<float>* mptr = (MixData<float>*)bgmodel.data;
-
-    const float w0 = (float)defaultInitialWeight;
-    const float sk0 = (float)(w0/(defaultNoiseSigma*2));
-    const float var0 = (float)(defaultNoiseSigma*defaultNoiseSigma*4);
-    const float minVar = (float)(noiseSigma*noiseSigma);
+public:
+    MOGInvoker( const Mat& _image, const Mat& _fgmask, const Mat& _bgmodel, const Mat& _processingMask,
+                const Mat& _learningRateMap, double learningRate,
+                int _nmixtures, double backgroundRatio, double varThreshold, double noiseSigma )
+        : image(_image), fgmask(_fgmask), bgmodel(_bgmodel), processingMask(_processingMask),
+          learningRateMap(_learningRateMap), K(_nmixtures)
+    {
+        alpha = (float)learningRate;
+        T = (float)backgroundRatio;
+        vT = (float)varThreshold;
+        w0 = (float)defaultInitialWeight;
+        sk0 = (float)(w0/(defaultNoiseSigma*2*std::sqrt((double)cn)));
+        var0 = (float)(defaultNoiseSigma*defaultNoiseSigma*4);
+        minVar = (float)(noiseSigma*noiseSigma);
+    }
 
-    for( y = 0; y < rows; y++ )
+    void operator()( const Range& range ) const
     {
-        const uchar* src = image.ptr<uchar>(y);
-        uchar* dst = fgmask.ptr<uchar>(y);
+        int x, y, cols = image.cols;
 
-        if( alpha > 0 )
+        for( y = range.start; y < range.end; y++ )
         {
-            for( x = 0; x < cols; x++, mptr += K )
-            {
-                float wsum = 0;
-                float pix = src[x];
-                int kHit = -1, kForeground = -1;
+            const uchar* src = image.ptr<uchar>(y);
+            uchar* dst = fgmask.ptr<uchar>(y);
+            const uchar* mask = processingMask.empty() ? 0 : processingMask.ptr<uchar>(y);
+            const float* rates = learningRateMap.empty() ? 0 : learningRateMap.ptr<float>(y);
+            MixData<cn>* mptr = (MixData<cn>*)bgmodel.data + (size_t)y*cols*K;
 
-                for( k = 0; k < K; k++ )
-                {
-                    float w = mptr[k].weight;
-                    wsum += w;
-                    if( w < FLT_EPSILON )
-                        break;
-                    float mu = mptr[k].mean;
-                    float var = mptr[k].var;
-                    float diff = pix - mu;
-                    float d2 = diff*diff;
-                    if( d2 < vT*var )
-                    {
-                        wsum -= w;
-                        float dw = alpha*(1.f - w);
-                        mptr[k].weight = w + dw;
-                        mptr[k].mean = mu + alpha*diff;
-                        var = std::max(var + alpha*(d2 - var), minVar);
-                        mptr[k].var = var;
-                        mptr[k].sortKey = w/std::sqrt(var);
-
-                        for( k1 = k-1; k1 >= 0; k1-- )
-                        {
-                            if( mptr[k1].sortKey >= mptr[k1+1].sortKey )
-                                break;
-                            std::swap( mptr[k1], mptr[k1+1] );
-                        }
-
-                        kHit = k1+1;
-                        break;
-                    }
-                }
-
-                if( kHit < 0 ) // no appropriate gaussian mixture found at all, remove the weakest mixture and create a new one
-                {
-                    kHit = k = std::min(k, K-1);
-                    wsum += w0 - mptr[k].weight;
-                    mptr[k].weight = w0;
-                    mptr[k].mean = pix;
-                    mptr[k].var = var0;
-                    mptr[k].sortKey = sk0;
-                }
-                else
-                    for( ; k < K; k++ )
-                        wsum += mptr[k].weight;
-
-                float wscale = 1.f/wsum;
-                wsum = 0;
-                for( k = 0; k < K; k++ )
+            for( x = 0; x < cols; x++, src += cn, mptr += K )
+            {
+                if( mask && !mask[x] )
                 {
-                    wsum += mptr[k].weight *= wscale;
-                    mptr[k].sortKey *= wscale;
-                    if( wsum > T && kForeground < 0 )
-                        kForeground = k+1;
+                    dst[x] = 0;
+                    continue;
                 }
 
-                dst[x] = (uchar)(-(kHit >= kForeground));
+                float a = rates ? std::min(std::max(alpha*rates[x], 0.f), 1.f) : alpha;
+                dst[x] = a > 0 ? updatePixel( src, mptr, a ) : classifyPixel( src, mptr );
             }
         }
-        else
+    }
+
+private:
+    // updates the mixtures of a single pixel and returns its foreground mask value
+    uchar updatePixel( const uchar* src, MixData<cn>* mptr, float a ) const
+    {
+        int k, k1, c;
+        float pix[cn], diff[cn];
+        float wsum = 0;
+        int kHit = -1, kForeground = -1;
+        for( c = 0; c < cn; c++ )
+            pix[c] = src[c];
+
+        for( k = 0; k < K; k++ )
         {
-            for( x = 0; x < cols; x++, mptr += K )
+            float w = mptr[k].weight;
+            wsum += w;
+            if( w < FLT_EPSILON )
+                break;
+            float* mu = mptr[k].mean;
+            float* var = mptr[k].var;
+            float d2 = 0, vsum = 0;
+            for( c = 0; c < cn; c++ )
             {
-                float pix = src[x];
-                int kHit = -1, kForeground = -1;
-
-                for( k = 0; k < K; k++ )
+                diff[c] = pix[c] - mu[c];
+                d2 += diff[c]*diff[c];
+                vsum += var[c];
+            }
+            if( d2 < vT*vsum )
+            {
+                wsum -= w;
+                float dw = a*(1.f - w);
+                mptr[k].weight = w + dw;
+                vsum = 0;
+                for( c = 0; c < cn; c++ )
                 {
-                    if( mptr[k].weight < FLT_EPSILON )
-                        break;
-                    float mu = mptr[k].mean;
-                    float var = mptr[k].var;
-                    float diff = pix - mu;
-                    float d2 = diff*diff;
-                    if( d2 < vT*var )
-                    {
-                        kHit = k;
-                        break;
-                    }
+                    mu[c] = mu[c] + a*diff[c];
+                    var[c] = std::max(var[c] + a*(diff[c]*diff[c] - var[c]), minVar);
+                    vsum += var[c];
                 }
+                mptr[k].sortKey = w/std::sqrt(vsum);
 
-                if( kHit >= 0 )
+                for( k1 = k-1; k1 >= 0; k1-- )
                 {
-                    float wsum = 0;
-                    for( k = 0; k < K; k++ )
-                    {
-                        wsum += mptr[k].weight;
-                        if( wsum > T )
-                        {
-                            kForeground = k+1;
-                            break;
-                        }
-                    }
+                    if( mptr[k1].sortKey >= mptr[k1+1].sortKey )
+                        break;
+                    std::swap( mptr[k1], mptr[k1+1] );
                 }
 
-                dst[x] = (uchar)(kHit < 0 || kHit >= kForeground ? 255 : 0);
+                kHit = k1+1;
+                break;
             }
         }
-    }
-}
 
+        if( kHit < 0 ) // no appropriate gaussian mixture found at all, remove the weakest mixture and create a new one
+        {
+            kHit = k = std::min(k, K-1);
+            wsum += w0 - mptr[k].weight;
+            mptr[k].weight = w0;
+            for( c = 0; c < cn; c++ )
+            {
+                mptr[k].mean[c] = pix[c];
+                mptr[k].var[c] = var0;
+            }
+            mptr[k].sortKey = sk0;
+        }
+        else
+            for( ; k < K; k++ )
+                wsum += mptr[k].weight;
 
-static void process8uC3( const Mat& image, Mat& fgmask, double learningRate,
-                         Mat& bgmodel, int nmixtures, double backgroundRatio,
-                         double varThreshold, double noiseSigma )
-{
-    int x, y, k, k1, rows = image.rows, cols = image.cols;
-    float alpha = (float)learningRate, T = (float)backgroundRatio, vT = (float)varThreshold;
-    int K = nmixtures;
+        float wscale = 1.f/wsum;
+        wsum = 0;
+        for( k = 0; k < K; k++ )
+        {
+            wsum += mptr[k].weight *= wscale;
+            mptr[k].sortKey *= wscale;
+            if( wsum > T && kForeground < 0 )
+                kForeground = k+1;
+        }
 
-    const float w0 = (float)defaultInitialWeight;
-    const float sk0 = (float)(w0/(defaultNoiseSigma*2*std::sqrt(3.)));
-    const float var0 = (float)(defaultNoiseSigma*defaultNoiseSigma*4);
-    const float minVar = (float)(noiseSigma*noiseSigma);
-    MixData<Vec3f>* mptr = (MixData<Vec3f>*)bgmodel.data;
+        return (uchar)(-(kHit >= kForeground));
+    }
 
-    for( y = 0; y < rows; y++ )
+    // classifies a single pixel without updating the model
+    uchar classifyPixel( const uchar* src, const MixData<cn>* mptr ) const
     {
-        const uchar* src = image.ptr<uchar>(y);
-        uchar* dst = fgmask.ptr<uchar>(y);
+        int k, c;
+        int kHit = -1, kForeground = -1;
 
-        if( alpha > 0 )
+        for( k = 0; k < K; k++ )
         {
-            for( x = 0; x < cols; x++, mptr += K )
+            if( mptr[k].weight < FLT_EPSILON )
+                break;
+            float d2 = 0, vsum = 0;
+            for( c = 0; c < cn; c++ )
             {
-                float wsum = 0;
-                Vec3f pix(src[x*3], src[x*3+1], src[x*3+2]);
-                int kHit = -1, kForeground = -1;
-
-                for( k = 0; k < K; k++ )
-                {
-                    float w = mptr[k].weight;
-                    wsum += w;
-                    if( w < FLT_EPSILON )
-                        break;
-                    Vec3f mu = mptr[k].mean;
-                    Vec3f var = mptr[k].var;
-                    Vec3f diff = pix - mu;
-                    float d2 = diff.dot(diff);
-                    if( d2 < vT*(var[0] + var[1] + var[2]) )
-                    {
-                        wsum -= w;
-                        float dw = alpha*(1.f - w);
-                        mptr[k].weight = w + dw;
-                        mptr[k].mean = mu + alpha*diff;
-                        var = Vec3f(std::max(var[0] + alpha*(diff[0]*diff[0] - var[0]), minVar),
-                                    std::max(var[1] + alpha*(diff[1]*diff[1] - var[1]), minVar),
-                                    std::max(var[2] + alpha*(diff[2]*diff[2] - var[2]), minVar));
-                        mptr[k].var = var;
-                        mptr[k].sortKey = w/std::sqrt(var[0] + var[1] + var[2]);
-
-                        for( k1 = k-1; k1 >= 0; k1-- )
-                        {
-                            if( mptr[k1].sortKey >= mptr[k1+1].sortKey )
-                                break;
-                            std::swap( mptr[k1], mptr[k1+1] );
-                        }
-
-                        kHit = k1+1;
-                        break;
-                    }
-                }
-
-                if( kHit < 0 ) // no appropriate gaussian mixture found at all, remove the weakest mixture and create a new one
-                {
-                    kHit = k = std::min(k, K-1);
-                    wsum += w0 - mptr[k].weight;
-                    mptr[k].weight = w0;
-                    mptr[k].mean = pix;
-                    mptr[k].var = Vec3f(var0, var0, var0);
-                    mptr[k].sortKey = sk0;
-                }
-                else
-                    for( ; k < K; k++ )
-                        wsum += mptr[k].weight;
-
-                float wscale = 1.f/wsum;
-                wsum = 0;
-                for( k = 0; k < K; k++ )
-                {
-                    wsum += mptr[k].weight *= wscale;
-                    mptr[k].sortKey *= wscale;
-                    if( wsum > T && kForeground < 0 )
-                        kForeground = k+1;
-                }
-
-                dst[x] = (uchar)(-(kHit >= kForeground));
+                float d = (float)src[c] - mptr[k].mean[c];
+                d2 += d*d;
+                vsum += mptr[k].var[c];
+            }
+            if( d2 < vT*vsum )
+            {
+                kHit = k;
+                break;
             }
         }
-        else
+
+        if( kHit >= 0 )
         {
-            for( x = 0; x < cols; x++, mptr += K )
+            float wsum = 0;
+            for( k = 0; k < K; k++ )
             {
-                Vec3f pix(src[x*3], src[x*3+1], src[x*3+2]);
-                int kHit = -1, kForeground = -1;
-
-                for( k = 0; k < K; k++ )
+                wsum += mptr[k].weight;
+                if( wsum > T )
                 {
-                    if( mptr[k].weight < FLT_EPSILON )
-                        break;
-                    Vec3f mu = mptr[k].mean;
-                    Vec3f var = mptr[k].var;
-                    Vec3f diff = pix - mu;
-                    float d2 = diff.dot(diff);
-                    if( d2 < vT*(var[0] + var[1] + var[2]) )
-                    {
-                        kHit = k;
-                        break;
-                    }
+                    kForeground = k+1;
+                    break;
                 }
-
-                if( kHit >= 0 )
-                {
-                    float wsum = 0;
-                    for( k = 0; k < K; k++ )
-                    {
-                        wsum += mptr[k].weight;
-                        if( wsum > T )
-                        {
-                            kForeground = k+1;
-                            break;
-                        }
-                    }
-                }
-
-                dst[x] = (uchar)(kHit < 0 || kHit >= kForeground ? 255 : 0);
             }
         }
+
+        return (uchar)(kHit < 0 || kHit >= kForeground ? 255 : 0);
     }
-}
+
+    Mat image;
+    mutable Mat fgmask;
+    mutable Mat bgmodel;
+    Mat processingMask;
+    Mat learningRateMap;
+    int K;
+    float alpha, T, vT;
+    float w0, sk0, var0, minVar;
+};
 
 void BackgroundSubtractorMOGImpl::apply(InputArray _image, OutputArray _fgmask, double learningRate)
 {
     Mat image = _image.getMat();
+    _fgmask.create( image.size(), CV_8U );
+    Mat fgmask = _fgmask.getMat();
+
+    Ptr<ParallelLoopBody> body = prepare( image, fgmask, learningRate );
+    parallel_for_( Range(0, image.rows), *body, image.total()/(double)(1 << 16) );
+    finish( fgmask );
+}
+
+Ptr<ParallelLoopBody> BackgroundSubtractorMOGImpl::prepare(const Mat& image, Mat& fgmask, double learningRate)
+{
     bool needToInitialize = nframes == 0 || learningRate >= 1 || image.size() != frameSize || image.type() != frameType;
 
     if( needToInitialize )
         initialize(image.size(), image.type());
 
     CV_Assert( image.depth() == CV_8U );
-    _fgmask.create( image.size(), CV_8U );
-    Mat fgmask = _fgmask.getMat();
+    CV_Assert( fgmask.size() == image.size() && fgmask.type() == CV_8UC1 );
+    CV_Assert( processingMask.empty() || processingMask.size() == image.size() );
+    CV_Assert( learningRateMap.empty() || learningRateMap.size() == image.size() );
 
     ++nframes;
     learningRate = learningRate >= 0 && nframes > 1 ? learningRate : 1./std::min( nframes, history );
     CV_Assert(learningRate >= 0);
 
     if( image.type() == CV_8UC1 )
-        process8uC1( image, fgmask, learningRate, bgmodel, nmixtures, backgroundRatio, varThreshold, noiseSigma );
+        return makePtr<MOGInvoker<1> >(image, fgmask, bgmodel, processingMask, learningRateMap,
+                                       learningRate, nmixtures, backgroundRatio, varThreshold, noiseSigma);
     else if( image.type() == CV_8UC3 )
-        process8uC3( image, fgmask, learningRate, bgmodel, nmixtures, backgroundRatio, varThreshold, noiseSigma );
-    else
-        CV_Error( Error::StsUnsupportedFormat, "Only 1- and 3-channel 8-bit images are supported in BackgroundSubtractorMOG" );
+        return makePtr<MOGInvoker<3> >(image, fgmask, bgmodel, processingMask, learningRateMap,
+                                       learningRate, nmixtures, backgroundRatio, varThreshold, noiseSigma);
+
+    CV_Error( Error::StsUnsupportedFormat, "Only 1- and 3-channel 8-bit images are supported in BackgroundSubtractorMOG" );
+    return Ptr<ParallelLoopBody>();
 }
 
 Ptr<BackgroundSubtractorMOG> createBackgroundSubtractorMOG(int history, int nmixtures,
@@ -57,7 +57,7 @@ namespace cv
 namespace bgsegm
 {
 
-class BackgroundSubtractorGMGImpl : public BackgroundSubtractorGMG
+class BackgroundSubtractorGMGImpl : public BackgroundSubtractorGMG, public ParallelBackgroundSubtractor
 {
 public:
     BackgroundSubtractorGMGImpl()
@@ -74,6 +74,7 @@ public:
         smoothingRadius = 7;
         updateBackgroundModel = true;
         minVal_ = maxVal_ = 0;
+        channels_ = 0;
         name_ = "BackgroundSubtractor.GMG";
     }
 
@@ -87,10 +88,11 @@ public:
      * Validate parameters and set up data structures for appropriate image size.
      * Must call before running on data.
      * @param frameSize input frame size
+     * @param channels  number of channels of the input frames
      * @param min       minimum value taken on by pixels in image sequence. Usually 0
      * @param max       maximum value taken on by pixels in image sequence. e.g. 1.0 or 255
      */
-    void initialize(Size frameSize, double minVal, double maxVal);
+    void initialize(Size frameSize, int channels, double minVal, double maxVal);
 
     /**
      * Performs single-frame background subtraction and builds up a statistical background image
@@ -100,13 +102,22 @@ public:
      */
     virtual void apply(InputArray image, OutputArray fgmask, double learningRate=-1.0);
 
+    virtual Ptr<ParallelLoopBody> prepare(const Mat& image, Mat& fgmask, double learningRate);
+    virtual void finish(Mat& fgmask);
+
     /**
      * Releases all inner buffers.
      */
     void release();
 
     virtual int getMaxFeatures() const { return maxFeatures; }
-    virtual void setMaxFeatures(int _maxFeatures) { maxFeatures = _maxFeatures; }
+    virtual void setMaxFeatures(int _maxFeatures)
+    {
+        // the model is laid out for the old value, it is rebuilt by the next frame
+        if (_maxFeatures != maxFeatures)
+            release();
+        maxFeatures = _maxFeatures;
+    }
 
     virtual double getDefaultLearningRate() const { return learningRate; }
     virtual void setDefaultLearningRate(double lr) { learningRate = lr; }
@@ -115,7 +126,13 @@ public:
     virtual void setNumFrames(int nframes) { numInitializationFrames = nframes; }
 
     virtual int getQuantizationLevels() const { return quantizationLevels; }
-    virtual void setQuantizationLevels(int nlevels) { quantizationLevels = nlevels; }
+    virtual void setQuantizationLevels(int nlevels)
+    {
+        // the colors and their storage width depend on the levels, as for setMaxFeatures
+        if (nlevels != quantizationLevels)
+            release();
+        quantizationLevels = nlevels;
+    }
 
     virtual double getBackgroundPrior() const { return backgroundPrior; }
     virtual void setBackgroundPrior(double bgprior) { backgroundPrior = bgprior; }
@@ -135,6 +152,20 @@ public:
     virtual double getMaxVal() const  { return maxVal_; }
     virtual void setMaxVal(double val)  { maxVal_ = val; }
 
+    virtual void getProcessingMask(OutputArray mask) const { processingMask_.copyTo(mask); }
+    virtual void setProcessingMask(InputArray mask)
+    {
+        CV_Assert(mask.empty() || mask.type() == CV_8UC1);
+        mask.getMat().copyTo(processingMask_);
+    }
+
+    virtual void getLearningRateMap(OutputArray rates) const { learningRateMap_.copyTo(rates); }
+    virtual void setLearningRateMap(InputArray rates)
+    {
+        CV_Assert(rates.empty() || rates.type() == CV_32FC1);
+        rates.getMat().copyTo(learningRateMap_);
+    }
+
     virtual void getBackgroundImage(OutputArray backgroundImage) const
     {
         backgroundImage.release();
@@ -167,8 +198,12 @@ public:
         updateBackgroundModel = (int)fn["updateBackgroundModel"] != 0;
         minVal_ = maxVal_ = 0;
         frameSize_ = Size();
+        channels_ = 0;
     }
 
+    virtual void saveModel(const String& filename) const;
+    virtual void loadModel(const String& filename);
+
     //! Total number of distinct colors to maintain in histogram.
     int     maxFeatures;
     //! Set between 0.0 and 1.0, determines how quickly features are "forgotten" from histograms.
@@ -191,19 +226,41 @@ private:
     double minVal_;
 
     Size frameSize_;
+    int channels_;
     int frameNum_;
 
     String name_;
 
     Mat_<int> nfeatures_;
-    Mat_<unsigned int> colors_;
+    //! start of the ring of features of each pixel, see insertFeature()
+    Mat_<int> firstFeature_;
+    //! quantized colors, CV_16UC1 when they fit into 16 bits, CV_32SC1 otherwise
+    Mat colors_;
     Mat_<float> weights_;
 
     Mat buf_;
+
+    Mat processingMask_;
+    Mat learningRateMap_;
 };
 
 
-void BackgroundSubtractorGMGImpl::initialize(Size frameSize, double minVal, double maxVal)
+// Number of features of a histogram row, rounded up so that the SIMD lookup
+// can always load whole vectors without leaving the row.
+static int featuresStride(int maxFeatures)
+{
+    return (int)alignSize(maxFeatures, 8);
+}
+
+// Returns true if the quantized colors of a frame with the given number of channels
+// can be packed into 16 bits.
+static bool useShortColors(int channels, int quantizationLevels)
+{
+    double ncolors = std::pow((double)quantizationLevels + 1, (double)channels);
+    return ncolors <= (double)std::numeric_limits<ushort>::max() + 1;
+}
+
+void BackgroundSubtractorGMGImpl::initialize(Size frameSize, int channels, double minVal, double maxVal)
 {
     CV_Assert(minVal < maxVal);
     CV_Assert(maxFeatures > 0);
@@ -211,36 +268,119 @@ void BackgroundSubtractorGMGImpl::initialize(Size frameSize, double minVal, doub
     CV_Assert(numInitializationFrames >= 1);
     CV_Assert(quantizationLevels >= 1 && quantizationLevels <= 255);
     CV_Assert(backgroundPrior >= 0.0 && backgroundPrior <= 1.0);
+    CV_Assert(channels >= 1 && channels <= 4);
 
     minVal_ = minVal;
     maxVal_ = maxVal;
 
     frameSize_ = frameSize;
+    channels_ = channels;
     frameNum_ = 0;
 
+    int stride = featuresStride(maxFeatures);
+
     nfeatures_.create(frameSize_);
-    colors_.create(frameSize_.area(), maxFeatures);
-    weights_.create(frameSize_.area(), maxFeatures);
+    firstFeature_.create(frameSize_);
+    colors_.create(frameSize_.area(), stride, useShortColors(channels, quantizationLevels) ? CV_16UC1 : CV_32SC1);
+    weights_.create(frameSize_.area(), stride);
 
     nfeatures_.setTo(Scalar::all(0));
+    firstFeature_.setTo(Scalar::all(0));
+    // the padding after the last feature is read (but ignored) by the vectorized lookup
+    colors_.setTo(Scalar::all(0));
+}
+
+static inline int lowestSetBit(int mask)
+{
+    int idx = 0;
+    while (!(mask & 1))
+    {
+        mask >>= 1;
+        ++idx;
+    }
+    return idx;
 }
 
-static float findFeature(unsigned int color, const unsigned int* colors, const float* weights, int nfeatures)
+/**
+ * Returns position of the color in the histogram or -1 if it is not there.
+ * The colors array must be readable up to featuresStride(nfeatures) elements.
+ */
+template <typename CT> static int findFeature(CT color, const CT* colors, int nfeatures, bool useSIMD);
+
+template <> int findFeature<ushort>(ushort color, const ushort* colors, int nfeatures, bool useSIMD)
 {
-    for (int i = 0; i < nfeatures; ++i)
+    int i = 0;
+
+#if CV_SSE2
+    if (useSIMD)
+    {
+        __m128i c8 = _mm_set1_epi16((short)color);
+        for (; i < nfeatures; i += 8)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(colors + i));
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(v, c8));
+            if (mask)
+            {
+                // the first match may be in the unused tail of the last vector
+                int idx = i + lowestSetBit(mask) / 2;
+                return idx < nfeatures ? idx : -1;
+            }
+        }
+        return -1;
+    }
+#else
+    (void)useSIMD;
+#endif
+
+    for (; i < nfeatures; ++i)
+    {
+        if (color == colors[i])
+            return i;
+    }
+
+    return -1;
+}
+
+template <> int findFeature<unsigned int>(unsigned int color, const unsigned int* colors, int nfeatures, bool useSIMD)
+{
+    int i = 0;
+
+#if CV_SSE2
+    if (useSIMD)
+    {
+        __m128i c4 = _mm_set1_epi32((int)color);
+        for (; i < nfeatures; i += 4)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(colors + i));
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi32(v, c4));
+            if (mask)
+            {
+                int idx = i + lowestSetBit(mask) / 4;
+                return idx < nfeatures ? idx : -1;
+            }
+        }
+        return -1;
+    }
+#else
+    (void)useSIMD;
+#endif
+
+    for (; i < nfeatures; ++i)
     {
         if (color == colors[i])
-            return weights[i];
+            return i;
     }
 
-    // not in histogram, so return 0.
-    return 0.0f;
+    return -1;
 }
 
-static void normalizeHistogram(float* weights, int nfeatures)
+static void normalizeHistogram(float* weights, int nfeatures, int first)
 {
+    // summed from the most recent feature, as the ring is ordered
     float total = 0.0f;
-    for (int i = 0; i < nfeatures; ++i)
+    for (int i = first; i < nfeatures; ++i)
+        total += weights[i];
+    for (int i = 0; i < first; ++i)
         total += weights[i];
 
     if (total != 0.0f)
@@ -250,39 +390,43 @@ static void normalizeHistogram(float* weights, int nfeatures)
     }
 }
 
-static bool insertFeature(unsigned int color, float weight, unsigned int* colors, float* weights, int& nfeatures, int maxFeatures)
+/**
+ * Adds weight to the color bin. The features are kept most recently seen first,
+ * as a ring of maxFeatures entries starting at position 'first'. The ring only
+ * wraps once the histogram is full, so the used entries are always the positions
+ * [0, nfeatures). A hit moves the feature to the front shifting only the features
+ * before it; a new feature in a full histogram replaces the oldest one, which is
+ * right before the start of the ring, by moving the start back.
+ * Returns true if the number of features has grown.
+ */
+template <typename CT>
+static bool insertFeature(CT color, float weight, CT* colors, float* weights, int& nfeatures, int& first, int maxFeatures, bool useSIMD)
 {
-    int idx = -1;
-    for (int i = 0; i < nfeatures; ++i)
-    {
-        if (color == colors[i])
-        {
-            // feature in histogram
-            weight += weights[i];
-            idx = i;
-            break;
-        }
-    }
+    int idx = findFeature(color, colors, nfeatures, useSIMD);
 
     if (idx >= 0)
     {
-        // move feature to beginning of list
+        // feature in histogram, move it to the beginning of the list
 
-        ::memmove(colors + 1, colors, idx * sizeof(unsigned int));
-        ::memmove(weights + 1, weights, idx * sizeof(float));
+        weight += weights[idx];
+        for (int i = idx; i != first; )
+        {
+            int prev = i == 0 ? maxFeatures - 1 : i - 1;
+            colors[i] = colors[prev];
+            weights[i] = weights[prev];
+            i = prev;
+        }
 
-        colors[0] = color;
-        weights[0] = weight;
+        colors[first] = color;
+        weights[first] = weight;
     }
     else if (nfeatures == maxFeatures)
     {
         // discard oldest feature
 
-        ::memmove(colors + 1, colors, (nfeatures - 1) * sizeof(unsigned int));
-        ::memmove(weights + 1, weights, (nfeatures - 1) * sizeof(float));
-
-        colors[0] = color;
-        weights[0] = weight;
+        first = first == 0 ? maxFeatures - 1 : first - 1;
+        colors[first] = color;
+        weights[first] = weight;
     }
     else
     {
@@ -297,6 +441,11 @@ static bool insertFeature(unsigned int color, float weight, unsigned int* colors
     return false;
 }
 
+/**
+ * Packs the quantized channel values into a single mixed-radix number with
+ * (quantizationLevels + 1) values per channel. Values outside [minVal, maxVal]
+ * are clamped to the first or the last level.
+ */
 template <typename T> struct Quantization
 {
     static unsigned int apply(const void* src_, int x, int cn, double minVal, double maxVal, int quantizationLevels)
@@ -305,8 +454,11 @@ template <typename T> struct Quantization
         src += x * cn;
 
         unsigned int res = 0;
-        for (int i = 0, shift = 0; i < cn; ++i, ++src, shift += 8)
-            res |= static_cast<int>((*src - minVal) * quantizationLevels / (maxVal - minVal)) << shift;
+        for (int i = cn - 1; i >= 0; --i)
+        {
+            int q = static_cast<int>((src[i] - minVal) * quantizationLevels / (maxVal - minVal));
+            res = res * (quantizationLevels + 1) + std::min(std::max(q, 0), quantizationLevels);
+        }
 
         return res;
     }
@@ -315,27 +467,39 @@ template <typename T> struct Quantization
 class GMG_LoopBody : public ParallelLoopBody
 {
 public:
-    GMG_LoopBody(const Mat& frame, const Mat& fgmask, const Mat_<int>& nfeatures, const Mat_<unsigned int>& colors, const Mat_<float>& weights,
+    GMG_LoopBody(const Mat& frame, const Mat& fgmask, const Mat_<int>& nfeatures, const Mat_<int>& firstFeature, const Mat& colors, const Mat_<float>& weights,
+                 const Mat& processingMask, const Mat& learningRateMap,
                  int maxFeatures, double learningRate, int numInitializationFrames, int quantizationLevels, double backgroundPrior, double decisionThreshold,
                  double maxVal, double minVal, int frameNum, bool updateBackgroundModel) :
-        frame_(frame), fgmask_(fgmask), nfeatures_(nfeatures), colors_(colors), weights_(weights),
+        frame_(frame), fgmask_(fgmask), nfeatures_(nfeatures), firstFeature_(firstFeature), colors_(colors), weights_(weights),
+        processingMask_(processingMask), learningRateMap_(learningRateMap),
         maxFeatures_(maxFeatures), learningRate_(learningRate), numInitializationFrames_(numInitializationFrames), quantizationLevels_(quantizationLevels),
         backgroundPrior_(backgroundPrior), decisionThreshold_(decisionThreshold), updateBackgroundModel_(updateBackgroundModel),
         maxVal_(maxVal), minVal_(minVal), frameNum_(frameNum)
     {
+        useSIMD_ = false;
+#if CV_SSE2
+        useSIMD_ = checkHardwareSupport(CV_CPU_SSE2);
+#endif
     }
 
     void operator() (const Range& range) const;
 
 private:
+    template <typename CT> void process(const Range& range) const;
+
     Mat frame_;
 
     mutable Mat_<uchar> fgmask_;
 
     mutable Mat_<int> nfeatures_;
-    mutable Mat_<unsigned int> colors_;
+    mutable Mat_<int> firstFeature_;
+    mutable Mat colors_;
     mutable Mat_<float> weights_;
 
+    Mat processingMask_;
+    Mat learningRateMap_;
+
     int     maxFeatures_;
     double  learningRate_;
     int     numInitializationFrames_;
@@ -347,9 +511,18 @@ private:
     double maxVal_;
     double minVal_;
     int frameNum_;
+    bool useSIMD_;
 };
 
 void GMG_LoopBody::operator() (const Range& range) const
+{
+    if (colors_.type() == CV_16UC1)
+        process<ushort>(range);
+    else
+        process<unsigned int>(range);
+}
+
+template <typename CT> void GMG_LoopBody::process(const Range& range) const
 {
     typedef unsigned int (*func_t)(const void* src_, int x, int cn, double minVal, double maxVal, int quantizationLevels);
     static const func_t funcs[] =
@@ -372,15 +545,29 @@ void GMG_LoopBody::operator() (const Range& range) const
     {
         const uchar* frame_row = frame_.ptr(y);
         int* nfeatures_row = nfeatures_[y];
+        int* first_row = firstFeature_[y];
         uchar* fgmask_row = fgmask_[y];
+        const uchar* mask_row = processingMask_.empty() ? 0 : processingMask_.ptr<uchar>(y);
+        const float* rates_row = learningRateMap_.empty() ? 0 : learningRateMap_.ptr<float>(y);
 
         for (int x = 0; x < frame_.cols; ++x, ++featureIdx)
         {
+            if (mask_row && !mask_row[x])
+            {
+                // pixel is not processed at all
+                fgmask_row[x] = 0;
+                continue;
+            }
+
+            // zero rate freezes the model of the pixel
+            const double learningRate = rates_row ? std::min(std::max(learningRate_ * rates_row[x], 0.0), 1.0) : learningRate_;
+            const bool updateModel = updateBackgroundModel_ && (!rates_row || rates_row[x] > 0);
+
             int nfeatures = nfeatures_row[x];
-            unsigned int* colors = colors_[featureIdx];
+            CT* colors = colors_.ptr<CT>(featureIdx);
             float* weights = weights_[featureIdx];
 
-            unsigned int newFeatureColor = func(frame_row, x, cn, minVal_, maxVal_, quantizationLevels_);
+            CT newFeatureColor = (CT)func(frame_row, x, cn, minVal_, maxVal_, quantizationLevels_);
 
             bool isForeground = false;
 
@@ -388,7 +575,8 @@ void GMG_LoopBody::operator() (const Range& range) const
             {
                 // typical operation
 
-                const double weight = findFeature(newFeatureColor, colors, weights, nfeatures);
+                const int idx = findFeature(newFeatureColor, colors, nfeatures, useSIMD_);
+                const double weight = idx >= 0 ? weights[idx] : 0.0; // not in histogram, so 0
 
                 // see Godbehere, Matsukawa, Goldberg (2012) for reasoning behind this implementation of Bayes rule
                 const double posterior = (weight * backgroundPrior_) / (weight * backgroundPrior_ + (1.0 - weight) * (1.0 - backgroundPrior_));
@@ -397,28 +585,28 @@ void GMG_LoopBody::operator() (const Range& range) const
 
                 // update histogram.
 
-                if (updateBackgroundModel_)
+                if (updateModel)
                 {
                     for (int i = 0; i < nfeatures; ++i)
-                        weights[i] *= (float)(1.0f - learningRate_);
+                        weights[i] *= (float)(1.0f - learningRate);
 
-                    bool inserted = insertFeature(newFeatureColor, (float)learningRate_, colors, weights, nfeatures, maxFeatures_);
+                    bool inserted = insertFeature(newFeatureColor, (float)learningRate, colors, weights, nfeatures, first_row[x], maxFeatures_, useSIMD_);
 
                     if (inserted)
                     {
-                        normalizeHistogram(weights, nfeatures);
+                        normalizeHistogram(weights, nfeatures, first_row[x]);
                         nfeatures_row[x] = nfeatures;
                     }
                 }
             }
-            else if (updateBackgroundModel_)
+            else if (updateModel)
             {
                 // training-mode update
 
-                insertFeature(newFeatureColor, 1.0f, colors, weights, nfeatures, maxFeatures_);
+                insertFeature(newFeatureColor, 1.0f, colors, weights, nfeatures, first_row[x], maxFeatures_, useSIMD_);
 
                 if (frameNum_ == numInitializationFrames_ - 1)
-                    normalizeHistogram(weights, nfeatures);
+                    normalizeHistogram(weights, nfeatures, first_row[x]);
             }
 
             fgmask_row[x] = (uchar)(-(schar)isForeground);
@@ -429,7 +617,16 @@ void GMG_LoopBody::operator() (const Range& range) const
 void BackgroundSubtractorGMGImpl::apply(InputArray _frame, OutputArray _fgmask, double newLearningRate)
 {
     Mat frame = _frame.getMat();
+    _fgmask.create(frame.size(), CV_8UC1);
+    Mat fgmask = _fgmask.getMat();
+
+    Ptr<ParallelLoopBody> body = prepare(frame, fgmask, newLearningRate);
+    parallel_for_(Range(0, frame.rows), *body, frame.total()/(double)(1<<16));
+    finish(fgmask);
+}
 
+Ptr<ParallelLoopBody> BackgroundSubtractorGMGImpl::prepare(const Mat& frame, Mat& fgmask, double newLearningRate)
+{
     CV_Assert(frame.depth() == CV_8U || frame.depth() == CV_16U || frame.depth() == CV_32F);
     CV_Assert(frame.channels() == 1 || frame.channels() == 3 || frame.channels() == 4);
 
@@ -439,7 +636,7 @@ void BackgroundSubtractorGMGImpl::apply(InputArray _frame, OutputArray _fgmask,
         learningRate = newLearningRate;
     }
 
-    if (frame.size() != frameSize_)
+    if (frame.size() != frameSize_ || frame.channels() != channels_)
     {
         double minval = minVal_;
         double maxval = maxVal_;
@@ -448,32 +645,114 @@ void BackgroundSubtractorGMGImpl::apply(InputArray _frame, OutputArray _fgmask,
             minval = 0;
             maxval = frame.depth() == CV_8U ? 255.0 : frame.depth() == CV_16U ? std::numeric_limits<ushort>::max() : 1.0;
         }
-        initialize(frame.size(), minval, maxval);
+        initialize(frame.size(), frame.channels(), minval, maxval);
     }
 
-    _fgmask.create(frameSize_, CV_8UC1);
-    Mat fgmask = _fgmask.getMat();
+    CV_Assert(fgmask.size() == frameSize_ && fgmask.type() == CV_8UC1);
+    CV_Assert(processingMask_.empty() || processingMask_.size() == frameSize_);
+    CV_Assert(learningRateMap_.empty() || learningRateMap_.size() == frameSize_);
 
-    GMG_LoopBody body(frame, fgmask, nfeatures_, colors_, weights_,
-                      maxFeatures, learningRate, numInitializationFrames, quantizationLevels, backgroundPrior, decisionThreshold,
-                      maxVal_, minVal_, frameNum_, updateBackgroundModel);
-    parallel_for_(Range(0, frame.rows), body, frame.total()/(double)(1<<16));
+    return Ptr<ParallelLoopBody>(new GMG_LoopBody(frame, fgmask, nfeatures_, firstFeature_, colors_, weights_,
+                                                  processingMask_, learningRateMap_,
+                                                  maxFeatures, learningRate, numInitializationFrames, quantizationLevels, backgroundPrior, decisionThreshold,
+                                                  maxVal_, minVal_, frameNum_, updateBackgroundModel));
+}
 
+void BackgroundSubtractorGMGImpl::finish(Mat& fgmask)
+{
     if (smoothingRadius > 0)
     {
         medianBlur(fgmask, buf_, smoothingRadius);
-        swap(fgmask, buf_);
+
+        // the blur spreads the foreground into the pixels which are not processed
+        if (!processingMask_.empty())
+            buf_.setTo(Scalar::all(0), processingMask_ == 0);
+
+        // copied rather than swapped, fgmask shares the data of the caller's output
+        buf_.copyTo(fgmask);
     }
 
     // keep track of how many frames we have processed
     ++frameNum_;
 }
 
+void BackgroundSubtractorGMGImpl::saveModel(const String& filename) const
+{
+    BackgroundModelData data(BackgroundModelData::ALGO_GMG);
+    data.ints[0] = frameSize_.width;
+    data.ints[1] = frameSize_.height;
+    data.ints[2] = channels_;
+    data.ints[3] = frameNum_;
+    data.ints[4] = maxFeatures;
+    data.ints[5] = numInitializationFrames;
+    data.ints[6] = quantizationLevels;
+    data.ints[7] = smoothingRadius;
+    data.ints[8] = (int)updateBackgroundModel;
+    data.doubles[0] = learningRate;
+    data.doubles[1] = backgroundPrior;
+    data.doubles[2] = decisionThreshold;
+    data.doubles[3] = minVal_;
+    data.doubles[4] = maxVal_;
+    data.mats.push_back(nfeatures_);
+    data.mats.push_back(firstFeature_);
+    data.mats.push_back(colors_);
+    data.mats.push_back(weights_);
+    saveBackgroundModel(filename, data);
+}
+
+void BackgroundSubtractorGMGImpl::loadModel(const String& filename)
+{
+    BackgroundModelData data(BackgroundModelData::ALGO_GMG);
+    loadBackgroundModel(filename, data);
+
+    Size frameSize(data.ints[0], data.ints[1]);
+    int channels = data.ints[2];
+    int _maxFeatures = data.ints[4], _quantizationLevels = data.ints[6];
+    CV_Assert(data.mats.size() == 4);
+
+    const Mat& nfeatures = data.mats[0];
+    const Mat& firstFeature = data.mats[1];
+    const Mat& colors = data.mats[2];
+    const Mat& weights = data.mats[3];
+    if (frameSize.area() > 0)
+    {
+        int stride = featuresStride(_maxFeatures);
+        int colorsType = useShortColors(channels, _quantizationLevels) ? CV_16UC1 : CV_32SC1;
+        CV_Assert(_maxFeatures > 0);
+        CV_Assert(nfeatures.type() == CV_32SC1 && nfeatures.size() == frameSize &&
+                  checkRange(nfeatures, true, 0, 0, _maxFeatures + 1));
+        CV_Assert(firstFeature.type() == CV_32SC1 && firstFeature.size() == frameSize &&
+                  checkRange(firstFeature, true, 0, 0, _maxFeatures));
+        CV_Assert(colors.type() == colorsType && colors.rows == frameSize.area() && colors.cols == stride);
+        CV_Assert(weights.type() == CV_32FC1 && weights.rows == frameSize.area() && weights.cols == stride);
+    }
+
+    frameSize_ = frameSize;
+    channels_ = channels;
+    frameNum_ = data.ints[3];
+    maxFeatures = _maxFeatures;
+    numInitializationFrames = data.ints[5];
+    quantizationLevels = _quantizationLevels;
+    smoothingRadius = data.ints[7];
+    updateBackgroundModel = data.ints[8] != 0;
+    learningRate = data.doubles[0];
+    backgroundPrior = data.doubles[1];
+    decisionThreshold = data.doubles[2];
+    minVal_ = data.doubles[3];
+    maxVal_ = data.doubles[4];
+    nfeatures_ = nfeatures;
+    firstFeature_ = firstFeature;
+    colors_ = colors;
+    weights_ = weights;
+}
+
 void BackgroundSubtractorGMGImpl::release()
 {
     frameSize_ = Size();
+    channels_ = 0;
 
     nfeatures_.release();
+    firstFeature_.release();
     colors_.release();
     weights_.release();
     buf_.release();
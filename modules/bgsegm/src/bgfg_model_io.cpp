@@ -0,0 +1,301 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                          License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000, Intel Corporation, all rights reserved.
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+
+#include "precomp.hpp"
+#include <cstdio>
+
+namespace cv
+{
+namespace bgsegm
+{
+
+static const char modelMagic[8] = { 'B', 'G', 'S', 'E', 'G', 'M', 'D', 'L' };
+static const int modelVersion = 1;
+static const int64 modelAlignment = 64;
+
+/*
+ * The header fields are stored one by one as little-endian 32-bit integers,
+ * 64-bit offsets and IEEE doubles, so the layout does not depend on the
+ * compiler's struct packing or on the byte order of the host:
+ *
+ *   magic[8], version, algorithm, ints[MAX_PARAMS], doubles[MAX_PARAMS],
+ *   nmats, { rows, cols, type, offset } x MAX_MATS
+ *
+ * The matrix data follows as is.
+ */
+static const int64 headerSize = 8 + 4*2 + (4 + 8)*BackgroundModelData::MAX_PARAMS + 4 +
+                                (4*3 + 8)*BackgroundModelData::MAX_MATS;
+
+struct ModelFileHeader
+{
+    int version;
+    int algorithm;
+    int ints[BackgroundModelData::MAX_PARAMS];
+    double doubles[BackgroundModelData::MAX_PARAMS];
+    int nmats;
+    int rows[BackgroundModelData::MAX_MATS];
+    int cols[BackgroundModelData::MAX_MATS];
+    int types[BackgroundModelData::MAX_MATS];
+    int64 offsets[BackgroundModelData::MAX_MATS];
+};
+
+static void putUInt64(std::vector<uchar>& buf, uint64 v, int nbytes)
+{
+    for (int i = 0; i < nbytes; ++i)
+        buf.push_back((uchar)(v >> (i*8)));
+}
+
+static uint64 getUInt64(const uchar*& ptr, int nbytes)
+{
+    uint64 v = 0;
+    for (int i = 0; i < nbytes; ++i)
+        v |= (uint64)ptr[i] << (i*8);
+    ptr += nbytes;
+    return v;
+}
+
+static void putInt(std::vector<uchar>& buf, int v) { putUInt64(buf, (unsigned)v, 4); }
+static void putInt64(std::vector<uchar>& buf, int64 v) { putUInt64(buf, (uint64)v, 8); }
+static void putDouble(std::vector<uchar>& buf, double v)
+{
+    Cv64suf u;
+    u.f = v;
+    putUInt64(buf, u.u, 8);
+}
+
+static int getInt(const uchar*& ptr) { return (int)(unsigned)getUInt64(ptr, 4); }
+static int64 getInt64(const uchar*& ptr) { return (int64)getUInt64(ptr, 8); }
+static double getDouble(const uchar*& ptr)
+{
+    Cv64suf u;
+    u.u = getUInt64(ptr, 8);
+    return u.f;
+}
+
+static void encodeHeader(const ModelFileHeader& header, std::vector<uchar>& buf)
+{
+    buf.assign(modelMagic, modelMagic + sizeof(modelMagic));
+    putInt(buf, header.version);
+    putInt(buf, header.algorithm);
+    for (int i = 0; i < BackgroundModelData::MAX_PARAMS; ++i)
+        putInt(buf, header.ints[i]);
+    for (int i = 0; i < BackgroundModelData::MAX_PARAMS; ++i)
+        putDouble(buf, header.doubles[i]);
+    putInt(buf, header.nmats);
+    for (int i = 0; i < BackgroundModelData::MAX_MATS; ++i)
+    {
+        putInt(buf, header.rows[i]);
+        putInt(buf, header.cols[i]);
+        putInt(buf, header.types[i]);
+        putInt64(buf, header.offsets[i]);
+    }
+    CV_DbgAssert((int64)buf.size() == headerSize);
+}
+
+static bool decodeHeader(const std::vector<uchar>& buf, ModelFileHeader& header)
+{
+    if (memcmp(&buf[0], modelMagic, sizeof(modelMagic)) != 0)
+        return false;
+
+    const uchar* ptr = &buf[0] + sizeof(modelMagic);
+    header.version = getInt(ptr);
+    header.algorithm = getInt(ptr);
+    for (int i = 0; i < BackgroundModelData::MAX_PARAMS; ++i)
+        header.ints[i] = getInt(ptr);
+    for (int i = 0; i < BackgroundModelData::MAX_PARAMS; ++i)
+        header.doubles[i] = getDouble(ptr);
+    header.nmats = getInt(ptr);
+    for (int i = 0; i < BackgroundModelData::MAX_MATS; ++i)
+    {
+        header.rows[i] = getInt(ptr);
+        header.cols[i] = getInt(ptr);
+        header.types[i] = getInt(ptr);
+        header.offsets[i] = getInt64(ptr);
+    }
+    return true;
+}
+
+// fseek()/ftell() take a long, which is 32-bit on Windows even in 64-bit builds
+static bool seekFile(FILE* f, int64 ofs, int origin)
+{
+#ifdef _WIN32
+    return _fseeki64(f, ofs, origin) == 0;
+#else
+    return fseeko(f, (off_t)ofs, origin) == 0;
+#endif
+}
+
+static int64 tellFile(FILE* f)
+{
+#ifdef _WIN32
+    return _ftelli64(f);
+#else
+    return (int64)ftello(f);
+#endif
+}
+
+BackgroundModelData::BackgroundModelData(int _algorithm) : algorithm(_algorithm)
+{
+    memset(ints, 0, sizeof(ints));
+    memset(doubles, 0, sizeof(doubles));
+}
+
+static inline int64 alignOffset(int64 ofs)
+{
+    return (ofs + modelAlignment - 1) & -modelAlignment;
+}
+
+void saveBackgroundModel(const String& filename, const BackgroundModelData& data)
+{
+    CV_Assert(data.mats.size() <= (size_t)BackgroundModelData::MAX_MATS);
+
+    ModelFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.version = modelVersion;
+    header.algorithm = data.algorithm;
+    memcpy(header.ints, data.ints, sizeof(header.ints));
+    memcpy(header.doubles, data.doubles, sizeof(header.doubles));
+    header.nmats = (int)data.mats.size();
+
+    int64 ofs = alignOffset(headerSize);
+    for (int i = 0; i < header.nmats; ++i)
+    {
+        const Mat& m = data.mats[i];
+        CV_Assert(m.dims <= 2 && (m.empty() || m.isContinuous()));
+        header.rows[i] = m.rows;
+        header.cols[i] = m.cols;
+        header.types[i] = m.type();
+        header.offsets[i] = ofs;
+        ofs = alignOffset(ofs + (int64)(m.total()*m.elemSize()));
+    }
+
+    std::vector<uchar> buf;
+    encodeHeader(header, buf);
+
+    FILE* f = fopen(filename.c_str(), "wb");
+    if (!f)
+        CV_Error(Error::StsError, "Can not open the model file for writing: " + filename);
+
+    static const char zeros[modelAlignment] = { 0 };
+    bool ok = fwrite(&buf[0], 1, buf.size(), f) == buf.size();
+    int64 pos = headerSize;
+    for (int i = 0; ok && i < header.nmats; ++i)
+    {
+        const Mat& m = data.mats[i];
+        size_t pad = (size_t)(header.offsets[i] - pos), size = m.total()*m.elemSize();
+        ok = fwrite(zeros, 1, pad, f) == pad && fwrite(m.data, 1, size, f) == size;
+        pos = header.offsets[i] + (int64)size;
+    }
+
+    ok = fclose(f) == 0 && ok;
+    if (!ok)
+        CV_Error(Error::StsError, "Can not write the model file: " + filename);
+}
+
+/*
+ * Checks the matrix descriptions of the header against the file length,
+ * so a damaged file is rejected before anything is allocated for it.
+ */
+static bool validateHeader(const ModelFileHeader& header, int algorithm, int64 fileSize)
+{
+    if (header.version != modelVersion || header.algorithm != algorithm ||
+        header.nmats < 0 || header.nmats > BackgroundModelData::MAX_MATS)
+        return false;
+
+    int64 end = headerSize;
+    for (int i = 0; i < header.nmats; ++i)
+    {
+        int type = header.types[i];
+        if (type < 0 || type != CV_MAT_TYPE(type) || header.rows[i] < 0 || header.cols[i] < 0)
+            return false;
+
+        // rows*cols can't overflow, the elements are counted before they are sized
+        int64 total = (int64)header.rows[i]*header.cols[i];
+        int64 ofs = header.offsets[i];
+        if (ofs < end || ofs > fileSize || total > fileSize)
+            return false;
+
+        int64 size = total*(int64)CV_ELEM_SIZE(type);
+        if (size > fileSize - ofs)
+            return false;
+        end = ofs + size;
+    }
+    return true;
+}
+
+void loadBackgroundModel(const String& filename, BackgroundModelData& data)
+{
+    FILE* f = fopen(filename.c_str(), "rb");
+    if (!f)
+        CV_Error(Error::StsError, "Can not open the model file: " + filename);
+
+    int64 fileSize = seekFile(f, 0, SEEK_END) ? tellFile(f) : -1;
+    std::vector<uchar> buf((size_t)headerSize);
+    ModelFileHeader header;
+    bool ok = fileSize >= headerSize && seekFile(f, 0, SEEK_SET) &&
+              fread(&buf[0], 1, buf.size(), f) == buf.size() &&
+              decodeHeader(buf, header) &&
+              validateHeader(header, data.algorithm, fileSize);
+
+    std::vector<Mat> mats;
+    for (int i = 0; ok && i < header.nmats; ++i)
+    {
+        Mat m(header.rows[i], header.cols[i], header.types[i]);
+        size_t size = m.total()*m.elemSize();
+        ok = size == 0 || (seekFile(f, header.offsets[i], SEEK_SET) && fread(m.data, 1, size, f) == size);
+        mats.push_back(m);
+    }
+
+    fclose(f);
+    if (!ok)
+        CV_Error(Error::StsParseError, "The file is not a valid background model of this algorithm: " + filename);
+
+    memcpy(data.ints, header.ints, sizeof(data.ints));
+    memcpy(data.doubles, header.doubles, sizeof(data.doubles));
+    data.mats.swap(mats);
+}
+
+}
+}
+
+/* End of file. */
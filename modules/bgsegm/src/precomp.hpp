@@ -45,8 +45,59 @@ the use of this software, even if advised of the possibility of such damage.
 #include <opencv2/bgsegm.hpp>
 #include <opencv2/video.hpp>
 #include <opencv2/imgproc.hpp>
+#include <opencv2/core/utility.hpp>
 
 #include <algorithm>
 #include <cmath>
 
+namespace cv
+{
+namespace bgsegm
+{
+
+/**
+ * Internal interface of the subtractors whose per-frame update is a row-parallel loop.
+ * It lets applyBatch() schedule the rows of several independent models together.
+ */
+class ParallelBackgroundSubtractor
+{
+public:
+    virtual ~ParallelBackgroundSubtractor() {}
+
+    /**
+     * Validates the frame, (re)initializes the model if needed and returns the loop body
+     * that updates the model and computes fgmask for a range of image rows.
+     * fgmask must be already allocated as a CV_8UC1 matrix of the frame size.
+     */
+    virtual Ptr<ParallelLoopBody> prepare(const Mat& image, Mat& fgmask, double learningRate) = 0;
+
+    //! Completes the update once all rows have been processed.
+    virtual void finish(Mat& fgmask) = 0;
+};
+
+/**
+ * Contents of a binary model file written by saveModel(). The file consists of a
+ * fixed-size header with the scalar parameters followed by the raw data of the model
+ * matrices, each one starting at a 64-byte aligned offset, so the planes can be read
+ * directly into place (or memory-mapped) without any parsing.
+ */
+struct BackgroundModelData
+{
+    enum { MAX_PARAMS = 12, MAX_MATS = 4 };
+    enum { ALGO_MOG = 1, ALGO_GMG = 2 };
+
+    BackgroundModelData(int _algorithm);
+
+    int algorithm;
+    int ints[MAX_PARAMS];
+    double doubles[MAX_PARAMS];
+    std::vector<Mat> mats;
+};
+
+void saveBackgroundModel(const String& filename, const BackgroundModelData& data);
+void loadBackgroundModel(const String& filename, BackgroundModelData& data);
+
+}
+}
+
 #endif
@@ -0,0 +1,102 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                          License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000, Intel Corporation, all rights reserved.
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "test_precomp.hpp"
+
+using namespace cv;
+using namespace cv::bgsegm;
+
+static Ptr<BackgroundSubtractor> createSubtractor(int idx)
+{
+    if (idx % 2 == 0)
+        return createBackgroundSubtractorMOG();
+    Ptr<BackgroundSubtractorGMG> gmg = createBackgroundSubtractorGMG(5);
+    gmg->setSmoothingRadius(0);
+    return gmg;
+}
+
+TEST(BGSEGM_Batch, matches_separate_apply)
+{
+    const int nstreams = 4;
+    RNG rng(0x4321);
+
+    std::vector<Ptr<BackgroundSubtractor> > batched, separate;
+    for (int i = 0; i < nstreams; ++i)
+    {
+        batched.push_back(createSubtractor(i));
+        separate.push_back(createSubtractor(i));
+    }
+
+    for (int frame = 0; frame < 10; ++frame)
+    {
+        std::vector<Mat> images, masks;
+        for (int i = 0; i < nstreams; ++i)
+        {
+            Mat image(120 + 20*i, 160, i < 2 ? CV_8UC1 : CV_8UC3);
+            rng.fill(image, RNG::UNIFORM, 64, 128);
+            if (frame == 9)
+                rectangle(image, Rect(10, 10, 50, 50), Scalar::all(250), -1);
+            images.push_back(image);
+        }
+
+        applyBatch(batched, images, masks);
+        ASSERT_EQ((size_t)nstreams, masks.size());
+
+        for (int i = 0; i < nstreams; ++i)
+        {
+            Mat mask;
+            separate[i]->apply(images[i], mask);
+            ASSERT_EQ(0, norm(mask, masks[i], NORM_INF)) << "stream " << i << ", frame " << frame;
+        }
+    }
+}
+
+TEST(BGSEGM_Batch, rejects_repeated_subtractor)
+{
+    std::vector<Ptr<BackgroundSubtractor> > subtractors;
+    subtractors.push_back(createSubtractor(1));
+    subtractors.push_back(createSubtractor(0));
+    subtractors.push_back(subtractors[0]);
+
+    std::vector<Mat> images(subtractors.size(), Mat(120, 160, CV_8UC1, Scalar::all(100))), masks;
+    EXPECT_THROW(applyBatch(subtractors, images, masks), cv::Exception);
+}
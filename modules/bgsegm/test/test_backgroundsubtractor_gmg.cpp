@@ -0,0 +1,157 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                          License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000, Intel Corporation, all rights reserved.
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "test_precomp.hpp"
+
+using namespace cv;
+using namespace cv::bgsegm;
+
+static void fillFrame(RNG& rng, Mat& frame, int i)
+{
+    rng.fill(frame, RNG::UNIFORM, 64, 128);
+    if (i >= 5)
+        rectangle(frame, Rect(50 + 2*i, 30, 60, 50), Scalar::all(250), -1);
+}
+
+TEST(BGSEGM_GMG, smoothing)
+{
+    RNG rng(0x3579);
+    Mat frame(120, 160, CV_8UC3), mask, smoothedMask, expected;
+
+    Ptr<BackgroundSubtractorGMG> gmg = createBackgroundSubtractorGMG(5);
+    Ptr<BackgroundSubtractorGMG> smoothed = createBackgroundSubtractorGMG(5);
+    gmg->setSmoothingRadius(0);
+    smoothed->setSmoothingRadius(7);
+
+    for (int i = 0; i < 15; ++i)
+    {
+        fillFrame(rng, frame, i);
+        gmg->apply(frame, mask);
+        smoothed->apply(frame, smoothedMask);
+
+        medianBlur(mask, expected, 7);
+        ASSERT_EQ(0, norm(expected, smoothedMask, NORM_INF)) << "frame " << i;
+    }
+}
+
+TEST(BGSEGM_GMG, processing_mask)
+{
+    RNG rng(0x2468);
+    Mat frame(120, 160, CV_8UC3), fullMask, maskedMask;
+
+    Ptr<BackgroundSubtractorGMG> full = createBackgroundSubtractorGMG(5);
+    Ptr<BackgroundSubtractorGMG> masked = createBackgroundSubtractorGMG(5);
+
+    Mat roi = Mat::zeros(frame.size(), CV_8UC1);
+    Rect inside(0, 0, frame.cols/2, frame.rows);
+    roi(inside).setTo(Scalar::all(255));
+    masked->setProcessingMask(roi);
+
+    // the median filter window of the pixels near the edge of the mask differs
+    int radius = masked->getSmoothingRadius()/2;
+    Rect inner(0, 0, inside.width - radius, inside.height);
+    Rect outside(inside.width, 0, frame.cols - inside.width, frame.rows);
+
+    int foreground = 0;
+    for (int i = 0; i < 15; ++i)
+    {
+        fillFrame(rng, frame, i);
+        full->apply(frame, fullMask);
+        masked->apply(frame, maskedMask);
+
+        ASSERT_EQ(0, norm(fullMask(inner), maskedMask(inner), NORM_INF)) << "frame " << i;
+        ASSERT_EQ(0, countNonZero(maskedMask(outside))) << "frame " << i;
+        foreground += countNonZero(maskedMask(inside));
+    }
+
+    // the rectangle crossing the edge of the mask is detected
+    EXPECT_GT(foreground, 0);
+}
+
+TEST(BGSEGM_GMG, learning_rate_map)
+{
+    RNG rng(0x1357);
+    Mat frame(120, 160, CV_8UC1), mask, clampedMask;
+
+    Ptr<BackgroundSubtractorGMG> gmg = createBackgroundSubtractorGMG(5);
+    Ptr<BackgroundSubtractorGMG> clamped = createBackgroundSubtractorGMG(5);
+    gmg->setSmoothingRadius(0);
+    clamped->setSmoothingRadius(0);
+
+    // rate*learningRate is clamped to 1, so both maps give the same model
+    gmg->setLearningRateMap(Mat(frame.size(), CV_32FC1, Scalar::all(2)));
+    clamped->setLearningRateMap(Mat(frame.size(), CV_32FC1, Scalar::all(10)));
+
+    for (int i = 0; i < 15; ++i)
+    {
+        fillFrame(rng, frame, i);
+        gmg->apply(frame, mask, 0.5);
+        clamped->apply(frame, clampedMask, 0.5);
+        ASSERT_EQ(0, norm(mask, clampedMask, NORM_INF)) << "frame " << i;
+    }
+}
+
+TEST(BGSEGM_GMG, change_quantization_levels)
+{
+    RNG rng(0x9753);
+    Mat frame(120, 160, CV_8UC3), mask, freshMask;
+
+    Ptr<BackgroundSubtractorGMG> gmg = createBackgroundSubtractorGMG(5);
+    Ptr<BackgroundSubtractorGMG> fresh = createBackgroundSubtractorGMG(5);
+    fresh->setQuantizationLevels(255);
+
+    for (int i = 0; i < 15; ++i)
+    {
+        fillFrame(rng, frame, i);
+        gmg->apply(frame, mask);
+    }
+
+    // 256^3 colors no longer fit the 16-bit storage, the model starts over
+    gmg->setQuantizationLevels(255);
+    for (int i = 0; i < 15; ++i)
+    {
+        fillFrame(rng, frame, i);
+        gmg->apply(frame, mask);
+        fresh->apply(frame, freshMask);
+        ASSERT_EQ(0, norm(mask, freshMask, NORM_INF)) << "frame " << i;
+    }
+}
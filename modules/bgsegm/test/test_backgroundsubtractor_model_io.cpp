@@ -0,0 +1,147 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                          License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000, Intel Corporation, all rights reserved.
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "test_precomp.hpp"
+#include <cstdio>
+
+using namespace cv;
+using namespace cv::bgsegm;
+
+template <typename T>
+static void checkModelRestore(const Ptr<T>& trained, const Ptr<T>& restored, int type)
+{
+    RNG rng(0x5678);
+    Mat frame(90, 130, type), mask, restoredMask;
+
+    for (int i = 0; i < 15; ++i)
+    {
+        rng.fill(frame, RNG::UNIFORM, 64, 128);
+        trained->apply(frame, mask);
+    }
+
+    String filename = tempfile(".bin");
+    trained->saveModel(filename);
+    restored->loadModel(filename);
+    remove(filename.c_str());
+
+    for (int i = 0; i < 5; ++i)
+    {
+        rng.fill(frame, RNG::UNIFORM, 64, 128);
+        rectangle(frame, Rect(10 + i, 20, 40, 30), Scalar::all(250), -1);
+        trained->apply(frame, mask);
+        restored->apply(frame, restoredMask);
+        ASSERT_EQ(0, norm(mask, restoredMask, NORM_INF)) << "frame " << i;
+    }
+}
+
+TEST(BGSEGM_MOG, model_save_load)
+{
+    checkModelRestore<BackgroundSubtractorMOG>(createBackgroundSubtractorMOG(),
+                                               createBackgroundSubtractorMOG(), CV_8UC3);
+}
+
+TEST(BGSEGM_GMG, model_save_load)
+{
+    checkModelRestore<BackgroundSubtractorGMG>(createBackgroundSubtractorGMG(10),
+                                               createBackgroundSubtractorGMG(), CV_8UC3);
+}
+
+TEST(BGSEGM_MOG, model_load_truncated)
+{
+    Ptr<BackgroundSubtractorMOG> mog = createBackgroundSubtractorMOG();
+    Mat frame(60, 80, CV_8UC1, Scalar::all(100)), mask;
+    mog->apply(frame, mask);
+
+    String filename = tempfile(".bin");
+    mog->saveModel(filename);
+
+    std::vector<char> contents;
+    FILE* f = fopen(filename.c_str(), "rb");
+    ASSERT_TRUE(f != NULL);
+    char buf[4096];
+    for (size_t n; (n = fread(buf, 1, sizeof(buf), f)) > 0; )
+        contents.insert(contents.end(), buf, buf + n);
+    fclose(f);
+
+    // the matrix sizes stored in the header no longer fit into the file
+    f = fopen(filename.c_str(), "wb");
+    ASSERT_TRUE(f != NULL);
+    fwrite(&contents[0], 1, contents.size() - 1, f);
+    fclose(f);
+
+    Ptr<BackgroundSubtractorMOG> restored = createBackgroundSubtractorMOG();
+    EXPECT_THROW(restored->loadModel(filename), cv::Exception);
+    remove(filename.c_str());
+}
+
+TEST(BGSEGM_GMG, model_load_corrupted_count)
+{
+    Ptr<BackgroundSubtractorGMG> gmg = createBackgroundSubtractorGMG(5);
+    Mat frame(60, 80, CV_8UC1, Scalar::all(100)), mask;
+    for (int i = 0; i < 3; ++i)
+        gmg->apply(frame, mask);
+
+    String filename = tempfile(".bin");
+    gmg->saveModel(filename);
+
+    // the offset of the first matrix (the feature counts) is the last field of its
+    // header entry: magic, version, algorithm, 12 ints, 12 doubles, nmats, rows, cols, type
+    const long offsetPos = 8 + 4 + 4 + 12*4 + 12*8 + 4 + 3*4;
+    FILE* f = fopen(filename.c_str(), "r+b");
+    ASSERT_TRUE(f != NULL);
+    unsigned char ofsBytes[8];
+    ASSERT_EQ(0, fseek(f, offsetPos, SEEK_SET));
+    ASSERT_EQ(8u, fread(ofsBytes, 1, 8, f));
+    long countPos = 0;
+    for (int i = 3; i >= 0; --i)
+        countPos = (countPos << 8) | ofsBytes[i];
+
+    // more features than the histogram can hold
+    const unsigned char badCount[4] = { 0xff, 0xff, 0, 0 };
+    ASSERT_EQ(0, fseek(f, countPos, SEEK_SET));
+    ASSERT_EQ(4u, fwrite(badCount, 1, 4, f));
+    fclose(f);
+
+    Ptr<BackgroundSubtractorGMG> restored = createBackgroundSubtractorGMG();
+    EXPECT_THROW(restored->loadModel(filename), cv::Exception);
+    remove(filename.c_str());
+}
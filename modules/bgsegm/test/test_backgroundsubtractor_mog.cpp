@@ -0,0 +1,145 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                          License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000, Intel Corporation, all rights reserved.
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "test_precomp.hpp"
+
+using namespace cv;
+using namespace cv::bgsegm;
+
+static void runMOG(int type, int nthreads, std::vector<Mat>& masks)
+{
+    RNG rng(0x1234);
+    Ptr<BackgroundSubtractorMOG> mog = createBackgroundSubtractorMOG();
+    Mat frame(240, 320, type), fgmask;
+
+    int prevThreads = getNumThreads();
+    setNumThreads(nthreads);
+
+    masks.clear();
+    for (int i = 0; i < 30; ++i)
+    {
+        rng.fill(frame, RNG::UNIFORM, 64, 128);
+        if (i % 10 == 9)
+            rectangle(frame, Rect(40 + i, 30, 60, 80), Scalar::all(250), -1);
+
+        mog->apply(frame, fgmask, i < 20 ? -1 : 0);
+        masks.push_back(fgmask.clone());
+    }
+
+    setNumThreads(prevThreads);
+}
+
+TEST(BGSEGM_MOG, parallel_matches_serial)
+{
+    const int types[] = { CV_8UC1, CV_8UC3 };
+    for (size_t t = 0; t < sizeof(types)/sizeof(types[0]); ++t)
+    {
+        std::vector<Mat> serial, parallel;
+        runMOG(types[t], 1, serial);
+        runMOG(types[t], getNumberOfCPUs(), parallel);
+
+        ASSERT_EQ(serial.size(), parallel.size());
+        for (size_t i = 0; i < serial.size(); ++i)
+            ASSERT_EQ(0, norm(serial[i], parallel[i], NORM_INF)) << "frame " << i;
+    }
+}
+
+TEST(BGSEGM_MOG, processing_mask)
+{
+    RNG rng(0x2468);
+    Ptr<BackgroundSubtractorMOG> full = createBackgroundSubtractorMOG();
+    Ptr<BackgroundSubtractorMOG> masked = createBackgroundSubtractorMOG();
+
+    Mat frame(120, 160, CV_8UC3), fullMask, maskedMask;
+    Mat roi = Mat::zeros(frame.size(), CV_8UC1);
+    Rect inside(0, 0, frame.cols/2, frame.rows);
+    roi(inside).setTo(Scalar::all(255));
+    masked->setProcessingMask(roi);
+
+    for (int i = 0; i < 20; ++i)
+    {
+        rng.fill(frame, RNG::UNIFORM, 64, 128);
+        if (i >= 15)
+            rectangle(frame, Rect(20, 30, 100, 40), Scalar::all(250), -1);
+
+        full->apply(frame, fullMask);
+        masked->apply(frame, maskedMask);
+
+        ASSERT_EQ(0, norm(fullMask(inside), maskedMask(inside), NORM_INF)) << "frame " << i;
+        ASSERT_EQ(0, countNonZero(maskedMask(Rect(inside.width, 0, frame.cols - inside.width, frame.rows))));
+    }
+}
+
+TEST(BGSEGM_MOG, learning_rate_map)
+{
+    RNG rng(0x1357);
+    Mat frame(120, 160, CV_8UC1), mask, clampedMask;
+    Rect updated(0, 0, frame.cols/2, frame.rows);
+    Rect frozen(updated.width, 0, frame.cols - updated.width, frame.rows);
+
+    Ptr<BackgroundSubtractorMOG> mog = createBackgroundSubtractorMOG();
+    Ptr<BackgroundSubtractorMOG> clamped = createBackgroundSubtractorMOG();
+
+    // rate*learningRate is clamped to 1, so both maps give the same model
+    Mat rates(frame.size(), CV_32FC1, Scalar::all(2)), largeRates(frame.size(), CV_32FC1, Scalar::all(10));
+    mog->setLearningRateMap(rates);
+    clamped->setLearningRateMap(largeRates);
+
+    for (int i = 0; i < 10; ++i)
+    {
+        rng.fill(frame, RNG::UNIFORM, 64, 128);
+        mog->apply(frame, mask, 0.5);
+        clamped->apply(frame, clampedMask, 0.5);
+        ASSERT_EQ(0, norm(mask, clampedMask, NORM_INF)) << "frame " << i;
+    }
+
+    // a zero rate freezes the model, the new background is learned in the other half only
+    rates(frozen).setTo(Scalar::all(0));
+    mog->setLearningRateMap(rates);
+
+    frame.setTo(Scalar::all(250));
+    for (int i = 0; i < 30; ++i)
+        mog->apply(frame, mask, 0.5);
+
+    EXPECT_EQ(0, countNonZero(mask(updated)));
+    EXPECT_EQ(frozen.area(), countNonZero(mask(frozen)));
+}
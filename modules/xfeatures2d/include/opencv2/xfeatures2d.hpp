@@ -112,6 +112,9 @@ protected:
     template <typename srcMatType>
     void extractDescriptor(srcMatType *pointsValue, void ** ptr) const;
 
+    template <typename srcMatType, typename iiMatType>
+    friend struct FREAKDescriptorInvoker;
+
     bool orientationNormalized; //true if the orientation is normalized, false otherwise
     bool scaleNormalized; //true if the scale is normalized, false otherwise
     double patternScale; //scaling of the pattern
@@ -147,6 +150,7 @@ protected:
     int patternSizes[NB_SCALES]; // size of the pattern at a specific scale (used to check if a point is within image boundaries)
     DescriptionPair descriptionPairs[NB_PAIRS];
     OrientationPair orientationPairs[NB_ORIENPAIRS];
+    std::vector<uchar> permutedPairs; // point indices of the description pairs in SIMD comparison order
 };
 
 
@@ -158,11 +162,13 @@ protected:
 class CV_EXPORTS_W StarDetector : public FeatureDetector
 {
 public:
-    //! the full constructor
+    //! the full constructor. When nfeatures > 0, at most nfeatures keypoints spread over
+    //! a gridSize x gridSize grid are kept (see retainBestInGrid)
     CV_WRAP StarDetector(int _maxSize=45, int _responseThreshold=30,
                          int _lineThresholdProjected=10,
                          int _lineThresholdBinarized=8,
-                         int _suppressNonmaxSize=5);
+                         int _suppressNonmaxSize=5,
+                         int _nfeatures=0, int _gridSize=1);
 
     //! finds the keypoints in the image
     CV_WRAP_AS(detect) void operator()(const Mat& image,
@@ -178,6 +184,8 @@ protected:
     int lineThresholdProjected;
     int lineThresholdBinarized;
     int suppressNonmaxSize;
+    int nfeatures;
+    int gridSize;
 };
 
 typedef StarDetector StarFeatureDetector;
@@ -201,6 +209,10 @@ public:
     virtual int descriptorType() const;
     virtual int defaultNorm() const;
 
+    //! computes the descriptors from a precomputed CV_32S integral image of the grayscale image
+    //! (as returned by integral()), so that it can be shared with other integral-based stages
+    void computeFromIntegral(InputArray sum, std::vector<KeyPoint>& keypoints, OutputArray descriptors) const;
+
     /// @todo read and write for brief
 
     AlgorithmInfo* info() const;
@@ -208,12 +220,21 @@ public:
 protected:
     virtual void computeImpl(InputArray image, std::vector<KeyPoint>& keypoints, OutputArray descriptors) const;
 
-    typedef void(*PixelTestFn)(InputArray, const std::vector<KeyPoint>&, OutputArray);
+    typedef void(*PixelTestFn)(const Mat&, const std::vector<KeyPoint>&, Mat&, const Range&);
     
     int bytes_;
     PixelTestFn test_fn_;
 };
-    
+
+/*!
+ Keeps at most maxKeypoints keypoints, spread over a gridSize x gridSize grid of the image:
+ the strongest keypoint of every cell is kept first, then the second strongest and so on,
+ the cells with fewer keypoints leaving their share to the others. gridSize = 1 keeps the
+ globally strongest responses. The kept keypoints stay in their original order.
+ */
+CV_EXPORTS void retainBestInGrid( std::vector<KeyPoint>& keypoints, Size imageSize,
+                                  int maxKeypoints, int gridSize );
+
 }
 }
 
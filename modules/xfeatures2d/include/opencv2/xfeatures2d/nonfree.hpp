@@ -58,11 +58,14 @@ namespace xfeatures2d
 class CV_EXPORTS_W SIFT : public Feature2D
 {
 public:
+    //! descriptorType selects the descriptor elements: CV_32F or CV_8U, both holding the same values,
+    //! which SIFT quantizes to 0..255 anyway.
+    //! gridSize > 1 spreads the nfeatures budget over a gridSize x gridSize grid (see retainBestInGrid).
     CV_WRAP explicit SIFT( int nfeatures = 0, int nOctaveLayers = 3,
           double contrastThreshold = 0.04, double edgeThreshold = 10,
-          double sigma = 1.6);
+          double sigma = 1.6, int descriptorType = CV_32F, int gridSize = 1 );
 
-    //! returns the descriptor size in floats (128)
+    //! returns the descriptor size in elements (128)
     CV_WRAP int descriptorSize() const;
 
     //! returns the descriptor type
@@ -81,6 +84,78 @@ public:
                     OutputArray descriptors,
                     bool useProvidedKeypoints = false) const;
 
+    //! Gaussian and DoG scale-space pyramids of an image, built by buildPyramid()
+    struct Pyramid
+    {
+        Pyramid() : firstOctave(0), nOctaveLayers(0), sigma(0) {}
+
+        std::vector<Mat> gaussian;
+        std::vector<Mat> dog;       //!< empty if the pyramid was built for description only
+        int firstOctave;            //!< -1 if the image was upsampled 2x, 0 otherwise
+        int nOctaveLayers;
+        double sigma;
+    };
+
+    //! builds the scale-space pyramids of the image once, so that they can be shared
+    //! by several detection/description calls on the same image.
+    //! nOctaves <= 0 selects the number of octaves used by detection; the pyramid of
+    //! an image too small for a single octave is empty and yields no features.
+    //! The DoG pyramid is needed only for detection and is skipped if withDoG is false.
+    void buildPyramid(InputArray img, Pyramid& pyr, int firstOctave = -1,
+                      int nOctaves = 0, bool withDoG = true) const;
+
+    //! same as the operator above, but works on the prebuilt pyramid of the image.
+    //! The user-provided keypoints must lie in the octaves covered by the pyramid.
+    void operator()(const Pyramid& pyr, InputArray mask,
+                    std::vector<KeyPoint>& keypoints,
+                    OutputArray descriptors,
+                    bool useProvidedKeypoints = false) const;
+
+    //! finds the keypoints (and computes their descriptors if requested) in a very large image
+    //! processing it in overlapping tiles, so that the peak memory depends on the tile size
+    //! rather than on the image size. Each tile is extended by tileMargin pixels on every side
+    //! and keeps only the keypoints located in its own part of the image; features with
+    //! a support region larger than the margin may be missed. Each tile gets the number of
+    //! octaves of an image the size of its extended region clipped to the image,
+    //! cvRound(log2(min(width, height))), which is
+    //! never more than the whole image gets, so the coarsest octaves of the whole image are not
+    //! searched when the extended tiles are smaller than the image. Up to getNumThreads() tiles
+    //! are processed concurrently. nfeatures is applied to the merged result.
+    void detectAndComputeTiled(InputArray img, InputArray mask,
+                               std::vector<KeyPoint>& keypoints,
+                               OutputArray descriptors,
+                               Size tileSize = Size(2048, 2048),
+                               int tileMargin = 96) const;
+
+    //! features of the previous frame of a video sequence, kept between detectAndComputeNext() calls
+    struct FrameCache
+    {
+        FrameCache() : tileSize(256, 256), tileMargin(96), changeThreshold(0), changeFilterSize(0) {}
+
+        Mat frame;                  //!< the reference frame, converted to grayscale
+        std::vector<Rect> tiles;
+        std::vector<std::vector<KeyPoint> > tileKeypoints;
+        std::vector<Mat> tileDescriptors;
+        Size tileSize;              //!< the tiling, as in detectAndComputeTiled()
+        int tileMargin;
+        int changeThreshold;        //!< the found changes are the pixels differing by more than this
+        int changeFilterSize;       //!< > 1 drops the found changes smaller than this square
+    };
+
+    //! incremental version of detectAndComputeTiled() for the frames of a mostly static camera.
+    //! changeMask marks the pixels that changed since the previous frame; if it is empty, they are
+    //! found by comparing the frame with the cached one. Only the tiles whose extended region
+    //! contains a change are processed again, the features of the other tiles are taken from the
+    //! cache, so the result is the same as for detectAndComputeTiled() on the whole frame.
+    //! With changeThreshold > 0 or changeFilterSize > 1 the found changes ignore the sensor noise,
+    //! and the result is only approximate: the cached frame is then updated in the found changes
+    //! only, so slow drifts are still caught once they exceed the threshold.
+    //! The first frame and any change of the frame size or the tiling are processed in full;
+    //! the cache must be reset (cache = FrameCache()) when the SIFT parameters or tileMargin change.
+    void detectAndComputeNext(InputArray img, InputArray changeMask, FrameCache& cache,
+                              std::vector<KeyPoint>& keypoints,
+                              OutputArray descriptors) const;
+
     AlgorithmInfo* info() const;
 
     void buildGaussianPyramid( const Mat& base, std::vector<Mat>& pyr, int nOctaves ) const;
@@ -97,6 +172,8 @@ protected:
     CV_PROP_RW double contrastThreshold;
     CV_PROP_RW double edgeThreshold;
     CV_PROP_RW double sigma;
+    CV_PROP_RW int descType;
+    CV_PROP_RW int gridSize; // > 1 spreads the nfeatures budget over a grid (see retainBestInGrid)
 };
 
 typedef SIFT SiftFeatureDetector;
@@ -113,9 +190,15 @@ public:
     //! the default constructor
     CV_WRAP SURF();
     //! the full constructor taking all the necessary parameters
+    //! descriptorType selects the descriptor elements: CV_32F, CV_8U (the unit vector components
+    //! mapped linearly from [-1, 1] to [0, 255], so the NORM_L2 distances are scaled by 127.5).
+    //! nfeatures > 0 keeps at most nfeatures keypoints, spread over a gridSize x gridSize grid
+    //! (see retainBestInGrid), before the descriptors are computed.
     explicit CV_WRAP SURF(double hessianThreshold,
                   int nOctaves = 4, int nOctaveLayers = 2,
-                  bool extended = true, bool upright = false);
+                  bool extended = true, bool upright = false,
+                  int descriptorType = CV_32F,
+                  int nfeatures = 0, int gridSize = 1);
 
     //! returns the descriptor size in float's (64 or 128)
     CV_WRAP int descriptorSize() const;
@@ -135,6 +218,46 @@ public:
                     OutputArray descriptors,
                     bool useProvidedKeypoints = false) const;
 
+    //! same as above, but uses a precomputed CV_32S integral image of the grayscale image img
+    //! (as returned by integral()); img itself is only accessed when descriptors are requested.
+    //! computeOrientation=false skips the orientation assignment when no descriptors are requested
+    //! (the keypoints keep angle -1, except with upright=true, where the fixed angle 270 is assigned
+    //! as usual). A non-empty roi restricts the Hessian evaluation to the region and only the
+    //! keypoints located in it are returned.
+    void detectAndComputeIntegral(InputArray img, InputArray sum, InputArray mask,
+                                  CV_OUT std::vector<KeyPoint>& keypoints,
+                                  OutputArray descriptors,
+                                  bool useProvidedKeypoints = false,
+                                  bool computeOrientation = true,
+                                  Rect roi = Rect()) const;
+
+    //! features of the previous frame of a video sequence, kept between detectAndComputeNext() calls
+    struct FrameCache
+    {
+        FrameCache() : tileSize(32), changeThreshold(0), changeFilterSize(0) {}
+
+        Mat frame;                          //!< the reference frame, converted to grayscale
+        std::vector<KeyPoint> keypoints;    //!< all its features, before the nfeatures budget
+        Mat descriptors;
+        int tileSize;                       //!< granularity of the changed regions, in pixels
+        int changeThreshold;                //!< the found changes are the pixels differing by more than this
+        int changeFilterSize;               //!< > 1 drops the found changes smaller than this square
+    };
+
+    //! incremental detection and description for the frames of a mostly static camera.
+    //! changeMask marks the pixels that changed since the previous frame; if it is empty, they are
+    //! found by comparing the frame with the cached one. The Hessian responses are only recomputed
+    //! in the changed tiles extended by the support of the largest filter, the cached keypoints are
+    //! reused elsewhere and their orientation and descriptor are recomputed only when the changes
+    //! reach their own support region. Up to the keypoint order, the result is the same as for
+    //! the full extraction, with nfeatures applied to the merged features. changeThreshold and
+    //! changeFilterSize make the found changes ignore the noise, as in SIFT::detectAndComputeNext().
+    //! The first frame and any change of the frame size are processed in full; the cache must
+    //! be reset (cache = FrameCache()) when the SURF parameters change.
+    void detectAndComputeNext(InputArray img, InputArray changeMask, FrameCache& cache,
+                              CV_OUT std::vector<KeyPoint>& keypoints,
+                              OutputArray descriptors) const;
+
     AlgorithmInfo* info() const;
 
     CV_PROP_RW double hessianThreshold;
@@ -142,6 +265,9 @@ public:
     CV_PROP_RW int nOctaveLayers;
     CV_PROP_RW bool extended;
     CV_PROP_RW bool upright;
+    CV_PROP_RW int descType;
+    CV_PROP_RW int nfeatures; // > 0 limits the keypoints before the descriptors are computed
+    CV_PROP_RW int gridSize; // spreads the nfeatures budget over a grid (see retainBestInGrid)
 
 protected:
     void detectImpl( InputArray image, std::vector<KeyPoint>& keypoints, InputArray mask = noArray() ) const;
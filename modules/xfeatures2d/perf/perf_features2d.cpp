@@ -0,0 +1,296 @@
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::xfeatures2d;
+using namespace perf;
+using std::tr1::make_tuple;
+using std::tr1::get;
+
+// Detection and description of all the xfeatures2d algorithms across image sizes
+// (VGA to 4K UHD), keypoint counts and thread counts, plus the separate stages of SIFT and SURF
+
+#define FEATURES2D_IMAGE "cv/detectors_descriptors_evaluation/images_datasets/leuven/img1.png"
+#define FEATURES2D_SIZES szVGA, sz720p, sz1080p, Size(3840, 2160)
+#define FEATURES2D_THREADS 1, 4
+
+#define XF2D_DETECTORS "SIFT", "SURF", "STAR"
+#define XF2D_EXTRACTORS "SIFT", "SURF", "BRIEF", "FREAK"
+
+static Mat loadFrame(Size size)
+{
+    string filename = getDataPath(FEATURES2D_IMAGE);
+    Mat image = imread(filename, IMREAD_GRAYSCALE), frame;
+    if (!image.empty())
+        resize(image, frame, size);
+    return frame;
+}
+
+// keypoints of random position and scale, away from the border of the frame
+static void randomKeypoints(Size size, int count, vector<KeyPoint>& keypoints)
+{
+    RNG rng(0x5eed);
+    int border = 64;
+    keypoints.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        Point2f pt(rng.uniform((float)border, (float)(size.width - border)),
+                   rng.uniform((float)border, (float)(size.height - border)));
+        keypoints[i] = KeyPoint(pt, rng.uniform(8.f, 32.f), rng.uniform(0.f, 360.f), 1.f);
+    }
+}
+
+static Ptr<FeatureDetector> createDetector(const string& name)
+{
+    if (name == "SIFT")
+        return makePtr<SIFT>();
+    if (name == "SURF")
+        return makePtr<SURF>();
+    if (name == "STAR")
+        return makePtr<StarDetector>();
+    CV_Error(Error::StsBadArg, "unknown detector " + name);
+    return Ptr<FeatureDetector>();
+}
+
+static Ptr<DescriptorExtractor> createExtractor(const string& name)
+{
+    if (name == "SIFT")
+        return makePtr<SIFT>();
+    if (name == "SURF")
+        return makePtr<SURF>();
+    if (name == "BRIEF")
+        return makePtr<BriefDescriptorExtractor>();
+    if (name == "FREAK")
+        return makePtr<FREAK>();
+    CV_Error(Error::StsBadArg, "unknown extractor " + name);
+    return Ptr<DescriptorExtractor>();
+}
+
+typedef std::tr1::tuple<std::string, Size, int> DetectParams_t;
+typedef perf::TestBaseWithParam<DetectParams_t> xfeatures2d_detect;
+
+PERF_TEST_P(xfeatures2d_detect, detect, testing::Combine(testing::Values(XF2D_DETECTORS),
+                                                         testing::Values(FEATURES2D_SIZES),
+                                                         testing::Values(FEATURES2D_THREADS)))
+{
+    string name = get<0>(GetParam());
+    Size size = get<1>(GetParam());
+    int threads = get<2>(GetParam());
+    Mat frame = loadFrame(size);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << FEATURES2D_IMAGE;
+
+    declare.in(frame).time(120);
+
+    Ptr<FeatureDetector> detector = createDetector(name);
+    vector<KeyPoint> points;
+
+    int prevThreads = getNumThreads();
+    setNumThreads(threads);
+    TEST_CYCLE() detector->detect(frame, points);
+    setNumThreads(prevThreads);
+
+    SANITY_CHECK_NOTHING();
+}
+
+typedef std::tr1::tuple<std::string, Size, int, int> ComputeParams_t;
+typedef perf::TestBaseWithParam<ComputeParams_t> xfeatures2d_compute;
+
+PERF_TEST_P(xfeatures2d_compute, compute, testing::Combine(testing::Values(XF2D_EXTRACTORS),
+                                                           testing::Values(FEATURES2D_SIZES),
+                                                           testing::Values(500, 5000),
+                                                           testing::Values(FEATURES2D_THREADS)))
+{
+    string name = get<0>(GetParam());
+    Size size = get<1>(GetParam());
+    int count = get<2>(GetParam());
+    int threads = get<3>(GetParam());
+    Mat frame = loadFrame(size);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << FEATURES2D_IMAGE;
+
+    declare.in(frame).time(120);
+
+    Ptr<DescriptorExtractor> extractor = createExtractor(name);
+    vector<KeyPoint> keypoints, points;
+    Mat descriptors;
+    randomKeypoints(size, count, keypoints);
+
+    int prevThreads = getNumThreads();
+    setNumThreads(threads);
+    // the extractors drop the keypoints they cannot describe, so every run starts from the same set
+    TEST_CYCLE()
+    {
+        points = keypoints;
+        extractor->compute(frame, points, descriptors);
+    }
+    setNumThreads(prevThreads);
+
+    SANITY_CHECK_NOTHING();
+}
+
+typedef std::tr1::tuple<Size, int> StageParams_t;
+typedef perf::TestBaseWithParam<StageParams_t> sift_stages;
+
+PERF_TEST_P(sift_stages, pyramid, testing::Combine(testing::Values(FEATURES2D_SIZES),
+                                                   testing::Values(FEATURES2D_THREADS)))
+{
+    Size size = get<0>(GetParam());
+    int threads = get<1>(GetParam());
+    Mat frame = loadFrame(size);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << FEATURES2D_IMAGE;
+
+    declare.in(frame).time(120);
+
+    SIFT sift;
+    SIFT::Pyramid pyr;
+
+    int prevThreads = getNumThreads();
+    setNumThreads(threads);
+    TEST_CYCLE() sift.buildPyramid(frame, pyr);
+    setNumThreads(prevThreads);
+
+    SANITY_CHECK_NOTHING();
+}
+
+// scale-space extrema search, including the orientation assignment
+PERF_TEST_P(sift_stages, detect, testing::Combine(testing::Values(FEATURES2D_SIZES),
+                                                  testing::Values(FEATURES2D_THREADS)))
+{
+    Size size = get<0>(GetParam());
+    int threads = get<1>(GetParam());
+    Mat frame = loadFrame(size);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << FEATURES2D_IMAGE;
+
+    declare.in(frame).time(120);
+
+    SIFT sift;
+    SIFT::Pyramid pyr;
+    sift.buildPyramid(frame, pyr);
+    vector<KeyPoint> points;
+
+    int prevThreads = getNumThreads();
+    setNumThreads(threads);
+    TEST_CYCLE() sift(pyr, noArray(), points, noArray());
+    setNumThreads(prevThreads);
+
+    SANITY_CHECK_NOTHING();
+}
+
+PERF_TEST_P(sift_stages, describe, testing::Combine(testing::Values(FEATURES2D_SIZES),
+                                                    testing::Values(FEATURES2D_THREADS)))
+{
+    Size size = get<0>(GetParam());
+    int threads = get<1>(GetParam());
+    Mat frame = loadFrame(size);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << FEATURES2D_IMAGE;
+
+    declare.in(frame).time(120);
+
+    SIFT sift;
+    SIFT::Pyramid pyr;
+    vector<KeyPoint> points;
+    Mat descriptors;
+    sift.buildPyramid(frame, pyr);
+    sift(pyr, noArray(), points, noArray());
+
+    int prevThreads = getNumThreads();
+    setNumThreads(threads);
+    TEST_CYCLE() sift(pyr, noArray(), points, descriptors, true);
+    setNumThreads(prevThreads);
+
+    SANITY_CHECK_NOTHING();
+}
+
+typedef perf::TestBaseWithParam<StageParams_t> surf_stages;
+
+PERF_TEST_P(surf_stages, integral, testing::Combine(testing::Values(FEATURES2D_SIZES),
+                                                    testing::Values(FEATURES2D_THREADS)))
+{
+    Size size = get<0>(GetParam());
+    int threads = get<1>(GetParam());
+    Mat frame = loadFrame(size);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << FEATURES2D_IMAGE;
+
+    declare.in(frame);
+
+    Mat sum;
+
+    int prevThreads = getNumThreads();
+    setNumThreads(threads);
+    TEST_CYCLE() integral(frame, sum, CV_32S);
+    setNumThreads(prevThreads);
+
+    SANITY_CHECK_NOTHING();
+}
+
+// Hessian detection only, the keypoints keep angle -1 (the default SURF is not upright)
+PERF_TEST_P(surf_stages, detect, testing::Combine(testing::Values(FEATURES2D_SIZES),
+                                                  testing::Values(FEATURES2D_THREADS)))
+{
+    Size size = get<0>(GetParam());
+    int threads = get<1>(GetParam());
+    Mat frame = loadFrame(size);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << FEATURES2D_IMAGE;
+
+    declare.in(frame).time(120);
+
+    SURF surf;
+    Mat sum;
+    integral(frame, sum, CV_32S);
+    vector<KeyPoint> points;
+
+    int prevThreads = getNumThreads();
+    setNumThreads(threads);
+    TEST_CYCLE() surf.detectAndComputeIntegral(noArray(), sum, noArray(), points, noArray(), false, false);
+    setNumThreads(prevThreads);
+
+    SANITY_CHECK_NOTHING();
+}
+
+// Hessian detection followed by the orientation assignment
+PERF_TEST_P(surf_stages, detect_orient, testing::Combine(testing::Values(FEATURES2D_SIZES),
+                                                         testing::Values(FEATURES2D_THREADS)))
+{
+    Size size = get<0>(GetParam());
+    int threads = get<1>(GetParam());
+    Mat frame = loadFrame(size);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << FEATURES2D_IMAGE;
+
+    declare.in(frame).time(120);
+
+    SURF surf;
+    Mat sum;
+    integral(frame, sum, CV_32S);
+    vector<KeyPoint> points;
+
+    int prevThreads = getNumThreads();
+    setNumThreads(threads);
+    TEST_CYCLE() surf.detectAndComputeIntegral(noArray(), sum, noArray(), points, noArray(), false, true);
+    setNumThreads(prevThreads);
+
+    SANITY_CHECK_NOTHING();
+}
+
+// orientation and descriptors of the detected keypoints
+PERF_TEST_P(surf_stages, describe, testing::Combine(testing::Values(FEATURES2D_SIZES),
+                                                    testing::Values(FEATURES2D_THREADS)))
+{
+    Size size = get<0>(GetParam());
+    int threads = get<1>(GetParam());
+    Mat frame = loadFrame(size);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << FEATURES2D_IMAGE;
+
+    declare.in(frame).time(120);
+
+    SURF surf;
+    Mat sum, descriptors;
+    integral(frame, sum, CV_32S);
+    vector<KeyPoint> points;
+    surf.detectAndComputeIntegral(noArray(), sum, noArray(), points, noArray(), false, false);
+
+    int prevThreads = getNumThreads();
+    setNumThreads(threads);
+    TEST_CYCLE() surf.detectAndComputeIntegral(frame, sum, noArray(), points, descriptors, true);
+    setNumThreads(prevThreads);
+
+    SANITY_CHECK_NOTHING();
+}
@@ -14,6 +14,7 @@
 #include "opencv2/ts.hpp"
 #include "opencv2/xfeatures2d.hpp"
 #include "opencv2/imgcodecs.hpp"
+#include "opencv2/imgproc.hpp"
 
 #include "opencv2/opencv_modules.hpp"
 
@@ -0,0 +1,61 @@
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::xfeatures2d;
+using namespace perf;
+using std::tr1::make_tuple;
+using std::tr1::get;
+
+typedef std::tr1::tuple<std::string, bool> SIFTParams_t;
+typedef perf::TestBaseWithParam<SIFTParams_t> sift;
+
+#define SIFT_IMAGES \
+    "cv/detectors_descriptors_evaluation/images_datasets/leuven/img1.png",\
+    "stitching/a3.png"
+
+// useOptimized == false runs the scalar orientation and descriptor kernels
+PERF_TEST_P(sift, extract, testing::Combine(testing::Values(SIFT_IMAGES), testing::Bool()))
+{
+    string filename = getDataPath(get<0>(GetParam()));
+    bool optimized = get<1>(GetParam());
+    Mat frame = imread(filename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << filename;
+
+    Mat mask;
+    declare.in(frame).time(90);
+
+    SIFT detector;
+    vector<KeyPoint> points;
+    Mat descriptors;
+    detector(frame, mask, points);
+
+    bool wasOptimized = useOptimized();
+    setUseOptimized(optimized);
+    TEST_CYCLE() detector(frame, mask, points, descriptors, true);
+    setUseOptimized(wasOptimized);
+
+    SANITY_CHECK_NOTHING();
+}
+
+PERF_TEST_P(sift, full, testing::Combine(testing::Values(SIFT_IMAGES), testing::Bool()))
+{
+    string filename = getDataPath(get<0>(GetParam()));
+    bool optimized = get<1>(GetParam());
+    Mat frame = imread(filename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << filename;
+
+    Mat mask;
+    declare.in(frame).time(90);
+
+    SIFT detector;
+    vector<KeyPoint> points;
+    Mat descriptors;
+
+    bool wasOptimized = useOptimized();
+    setUseOptimized(optimized);
+    TEST_CYCLE() detector(frame, mask, points, descriptors, false);
+    setUseOptimized(wasOptimized);
+
+    SANITY_CHECK_NOTHING();
+}
@@ -0,0 +1,36 @@
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::xfeatures2d;
+using namespace perf;
+using std::tr1::make_tuple;
+using std::tr1::get;
+
+typedef std::tr1::tuple<std::string, bool> StarParams_t;
+typedef perf::TestBaseWithParam<StarParams_t> star;
+
+#define STAR_IMAGES \
+    "cv/detectors_descriptors_evaluation/images_datasets/leuven/img1.png",\
+    "stitching/a3.png"
+
+// useOptimized == false runs the scalar response kernel
+PERF_TEST_P(star, detect, testing::Combine(testing::Values(STAR_IMAGES), testing::Bool()))
+{
+    string filename = getDataPath(get<0>(GetParam()));
+    bool optimized = get<1>(GetParam());
+    Mat frame = imread(filename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << filename;
+
+    declare.in(frame);
+
+    StarDetector detector;
+    vector<KeyPoint> points;
+
+    bool wasOptimized = useOptimized();
+    setUseOptimized(optimized);
+    TEST_CYCLE() detector(frame, points);
+    setUseOptimized(wasOptimized);
+
+    SANITY_CHECK_NOTHING();
+}
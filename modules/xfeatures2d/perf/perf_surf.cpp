@@ -65,3 +65,30 @@ PERF_TEST_P(surf, full, testing::Values(SURF_IMAGES))
     SANITY_CHECK_KEYPOINTS(points, 1e-3);
     SANITY_CHECK(descriptors, 1e-4);
 }
+
+typedef std::tr1::tuple<std::string, bool> SURFOptParams_t;
+typedef perf::TestBaseWithParam<SURFOptParams_t> surf_optimized;
+
+// useOptimized == false runs the scalar orientation and descriptor kernels
+PERF_TEST_P(surf_optimized, extract, testing::Combine(testing::Values(SURF_IMAGES), testing::Bool()))
+{
+    string filename = getDataPath(get<0>(GetParam()));
+    bool optimized = get<1>(GetParam());
+    Mat frame = imread(filename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << filename;
+
+    Mat mask;
+    declare.in(frame).time(90);
+
+    SURF detector;
+    vector<KeyPoint> points;
+    Mat descriptors;
+    detector(frame, mask, points);
+
+    bool wasOptimized = useOptimized();
+    setUseOptimized(optimized);
+    TEST_CYCLE() detector(frame, mask, points, descriptors, true);
+    setUseOptimized(wasOptimized);
+
+    SANITY_CHECK_NOTHING();
+}
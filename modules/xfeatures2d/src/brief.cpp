@@ -64,10 +64,9 @@ inline int smoothedSum(const Mat& sum, const KeyPoint& pt, int y, int x)
            + sum.at<int>(img_y - HALF_KERNEL, img_x - HALF_KERNEL);
 }
 
-static void pixelTests16(InputArray _sum, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors)
+static void pixelTests16(const Mat& sum, const std::vector<KeyPoint>& keypoints, Mat& descriptors, const Range& range)
 {
-    Mat sum = _sum.getMat(), descriptors = _descriptors.getMat();
-    for (int i = 0; i < (int)keypoints.size(); ++i)
+    for (int i = range.start; i < range.end; ++i)
     {
         uchar* desc = descriptors.ptr(i);
         const KeyPoint& pt = keypoints[i];
@@ -75,10 +74,9 @@ static void pixelTests16(InputArray _sum, const std::vector<KeyPoint>& keypoints
     }
 }
 
-static void pixelTests32(InputArray _sum, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors)
+static void pixelTests32(const Mat& sum, const std::vector<KeyPoint>& keypoints, Mat& descriptors, const Range& range)
 {
-    Mat sum = _sum.getMat(), descriptors = _descriptors.getMat();
-    for (int i = 0; i < (int)keypoints.size(); ++i)
+    for (int i = range.start; i < range.end; ++i)
     {
         uchar* desc = descriptors.ptr(i);
         const KeyPoint& pt = keypoints[i];
@@ -87,10 +85,9 @@ static void pixelTests32(InputArray _sum, const std::vector<KeyPoint>& keypoints
     }
 }
 
-static void pixelTests64(InputArray _sum, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors)
+static void pixelTests64(const Mat& sum, const std::vector<KeyPoint>& keypoints, Mat& descriptors, const Range& range)
 {
-    Mat sum = _sum.getMat(), descriptors = _descriptors.getMat();
-    for (int i = 0; i < (int)keypoints.size(); ++i)
+    for (int i = range.start; i < range.end; ++i)
     {
         uchar* desc = descriptors.ptr(i);
         const KeyPoint& pt = keypoints[i];
@@ -99,6 +96,30 @@ static void pixelTests64(InputArray _sum, const std::vector<KeyPoint>& keypoints
     }
 }
 
+// Runs the pixel tests for a range of keypoints
+struct BriefInvoker : ParallelLoopBody
+{
+    typedef void(*PixelTestFn)(const Mat&, const std::vector<KeyPoint>&, Mat&, const Range&);
+
+    BriefInvoker(PixelTestFn _test_fn, const Mat& _sum, const std::vector<KeyPoint>& _keypoints, Mat& _descriptors)
+    {
+        test_fn = _test_fn;
+        sum = &_sum;
+        keypoints = &_keypoints;
+        descriptors = &_descriptors;
+    }
+
+    void operator()(const Range& range) const
+    {
+        test_fn(*sum, *keypoints, *descriptors, range);
+    }
+
+    PixelTestFn test_fn;
+    const Mat* sum;
+    const std::vector<KeyPoint>* keypoints;
+    Mat* descriptors;
+};
+
 BriefDescriptorExtractor::BriefDescriptorExtractor(int bytes) :
     bytes_(bytes), test_fn_(NULL)
 {
@@ -166,19 +187,27 @@ void BriefDescriptorExtractor::computeImpl(InputArray image, std::vector<KeyPoin
     Mat grayImage = image.getMat();
     if( image.type() != CV_8U ) cvtColor( image, grayImage, COLOR_BGR2GRAY );
 
-    ///TODO allow the user to pass in a precomputed integral image
-    //if(image.type() == CV_32S)
-    //  sum = image;
-    //else
-
     integral( grayImage, sum, CV_32S);
 
+    computeFromIntegral(sum, keypoints, descriptors);
+}
+
+void BriefDescriptorExtractor::computeFromIntegral(InputArray _sum, std::vector<KeyPoint>& keypoints, OutputArray _descriptors) const
+{
+    Mat sum = _sum.getMat();
+    CV_Assert( sum.type() == CV_32SC1 && sum.rows > 1 && sum.cols > 1 );
+
     //Remove keypoints very close to the border
-    KeyPointsFilter::runByImageBorder(keypoints, image.size(), PATCH_SIZE/2 + KERNEL_SIZE/2);
+    KeyPointsFilter::runByImageBorder(keypoints, Size(sum.cols - 1, sum.rows - 1), PATCH_SIZE/2 + KERNEL_SIZE/2);
 
-    descriptors.create((int)keypoints.size(), bytes_, CV_8U);
+    _descriptors.create((int)keypoints.size(), bytes_, CV_8U);
+    Mat descriptors = _descriptors.getMat();
     descriptors.setTo(Scalar::all(0));
-    test_fn_(sum, keypoints, descriptors);
+    if( keypoints.empty() )
+        return;
+
+    parallel_for_( Range(0, (int)keypoints.size()),
+                   BriefInvoker(test_fn_, sum, keypoints, descriptors) );
 }
 
 }
@@ -227,6 +227,18 @@ void FREAK::buildPattern()
         for( int i = 0; i < FREAK_NB_PAIRS; ++i )
              descriptionPairs[i] = allPairs[FREAK_DEF_PAIRS[i]];
     }
+
+    // lay the pair points out in the order the vectorized comparisons consume them: for every block
+    // of 16 pairs the first points followed by the second points, the last pair of the block in lane 0
+    permutedPairs.resize(FREAK_NB_PAIRS*2);
+    for( int cnt = 0; cnt < FREAK_NB_PAIRS; cnt += 16 )
+    {
+        for( int lane = 0; lane < 16; ++lane )
+        {
+            permutedPairs[cnt*2 + lane] = descriptionPairs[cnt + 15 - lane].i;
+            permutedPairs[cnt*2 + 16 + lane] = descriptionPairs[cnt + 15 - lane].j;
+        }
+    }
 }
 
 void FREAK::computeImpl( InputArray _image, std::vector<KeyPoint>& keypoints, OutputArray _descriptors ) const
@@ -297,6 +309,12 @@ void FREAK::extractDescriptor(uchar *pointsValue, void ** ptr) const
 {
     __m128i** ptrSSE = (__m128i**) ptr;
 
+    // gather the pair points in one linear pass, then compare with plain vector loads
+    CV_DECL_ALIGNED(16) uchar operands[FREAK_NB_PAIRS*2];
+    const uchar* perm = &permutedPairs[0];
+    for( int k = 0; k < FREAK_NB_PAIRS*2; ++k )
+        operands[k] = pointsValue[perm[k]];
+
     // note that comparisons order is modified in each block (but first 128 comparisons remain globally the same-->does not affect the 128,384 bits segmanted matching strategy)
     int cnt = 0;
     for( int n = FREAK_NB_PAIRS/128; n-- ; )
@@ -304,39 +322,8 @@ void FREAK::extractDescriptor(uchar *pointsValue, void ** ptr) const
         __m128i result128 = _mm_setzero_si128();
         for( int m = 128/16; m--; cnt += 16 )
         {
-            __m128i operand1 = _mm_set_epi8(pointsValue[descriptionPairs[cnt+0].i],
-                                            pointsValue[descriptionPairs[cnt+1].i],
-                                            pointsValue[descriptionPairs[cnt+2].i],
-                                            pointsValue[descriptionPairs[cnt+3].i],
-                                            pointsValue[descriptionPairs[cnt+4].i],
-                                            pointsValue[descriptionPairs[cnt+5].i],
-                                            pointsValue[descriptionPairs[cnt+6].i],
-                                            pointsValue[descriptionPairs[cnt+7].i],
-                                            pointsValue[descriptionPairs[cnt+8].i],
-                                            pointsValue[descriptionPairs[cnt+9].i],
-                                            pointsValue[descriptionPairs[cnt+10].i],
-                                            pointsValue[descriptionPairs[cnt+11].i],
-                                            pointsValue[descriptionPairs[cnt+12].i],
-                                            pointsValue[descriptionPairs[cnt+13].i],
-                                            pointsValue[descriptionPairs[cnt+14].i],
-                                            pointsValue[descriptionPairs[cnt+15].i]);
-
-            __m128i operand2 = _mm_set_epi8(pointsValue[descriptionPairs[cnt+0].j],
-                                            pointsValue[descriptionPairs[cnt+1].j],
-                                            pointsValue[descriptionPairs[cnt+2].j],
-                                            pointsValue[descriptionPairs[cnt+3].j],
-                                            pointsValue[descriptionPairs[cnt+4].j],
-                                            pointsValue[descriptionPairs[cnt+5].j],
-                                            pointsValue[descriptionPairs[cnt+6].j],
-                                            pointsValue[descriptionPairs[cnt+7].j],
-                                            pointsValue[descriptionPairs[cnt+8].j],
-                                            pointsValue[descriptionPairs[cnt+9].j],
-                                            pointsValue[descriptionPairs[cnt+10].j],
-                                            pointsValue[descriptionPairs[cnt+11].j],
-                                            pointsValue[descriptionPairs[cnt+12].j],
-                                            pointsValue[descriptionPairs[cnt+13].j],
-                                            pointsValue[descriptionPairs[cnt+14].j],
-                                            pointsValue[descriptionPairs[cnt+15].j]);
+            __m128i operand1 = _mm_load_si128((const __m128i*)(operands + cnt*2));
+            __m128i operand2 = _mm_load_si128((const __m128i*)(operands + cnt*2 + 16));
 
             __m128i workReg = _mm_min_epu8(operand1, operand2); // emulated "not less than" for 8-bit UNSIGNED integers
             workReg = _mm_cmpeq_epi8(workReg, operand2);        // emulated "not less than" for 8-bit UNSIGNED integers
@@ -351,180 +338,149 @@ void FREAK::extractDescriptor(uchar *pointsValue, void ** ptr) const
 }
 #endif
 
+// Estimates the orientation and extracts the descriptor of a range of keypoints
 template <typename srcMatType, typename iiMatType>
-void FREAK::computeDescriptors( InputArray _image, std::vector<KeyPoint>& keypoints, OutputArray _descriptors ) const {
-
-    Mat image = _image.getMat();
-    Mat imgIntegral;
-    integral(image, imgIntegral, DataType<iiMatType>::type);
-    std::vector<int> kpScaleIdx(keypoints.size()); // used to save pattern scale index corresponding to each keypoints
-    const std::vector<int>::iterator ScaleIdxBegin = kpScaleIdx.begin(); // used in std::vector erase function
-    const std::vector<cv::KeyPoint>::iterator kpBegin = keypoints.begin(); // used in std::vector erase function
-    const float sizeCst = static_cast<float>(FREAK_NB_SCALES/(FREAK_LOG2* nOctaves));
-    srcMatType pointsValue[FREAK_NB_POINTS];
-    int thetaIdx = 0;
-    int direction0;
-    int direction1;
-
-    // compute the scale index corresponding to the keypoint size and remove keypoints close to the border
-    if( scaleNormalized )
-    {
-        for( size_t k = keypoints.size(); k--; )
-        {
-            //Is k non-zero? If so, decrement it and continue"
-            kpScaleIdx[k] = std::max( (int)(std::log(keypoints[k].size/FREAK_SMALLEST_KP_SIZE)*sizeCst+0.5) ,0);
-            if( kpScaleIdx[k] >= FREAK_NB_SCALES )
-                kpScaleIdx[k] = FREAK_NB_SCALES-1;
-
-            if( keypoints[k].pt.x <= patternSizes[kpScaleIdx[k]] || //check if the description at this specific position and scale fits inside the image
-                 keypoints[k].pt.y <= patternSizes[kpScaleIdx[k]] ||
-                 keypoints[k].pt.x >= image.cols-patternSizes[kpScaleIdx[k]] ||
-                 keypoints[k].pt.y >= image.rows-patternSizes[kpScaleIdx[k]]
-               )
-            {
-                keypoints.erase(kpBegin+k);
-                kpScaleIdx.erase(ScaleIdxBegin+k);
-            }
-        }
-    }
-    else
+struct FREAKDescriptorInvoker : ParallelLoopBody
+{
+    FREAKDescriptorInvoker( const FREAK& _freak, const Mat& _image, const Mat& _imgIntegral,
+                            std::vector<KeyPoint>& _keypoints, const std::vector<int>& _kpScaleIdx,
+                            Mat& _descriptors )
     {
-        const int scIdx = std::max( (int)(1.0986122886681*sizeCst+0.5) ,0);
-        for( size_t k = keypoints.size(); k--; )
-        {
-            kpScaleIdx[k] = scIdx; // equivalent to the formule when the scale is normalized with a constant size of keypoints[k].size=3*SMALLEST_KP_SIZE
-            if( kpScaleIdx[k] >= FREAK_NB_SCALES )
-            {
-                kpScaleIdx[k] = FREAK_NB_SCALES-1;
-            }
-            if( keypoints[k].pt.x <= patternSizes[kpScaleIdx[k]] ||
-                keypoints[k].pt.y <= patternSizes[kpScaleIdx[k]] ||
-                keypoints[k].pt.x >= image.cols-patternSizes[kpScaleIdx[k]] ||
-                keypoints[k].pt.y >= image.rows-patternSizes[kpScaleIdx[k]]
-               )
-            {
-                keypoints.erase(kpBegin+k);
-                kpScaleIdx.erase(ScaleIdxBegin+k);
-            }
-        }
+        freak = &_freak;
+        image = &_image;
+        imgIntegral = &_imgIntegral;
+        keypoints = &_keypoints;
+        kpScaleIdx = &_kpScaleIdx;
+        descriptors = &_descriptors;
     }
 
-    // allocate descriptor memory, estimate orientations, extract descriptors
-    if( !extAll )
+    void operator()(const Range& range) const
     {
-        // extract the best comparisons only
-        _descriptors.create((int)keypoints.size(), FREAK_NB_PAIRS/8, CV_8U);
-        _descriptors.setTo(Scalar::all(0));
-        Mat descriptors = _descriptors.getMat();
+        const FREAK& f = *freak;
+        srcMatType pointsValue[FREAK_NB_POINTS];
+        int thetaIdx = 0;
 
-        void *ptr = descriptors.data+(keypoints.size()-1)*descriptors.step[0];
+        for( int k = range.start; k < range.end; k++ )
+        {
+            KeyPoint& kpt = (*keypoints)[k];
+            const int scaleIdx = (*kpScaleIdx)[k];
 
-        for( size_t k = keypoints.size(); k--; ) {
             // estimate orientation (gradient)
-            if( !orientationNormalized )
+            if( !f.orientationNormalized )
             {
                 thetaIdx = 0; // assign 0° to all keypoints
-                keypoints[k].angle = 0.0;
+                kpt.angle = 0.0;
             }
             else
             {
                 // get the points intensity value in the un-rotated pattern
-                for( int i = FREAK_NB_POINTS; i--; ) {
-                    pointsValue[i] = meanIntensity<srcMatType, iiMatType>(image, imgIntegral,
-                                                                          keypoints[k].pt.x, keypoints[k].pt.y,
-                                                                          kpScaleIdx[k], 0, i);
-                }
-                direction0 = 0;
-                direction1 = 0;
+                for( int i = FREAK_NB_POINTS; i--; )
+                    pointsValue[i] = f.meanIntensity<srcMatType, iiMatType>(*image, *imgIntegral,
+                                                                            kpt.pt.x, kpt.pt.y,
+                                                                            scaleIdx, 0, i);
+                int direction0 = 0;
+                int direction1 = 0;
                 for( int m = 45; m--; )
                 {
                     //iterate through the orientation pairs
-                    const int delta = (pointsValue[ orientationPairs[m].i ]-pointsValue[ orientationPairs[m].j ]);
-                    direction0 += delta*(orientationPairs[m].weight_dx)/2048;
-                    direction1 += delta*(orientationPairs[m].weight_dy)/2048;
+                    const int delta = (pointsValue[ f.orientationPairs[m].i ]-pointsValue[ f.orientationPairs[m].j ]);
+                    direction0 += delta*(f.orientationPairs[m].weight_dx)/2048;
+                    direction1 += delta*(f.orientationPairs[m].weight_dy)/2048;
                 }
 
-                keypoints[k].angle = static_cast<float>(atan2((float)direction1,(float)direction0)*(180.0/CV_PI));//estimate orientation
-                thetaIdx = int(FREAK_NB_ORIENTATION*keypoints[k].angle*(1/360.0)+0.5);
+                kpt.angle = static_cast<float>(atan2((float)direction1,(float)direction0)*(180.0/CV_PI));//estimate orientation
+                thetaIdx = int(FREAK_NB_ORIENTATION*kpt.angle*(1/360.0)+0.5);
                 if( thetaIdx < 0 )
                     thetaIdx += FREAK_NB_ORIENTATION;
 
                 if( thetaIdx >= FREAK_NB_ORIENTATION )
                     thetaIdx -= FREAK_NB_ORIENTATION;
             }
-            // extract descriptor at the computed orientation
-            for( int i = FREAK_NB_POINTS; i--; ) {
-                pointsValue[i] = meanIntensity<srcMatType, iiMatType>(image, imgIntegral,
-                                                                      keypoints[k].pt.x, keypoints[k].pt.y,
-                                                                      kpScaleIdx[k], thetaIdx, i);
-            }
 
-            // Extract descriptor
-            extractDescriptor<srcMatType>(pointsValue, &ptr);
-        }
-    }
-    else // extract all possible comparisons for selection
-    {
-        _descriptors.create((int)keypoints.size(), 128, CV_8U);
-        _descriptors.setTo(Scalar::all(0));
-        Mat descriptors = _descriptors.getMat();
-        std::bitset<1024>* ptr = (std::bitset<1024>*) (descriptors.data+(keypoints.size()-1)*descriptors.step[0]);
+            // get the points intensity value in the rotated pattern
+            for( int i = FREAK_NB_POINTS; i--; )
+                pointsValue[i] = f.meanIntensity<srcMatType, iiMatType>(*image, *imgIntegral,
+                                                                        kpt.pt.x, kpt.pt.y,
+                                                                        scaleIdx, thetaIdx, i);
 
-        for( size_t k = keypoints.size(); k--; )
-        {
-            //estimate orientation (gradient)
-            if( !orientationNormalized )
+            if( !f.extAll )
             {
-                thetaIdx = 0;//assign 0° to all keypoints
-                keypoints[k].angle = 0.0;
+                // extract the best comparisons only
+                void* ptr = descriptors->ptr(k);
+                f.extractDescriptor<srcMatType>(pointsValue, &ptr);
             }
             else
             {
-                //get the points intensity value in the un-rotated pattern
-                for( int i = FREAK_NB_POINTS;i--; )
-                    pointsValue[i] = meanIntensity<srcMatType, iiMatType>(image, imgIntegral,
-                                                                          keypoints[k].pt.x,keypoints[k].pt.y,
-                                                                          kpScaleIdx[k], 0, i);
-
-                direction0 = 0;
-                direction1 = 0;
-                for( int m = 45; m--; )
+                // extract all possible comparisons for selection
+                std::bitset<1024>* ptr = (std::bitset<1024>*)descriptors->ptr(k);
+                int cnt(0);
+                for( int i = 1; i < FREAK_NB_POINTS; ++i )
                 {
-                    //iterate through the orientation pairs
-                    const int delta = (pointsValue[ orientationPairs[m].i ]-pointsValue[ orientationPairs[m].j ]);
-                    direction0 += delta*(orientationPairs[m].weight_dx)/2048;
-                    direction1 += delta*(orientationPairs[m].weight_dy)/2048;
+                    //(generate all the pairs)
+                    for( int j = 0; j < i; ++j )
+                    {
+                        ptr->set(cnt, pointsValue[i] >= pointsValue[j] );
+                        ++cnt;
+                    }
                 }
+            }
+        }
+    }
 
-                keypoints[k].angle = static_cast<float>(atan2((float)direction1,(float)direction0)*(180.0/CV_PI)); //estimate orientation
-                thetaIdx = int(FREAK_NB_ORIENTATION*keypoints[k].angle*(1/360.0)+0.5);
+    const FREAK* freak;
+    const Mat* image;
+    const Mat* imgIntegral;
+    std::vector<KeyPoint>* keypoints;
+    const std::vector<int>* kpScaleIdx;
+    Mat* descriptors;
+};
 
-                if( thetaIdx < 0 )
-                    thetaIdx += FREAK_NB_ORIENTATION;
+template <typename srcMatType, typename iiMatType>
+void FREAK::computeDescriptors( InputArray _image, std::vector<KeyPoint>& keypoints, OutputArray _descriptors ) const {
 
-                if( thetaIdx >= FREAK_NB_ORIENTATION )
-                    thetaIdx -= FREAK_NB_ORIENTATION;
-            }
-            // get the points intensity value in the rotated pattern
-            for( int i = FREAK_NB_POINTS; i--; ) {
-                pointsValue[i] = meanIntensity<srcMatType, iiMatType>(image, imgIntegral,
-                                                                      keypoints[k].pt.x, keypoints[k].pt.y,
-                                                                      kpScaleIdx[k], thetaIdx, i);
-            }
+    Mat image = _image.getMat();
+    Mat imgIntegral;
+    integral(image, imgIntegral, DataType<iiMatType>::type);
+    std::vector<int> kpScaleIdx(keypoints.size()); // used to save pattern scale index corresponding to each keypoints
+    const float sizeCst = static_cast<float>(FREAK_NB_SCALES/(FREAK_LOG2* nOctaves));
 
-            int cnt(0);
-            for( int i = 1; i < FREAK_NB_POINTS; ++i )
-            {
-                //(generate all the pairs)
-                for( int j = 0; j < i; ++j )
-                {
-                    ptr->set(cnt, pointsValue[i] >= pointsValue[j] );
-                    ++cnt;
-                }
-            }
-            --ptr;
+    // compute the scale index corresponding to the keypoint size and remove keypoints close to the border,
+    // compacting the kept keypoints in place
+    const int fixedScaleIdx = std::min( std::max( (int)(1.0986122886681*sizeCst+0.5) ,0), FREAK_NB_SCALES-1 );
+    size_t nkept = 0;
+    for( size_t k = 0; k < keypoints.size(); k++ )
+    {
+        int scIdx = fixedScaleIdx; // equivalent to the formule when the scale is normalized with a constant size of keypoints[k].size=3*SMALLEST_KP_SIZE
+        if( scaleNormalized )
+        {
+            scIdx = std::max( (int)(std::log(keypoints[k].size/FREAK_SMALLEST_KP_SIZE)*sizeCst+0.5) ,0);
+            if( scIdx >= FREAK_NB_SCALES )
+                scIdx = FREAK_NB_SCALES-1;
         }
+
+        if( keypoints[k].pt.x <= patternSizes[scIdx] || //check if the description at this specific position and scale fits inside the image
+            keypoints[k].pt.y <= patternSizes[scIdx] ||
+            keypoints[k].pt.x >= image.cols-patternSizes[scIdx] ||
+            keypoints[k].pt.y >= image.rows-patternSizes[scIdx]
+           )
+            continue;
+
+        if( nkept != k )
+            keypoints[nkept] = keypoints[k];
+        kpScaleIdx[nkept++] = scIdx;
     }
+    keypoints.resize(nkept);
+    kpScaleIdx.resize(nkept);
+
+    // allocate descriptor memory, estimate orientations, extract descriptors
+    _descriptors.create((int)keypoints.size(), extAll ? 128 : FREAK_NB_PAIRS/8, CV_8U);
+    _descriptors.setTo(Scalar::all(0));
+    if( keypoints.empty() )
+        return;
+
+    Mat descriptors = _descriptors.getMat();
+    parallel_for_( Range(0, (int)keypoints.size()),
+                   FREAKDescriptorInvoker<srcMatType, iiMatType>(*this, image, imgIntegral, keypoints, kpScaleIdx, descriptors) );
 }
 
 // simply take average on a square patch, not even gaussian approx
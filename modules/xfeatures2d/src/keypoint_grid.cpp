@@ -0,0 +1,144 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000-2008, Intel Corporation, all rights reserved.
+// Copyright (C) 2009-2010, Willow Garage Inc., all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "precomp.hpp"
+#include <algorithm>
+
+namespace cv
+{
+namespace xfeatures2d
+{
+
+// Orders the keypoints of a cell by decreasing response
+struct KeypointResponseGreater
+{
+    KeypointResponseGreater( const std::vector<KeyPoint>& _keypoints ) : keypoints(&_keypoints) {}
+
+    bool operator()( int a, int b ) const
+    {
+        float ra = (*keypoints)[a].response, rb = (*keypoints)[b].response;
+        return ra > rb || (ra == rb && a < b);
+    }
+
+    const std::vector<KeyPoint>* keypoints;
+};
+
+// Orders the keypoints by their rank within their cell, then by decreasing response
+struct KeypointRankLess
+{
+    KeypointRankLess( const std::vector<KeyPoint>& _keypoints, const std::vector<int>& _rank )
+        : keypoints(&_keypoints), rank(&_rank) {}
+
+    bool operator()( int a, int b ) const
+    {
+        int ka = (*rank)[a], kb = (*rank)[b];
+        if( ka != kb )
+            return ka < kb;
+        float ra = (*keypoints)[a].response, rb = (*keypoints)[b].response;
+        return ra > rb || (ra == rb && a < b);
+    }
+
+    const std::vector<KeyPoint>* keypoints;
+    const std::vector<int>* rank;
+};
+
+void retainBestInGrid( std::vector<KeyPoint>& keypoints, Size imageSize, int maxKeypoints, int gridSize )
+{
+    CV_Assert( gridSize > 0 );
+
+    int i, n = (int)keypoints.size();
+    if( maxKeypoints < 0 || n <= maxKeypoints )
+        return;
+    if( maxKeypoints == 0 )
+    {
+        keypoints.clear();
+        return;
+    }
+
+    // bucket the keypoints by cell, keeping their order
+    int ncells = gridSize*gridSize;
+    float sx = (float)gridSize/std::max(imageSize.width, 1);
+    float sy = (float)gridSize/std::max(imageSize.height, 1);
+    std::vector<int> cellOf(n), cellStart(ncells + 1, 0), order(n);
+
+    for( i = 0; i < n; i++ )
+    {
+        int cx = std::min(std::max(cvFloor(keypoints[i].pt.x*sx), 0), gridSize - 1);
+        int cy = std::min(std::max(cvFloor(keypoints[i].pt.y*sy), 0), gridSize - 1);
+        cellOf[i] = cy*gridSize + cx;
+        cellStart[cellOf[i] + 1]++;
+    }
+    for( i = 0; i < ncells; i++ )
+        cellStart[i + 1] += cellStart[i];
+    {
+        std::vector<int> pos(cellStart.begin(), cellStart.end() - 1);
+        for( i = 0; i < n; i++ )
+            order[pos[cellOf[i]]++] = i;
+    }
+
+    // rank the keypoints of every cell by response
+    std::vector<int> rank(n);
+    for( int c = 0; c < ncells; c++ )
+    {
+        std::vector<int>::iterator first = order.begin() + cellStart[c], last = order.begin() + cellStart[c + 1];
+        std::sort(first, last, KeypointResponseGreater(keypoints));
+        for( i = cellStart[c]; i < cellStart[c + 1]; i++ )
+            rank[order[i]] = i - cellStart[c];
+    }
+
+    // the budget is shared round-robin between the cells: the best keypoint of every cell
+    // goes first, then the second best and so on; the cells that run out leave their share to the others
+    std::vector<int> idx(n);
+    for( i = 0; i < n; i++ )
+        idx[i] = i;
+    std::nth_element(idx.begin(), idx.begin() + maxKeypoints, idx.end(), KeypointRankLess(keypoints, rank));
+    idx.resize(maxKeypoints);
+    std::sort(idx.begin(), idx.end());
+
+    std::vector<KeyPoint> kept(maxKeypoints);
+    for( i = 0; i < maxKeypoints; i++ )
+        kept[i] = keypoints[idx[i]];
+    keypoints.swap(kept);
+}
+
+}
+}
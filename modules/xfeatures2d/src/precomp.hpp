@@ -62,4 +62,15 @@
 
 #include "opencv2/core/private.hpp"
 
+namespace cv
+{
+namespace xfeatures2d
+{
+
+// the change mask of detectAndComputeNext(), defined in sift.cpp
+void findChanges( const Mat& frame, const Mat& reference, int threshold, int filterSize, Mat& changes );
+
+}
+}
+
 #endif
@@ -236,21 +236,41 @@ void SIFT::buildGaussianPyramid( const Mat& base, std::vector<Mat>& pyr, int nOc
 }
 
 
-void SIFT::buildDoGPyramid( const std::vector<Mat>& gpyr, std::vector<Mat>& dogpyr ) const
+// Multi-threaded construction of the DoG pyramid, one task per octave layer
+struct SIFTBuildDoGInvoker : ParallelLoopBody
 {
-    int nOctaves = (int)gpyr.size()/(nOctaveLayers + 3);
-    dogpyr.resize( nOctaves*(nOctaveLayers + 2) );
+    SIFTBuildDoGInvoker( int _nOctaveLayers, const std::vector<Mat>& _gpyr, std::vector<Mat>& _dogpyr )
+    {
+        nOctaveLayers = _nOctaveLayers;
+        gpyr = &_gpyr;
+        dogpyr = &_dogpyr;
+    }
 
-    for( int o = 0; o < nOctaves; o++ )
+    void operator()(const Range& range) const
     {
-        for( int i = 0; i < nOctaveLayers + 2; i++ )
+        for( int a = range.start; a < range.end; a++ )
         {
-            const Mat& src1 = gpyr[o*(nOctaveLayers + 3) + i];
-            const Mat& src2 = gpyr[o*(nOctaveLayers + 3) + i + 1];
-            Mat& dst = dogpyr[o*(nOctaveLayers + 2) + i];
+            const int o = a / (nOctaveLayers + 2);
+            const int i = a % (nOctaveLayers + 2);
+
+            const Mat& src1 = (*gpyr)[o*(nOctaveLayers + 3) + i];
+            const Mat& src2 = (*gpyr)[o*(nOctaveLayers + 3) + i + 1];
+            Mat& dst = (*dogpyr)[o*(nOctaveLayers + 2) + i];
             subtract(src2, src1, dst, noArray(), DataType<sift_wt>::type);
         }
     }
+
+    int nOctaveLayers;
+    const std::vector<Mat>* gpyr;
+    std::vector<Mat>* dogpyr;
+};
+
+void SIFT::buildDoGPyramid( const std::vector<Mat>& gpyr, std::vector<Mat>& dogpyr ) const
+{
+    int nOctaves = (int)gpyr.size()/(nOctaveLayers + 3);
+    dogpyr.resize( nOctaves*(nOctaveLayers + 2) );
+
+    parallel_for_( Range(0, nOctaves*(nOctaveLayers + 2)), SIFTBuildDoGInvoker(nOctaveLayers, gpyr, dogpyr) );
 }
 
 
@@ -268,22 +288,52 @@ static float calcOrientationHist( const Mat& img, Point pt, int radius,
     for( i = 0; i < n; i++ )
         temphist[i] = 0.f;
 
+#if CV_SSE2
+    bool useSIMD = checkHardwareSupport(CV_CPU_SSE2) && DataType<sift_wt>::depth == CV_32F;
+    const __m128 j_ofs4 = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+    const __m128 expf_scale4 = _mm_set1_ps(expf_scale);
+#endif
+
     for( i = -radius, k = 0; i <= radius; i++ )
     {
         int y = pt.y + i;
         if( y <= 0 || y >= img.rows - 1 )
             continue;
-        for( j = -radius; j <= radius; j++ )
+
+        const sift_wt* row = img.ptr<sift_wt>(y);
+        const sift_wt* prevrow = img.ptr<sift_wt>(y-1);
+        const sift_wt* nextrow = img.ptr<sift_wt>(y+1);
+
+        // only the samples with 0 < x < img.cols - 1 are used
+        int j0 = std::max(-radius, 1 - pt.x), j1 = std::min(radius, img.cols - 2 - pt.x);
+        j = j0;
+
+#if CV_SSE2
+        if( useSIMD )
+        {
+            __m128 ii4 = _mm_set1_ps((float)(i*i));
+            for( ; j <= j1 - 3; j += 4, k += 4 )
+            {
+                int x = pt.x + j;
+                __m128 dx = _mm_sub_ps(_mm_loadu_ps((const float*)row + x + 1), _mm_loadu_ps((const float*)row + x - 1));
+                __m128 dy = _mm_sub_ps(_mm_loadu_ps((const float*)prevrow + x), _mm_loadu_ps((const float*)nextrow + x));
+                __m128 j4 = _mm_add_ps(_mm_set1_ps((float)j), j_ofs4);
+                __m128 w = _mm_mul_ps(_mm_add_ps(ii4, _mm_mul_ps(j4, j4)), expf_scale4);
+                _mm_storeu_ps(X + k, dx);
+                _mm_storeu_ps(Y + k, dy);
+                _mm_storeu_ps(W + k, w);
+            }
+        }
+#endif
+
+        for( ; j <= j1; j++, k++ )
         {
             int x = pt.x + j;
-            if( x <= 0 || x >= img.cols - 1 )
-                continue;
 
-            float dx = (float)(img.at<sift_wt>(y, x+1) - img.at<sift_wt>(y, x-1));
-            float dy = (float)(img.at<sift_wt>(y-1, x) - img.at<sift_wt>(y+1, x));
+            float dx = (float)(row[x+1] - row[x-1]);
+            float dy = (float)(prevrow[x] - nextrow[x]);
 
             X[k] = dx; Y[k] = dy; W[k] = (i*i + j*j)*expf_scale;
-            k++;
         }
     }
 
@@ -294,7 +344,32 @@ static float calcOrientationHist( const Mat& img, Point pt, int radius,
     fastAtan2(Y, X, Ori, len, true);
     magnitude(X, Y, Mag, len);
 
-    for( k = 0; k < len; k++ )
+    k = 0;
+#if CV_SSE2
+    if( useSIMD )
+    {
+        int CV_DECL_ALIGNED(16) bins[4];
+        float CV_DECL_ALIGNED(16) w[4];
+        const __m128 nd360 = _mm_set1_ps(n/360.f);
+        const __m128i n4 = _mm_set1_epi32(n), z4 = _mm_setzero_si128();
+        for( ; k <= len - 4; k += 4 )
+        {
+            __m128i bin = _mm_cvtps_epi32(_mm_mul_ps(nd360, _mm_loadu_ps(Ori + k)));
+            // bin -= n where bin >= n; bin += n where bin < 0
+            bin = _mm_sub_epi32(bin, _mm_andnot_si128(_mm_cmplt_epi32(bin, n4), n4));
+            bin = _mm_add_epi32(bin, _mm_and_si128(_mm_cmplt_epi32(bin, z4), n4));
+            _mm_store_si128((__m128i*)bins, bin);
+            _mm_store_ps(w, _mm_mul_ps(_mm_loadu_ps(W + k), _mm_loadu_ps(Mag + k)));
+
+            temphist[bins[0]] += w[0];
+            temphist[bins[1]] += w[1];
+            temphist[bins[2]] += w[2];
+            temphist[bins[3]] += w[3];
+        }
+    }
+#endif
+
+    for( ; k < len; k++ )
     {
         int bin = cvRound((n/360.f)*Ori[k]);
         if( bin >= n )
@@ -431,6 +506,127 @@ static bool adjustLocalExtrema( const std::vector<Mat>& dog_pyr, KeyPoint& kpt,
 }
 
 
+// A horizontal stripe of one DoG layer searched for extrema by a single task
+struct SIFTExtremaTile
+{
+    int octave, layer;
+    Range rows;
+};
+
+// Multi-threaded search of the DoG pyramid for keypoints. Every tile stores its keypoints
+// separately, so the concatenated result does not depend on the scheduling.
+struct SIFTFindExtremaInvoker : ParallelLoopBody
+{
+    SIFTFindExtremaInvoker( const std::vector<Mat>& _gauss_pyr, const std::vector<Mat>& _dog_pyr,
+                            const std::vector<SIFTExtremaTile>& _tiles,
+                            std::vector<std::vector<KeyPoint> >& _tileKeypoints,
+                            int _nOctaveLayers, double _contrastThreshold, double _edgeThreshold, double _sigma )
+    {
+        gauss_pyr = &_gauss_pyr;
+        dog_pyr = &_dog_pyr;
+        tiles = &_tiles;
+        tileKeypoints = &_tileKeypoints;
+        nOctaveLayers = _nOctaveLayers;
+        contrastThreshold = (float)_contrastThreshold;
+        edgeThreshold = (float)_edgeThreshold;
+        sigma = (float)_sigma;
+        threshold = cvFloor(0.5 * _contrastThreshold / _nOctaveLayers * 255 * SIFT_FIXPT_SCALE);
+    }
+
+    void operator()(const Range& range) const
+    {
+        for( int t = range.start; t < range.end; t++ )
+            findExtrema( (*tiles)[t], (*tileKeypoints)[t] );
+    }
+
+    void findExtrema( const SIFTExtremaTile& tile, std::vector<KeyPoint>& keypoints ) const
+    {
+        const int n = SIFT_ORI_HIST_BINS;
+        float hist[n];
+        KeyPoint kpt;
+
+        int o = tile.octave, i = tile.layer;
+        int idx = o*(nOctaveLayers+2)+i;
+        const Mat& img = (*dog_pyr)[idx];
+        const Mat& prev = (*dog_pyr)[idx-1];
+        const Mat& next = (*dog_pyr)[idx+1];
+        int step = (int)img.step1();
+        int cols = img.cols;
+
+        for( int r = tile.rows.start; r < tile.rows.end; r++)
+        {
+            const sift_wt* currptr = img.ptr<sift_wt>(r);
+            const sift_wt* prevptr = prev.ptr<sift_wt>(r);
+            const sift_wt* nextptr = next.ptr<sift_wt>(r);
+
+            for( int c = SIFT_IMG_BORDER; c < cols-SIFT_IMG_BORDER; c++)
+            {
+                sift_wt val = currptr[c];
+
+                // find local extrema with pixel accuracy
+                if( std::abs(val) > threshold &&
+                   ((val > 0 && val >= currptr[c-1] && val >= currptr[c+1] &&
+                     val >= currptr[c-step-1] && val >= currptr[c-step] && val >= currptr[c-step+1] &&
+                     val >= currptr[c+step-1] && val >= currptr[c+step] && val >= currptr[c+step+1] &&
+                     val >= nextptr[c] && val >= nextptr[c-1] && val >= nextptr[c+1] &&
+                     val >= nextptr[c-step-1] && val >= nextptr[c-step] && val >= nextptr[c-step+1] &&
+                     val >= nextptr[c+step-1] && val >= nextptr[c+step] && val >= nextptr[c+step+1] &&
+                     val >= prevptr[c] && val >= prevptr[c-1] && val >= prevptr[c+1] &&
+                     val >= prevptr[c-step-1] && val >= prevptr[c-step] && val >= prevptr[c-step+1] &&
+                     val >= prevptr[c+step-1] && val >= prevptr[c+step] && val >= prevptr[c+step+1]) ||
+                    (val < 0 && val <= currptr[c-1] && val <= currptr[c+1] &&
+                     val <= currptr[c-step-1] && val <= currptr[c-step] && val <= currptr[c-step+1] &&
+                     val <= currptr[c+step-1] && val <= currptr[c+step] && val <= currptr[c+step+1] &&
+                     val <= nextptr[c] && val <= nextptr[c-1] && val <= nextptr[c+1] &&
+                     val <= nextptr[c-step-1] && val <= nextptr[c-step] && val <= nextptr[c-step+1] &&
+                     val <= nextptr[c+step-1] && val <= nextptr[c+step] && val <= nextptr[c+step+1] &&
+                     val <= prevptr[c] && val <= prevptr[c-1] && val <= prevptr[c+1] &&
+                     val <= prevptr[c-step-1] && val <= prevptr[c-step] && val <= prevptr[c-step+1] &&
+                     val <= prevptr[c+step-1] && val <= prevptr[c+step] && val <= prevptr[c+step+1])))
+                {
+                    int r1 = r, c1 = c, layer = i;
+                    if( !adjustLocalExtrema(*dog_pyr, kpt, o, layer, r1, c1,
+                                            nOctaveLayers, contrastThreshold,
+                                            edgeThreshold, sigma) )
+                        continue;
+                    float scl_octv = kpt.size*0.5f/(1 << o);
+                    float omax = calcOrientationHist((*gauss_pyr)[o*(nOctaveLayers+3) + layer],
+                                                     Point(c1, r1),
+                                                     cvRound(SIFT_ORI_RADIUS * scl_octv),
+                                                     SIFT_ORI_SIG_FCTR * scl_octv,
+                                                     hist, n);
+                    float mag_thr = (float)(omax * SIFT_ORI_PEAK_RATIO);
+                    for( int j = 0; j < n; j++ )
+                    {
+                        int l = j > 0 ? j - 1 : n - 1;
+                        int r2 = j < n-1 ? j + 1 : 0;
+
+                        if( hist[j] > hist[l]  &&  hist[j] > hist[r2]  &&  hist[j] >= mag_thr )
+                        {
+                            float bin = j + 0.5f * (hist[l]-hist[r2]) / (hist[l] - 2*hist[j] + hist[r2]);
+                            bin = bin < 0 ? n + bin : bin >= n ? bin - n : bin;
+                            kpt.angle = 360.f - (float)((360.f/n) * bin);
+                            if(std::abs(kpt.angle - 360.f) < FLT_EPSILON)
+                                kpt.angle = 0.f;
+                            keypoints.push_back(kpt);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    const std::vector<Mat>* gauss_pyr;
+    const std::vector<Mat>* dog_pyr;
+    const std::vector<SIFTExtremaTile>* tiles;
+    std::vector<std::vector<KeyPoint> >* tileKeypoints;
+    int nOctaveLayers;
+    float contrastThreshold;
+    float edgeThreshold;
+    float sigma;
+    int threshold;
+};
+
 //
 // Detects features at extrema in DoG scale space.  Bad features are discarded
 // based on contrast and ratio of principal curvatures.
@@ -438,90 +634,42 @@ void SIFT::findScaleSpaceExtrema( const std::vector<Mat>& gauss_pyr, const std::
                                   std::vector<KeyPoint>& keypoints ) const
 {
     int nOctaves = (int)gauss_pyr.size()/(nOctaveLayers + 3);
-    int threshold = cvFloor(0.5 * contrastThreshold / nOctaveLayers * 255 * SIFT_FIXPT_SCALE);
-    const int n = SIFT_ORI_HIST_BINS;
-    float hist[n];
-    KeyPoint kpt;
+    std::vector<SIFTExtremaTile> tiles;
 
     keypoints.clear();
 
+    // split every layer into stripes of about 64K pixels
     for( int o = 0; o < nOctaves; o++ )
         for( int i = 1; i <= nOctaveLayers; i++ )
         {
-            int idx = o*(nOctaveLayers+2)+i;
-            const Mat& img = dog_pyr[idx];
-            const Mat& prev = dog_pyr[idx-1];
-            const Mat& next = dog_pyr[idx+1];
-            int step = (int)img.step1();
-            int rows = img.rows, cols = img.cols;
-
-            for( int r = SIFT_IMG_BORDER; r < rows-SIFT_IMG_BORDER; r++)
+            const Mat& img = dog_pyr[o*(nOctaveLayers+2)+i];
+            int stripeRows = std::max((1 << 16) / std::max(img.cols, 1), 1);
+            for( int r = SIFT_IMG_BORDER; r < img.rows-SIFT_IMG_BORDER; r += stripeRows )
             {
-                const sift_wt* currptr = img.ptr<sift_wt>(r);
-                const sift_wt* prevptr = prev.ptr<sift_wt>(r);
-                const sift_wt* nextptr = next.ptr<sift_wt>(r);
-
-                for( int c = SIFT_IMG_BORDER; c < cols-SIFT_IMG_BORDER; c++)
-                {
-                    sift_wt val = currptr[c];
-
-                    // find local extrema with pixel accuracy
-                    if( std::abs(val) > threshold &&
-                       ((val > 0 && val >= currptr[c-1] && val >= currptr[c+1] &&
-                         val >= currptr[c-step-1] && val >= currptr[c-step] && val >= currptr[c-step+1] &&
-                         val >= currptr[c+step-1] && val >= currptr[c+step] && val >= currptr[c+step+1] &&
-                         val >= nextptr[c] && val >= nextptr[c-1] && val >= nextptr[c+1] &&
-                         val >= nextptr[c-step-1] && val >= nextptr[c-step] && val >= nextptr[c-step+1] &&
-                         val >= nextptr[c+step-1] && val >= nextptr[c+step] && val >= nextptr[c+step+1] &&
-                         val >= prevptr[c] && val >= prevptr[c-1] && val >= prevptr[c+1] &&
-                         val >= prevptr[c-step-1] && val >= prevptr[c-step] && val >= prevptr[c-step+1] &&
-                         val >= prevptr[c+step-1] && val >= prevptr[c+step] && val >= prevptr[c+step+1]) ||
-                        (val < 0 && val <= currptr[c-1] && val <= currptr[c+1] &&
-                         val <= currptr[c-step-1] && val <= currptr[c-step] && val <= currptr[c-step+1] &&
-                         val <= currptr[c+step-1] && val <= currptr[c+step] && val <= currptr[c+step+1] &&
-                         val <= nextptr[c] && val <= nextptr[c-1] && val <= nextptr[c+1] &&
-                         val <= nextptr[c-step-1] && val <= nextptr[c-step] && val <= nextptr[c-step+1] &&
-                         val <= nextptr[c+step-1] && val <= nextptr[c+step] && val <= nextptr[c+step+1] &&
-                         val <= prevptr[c] && val <= prevptr[c-1] && val <= prevptr[c+1] &&
-                         val <= prevptr[c-step-1] && val <= prevptr[c-step] && val <= prevptr[c-step+1] &&
-                         val <= prevptr[c+step-1] && val <= prevptr[c+step] && val <= prevptr[c+step+1])))
-                    {
-                        int r1 = r, c1 = c, layer = i;
-                        if( !adjustLocalExtrema(dog_pyr, kpt, o, layer, r1, c1,
-                                                nOctaveLayers, (float)contrastThreshold,
-                                                (float)edgeThreshold, (float)sigma) )
-                            continue;
-                        float scl_octv = kpt.size*0.5f/(1 << o);
-                        float omax = calcOrientationHist(gauss_pyr[o*(nOctaveLayers+3) + layer],
-                                                         Point(c1, r1),
-                                                         cvRound(SIFT_ORI_RADIUS * scl_octv),
-                                                         SIFT_ORI_SIG_FCTR * scl_octv,
-                                                         hist, n);
-                        float mag_thr = (float)(omax * SIFT_ORI_PEAK_RATIO);
-                        for( int j = 0; j < n; j++ )
-                        {
-                            int l = j > 0 ? j - 1 : n - 1;
-                            int r2 = j < n-1 ? j + 1 : 0;
-
-                            if( hist[j] > hist[l]  &&  hist[j] > hist[r2]  &&  hist[j] >= mag_thr )
-                            {
-                                float bin = j + 0.5f * (hist[l]-hist[r2]) / (hist[l] - 2*hist[j] + hist[r2]);
-                                bin = bin < 0 ? n + bin : bin >= n ? bin - n : bin;
-                                kpt.angle = 360.f - (float)((360.f/n) * bin);
-                                if(std::abs(kpt.angle - 360.f) < FLT_EPSILON)
-                                    kpt.angle = 0.f;
-                                keypoints.push_back(kpt);
-                            }
-                        }
-                    }
-                }
+                SIFTExtremaTile tile;
+                tile.octave = o;
+                tile.layer = i;
+                tile.rows = Range(r, std::min(r + stripeRows, img.rows-SIFT_IMG_BORDER));
+                tiles.push_back(tile);
             }
         }
+
+    std::vector<std::vector<KeyPoint> > tileKeypoints(tiles.size());
+    parallel_for_( Range(0, (int)tiles.size()),
+                   SIFTFindExtremaInvoker(gauss_pyr, dog_pyr, tiles, tileKeypoints,
+                                          nOctaveLayers, contrastThreshold, edgeThreshold, sigma) );
+
+    size_t total = 0;
+    for( size_t t = 0; t < tileKeypoints.size(); t++ )
+        total += tileKeypoints[t].size();
+    keypoints.reserve(total);
+    for( size_t t = 0; t < tileKeypoints.size(); t++ )
+        keypoints.insert(keypoints.end(), tileKeypoints[t].begin(), tileKeypoints[t].end());
 }
 
 
 static void calcSIFTDescriptor( const Mat& img, Point2f ptf, float ori, float scl,
-                               int d, int n, float* dst )
+                               int d, int n, uchar* dst, int dstType )
 {
     Point pt(cvRound(ptf.x), cvRound(ptf.y));
     float cos_t = cosf(ori*(float)(CV_PI/180));
@@ -538,7 +686,7 @@ static void calcSIFTDescriptor( const Mat& img, Point2f ptf, float ori, float sc
     int i, j, k, len = (radius*2+1)*(radius*2+1), histlen = (d+2)*(d+2)*(n+2);
     int rows = img.rows, cols = img.cols;
 
-    AutoBuffer<float> buf(len*6 + histlen);
+    AutoBuffer<float> buf(len*6 + histlen + d*d*n);
     float *X = buf, *Y = X + len, *Mag = Y, *Ori = Mag + len, *W = Ori + len;
     float *RBin = W + len, *CBin = RBin + len, *hist = CBin + len;
 
@@ -577,7 +725,78 @@ static void calcSIFTDescriptor( const Mat& img, Point2f ptf, float ori, float sc
     magnitude(X, Y, Mag, len);
     exp(W, W, len);
 
-    for( k = 0; k < len; k++ )
+    k = 0;
+#if CV_SSE2
+    if( checkHardwareSupport(CV_CPU_SSE2) )
+    {
+        int CV_DECL_ALIGNED(16) idx_buf[4];
+        float CV_DECL_ALIGNED(16) rco_buf[32];
+        const __m128 bins_per_rad4 = _mm_set1_ps(bins_per_rad), ori4 = _mm_set1_ps(ori);
+        const __m128 one4 = _mm_set1_ps(1.f), d_plus_2 = _mm_set1_ps((float)(d+2)), n_plus_2 = _mm_set1_ps((float)(n+2));
+        const __m128i n4 = _mm_set1_epi32(n), z4 = _mm_setzero_si128();
+
+        for( ; k <= len - 4; k += 4 )
+        {
+            __m128 rbin = _mm_loadu_ps(RBin + k), cbin = _mm_loadu_ps(CBin + k);
+            __m128 obin = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(Ori + k), ori4), bins_per_rad4);
+            __m128 mag = _mm_mul_ps(_mm_loadu_ps(Mag + k), _mm_loadu_ps(W + k));
+
+            // floor: round to nearest and step back where the rounded value is larger
+            __m128i r0 = _mm_cvtps_epi32(rbin);
+            __m128i c0 = _mm_cvtps_epi32(cbin);
+            __m128i o0 = _mm_cvtps_epi32(obin);
+            r0 = _mm_add_epi32(r0, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(r0), rbin)));
+            c0 = _mm_add_epi32(c0, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(c0), cbin)));
+            o0 = _mm_add_epi32(o0, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(o0), obin)));
+            __m128 r0f = _mm_cvtepi32_ps(r0), c0f = _mm_cvtepi32_ps(c0);
+            rbin = _mm_sub_ps(rbin, r0f);
+            cbin = _mm_sub_ps(cbin, c0f);
+            obin = _mm_sub_ps(obin, _mm_cvtepi32_ps(o0));
+
+            o0 = _mm_add_epi32(o0, _mm_and_si128(_mm_cmplt_epi32(o0, z4), n4));
+            o0 = _mm_sub_epi32(o0, _mm_andnot_si128(_mm_cmplt_epi32(o0, n4), n4));
+
+            // the bin index is small enough to be computed exactly in floating point
+            __m128 idx = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(r0f, one4), d_plus_2),
+                                                          _mm_add_ps(c0f, one4)), n_plus_2),
+                                    _mm_cvtepi32_ps(o0));
+            _mm_store_si128((__m128i*)idx_buf, _mm_cvtps_epi32(idx));
+
+            // histogram update using tri-linear interpolation
+            __m128 v_r1 = _mm_mul_ps(mag, rbin), v_r0 = _mm_sub_ps(mag, v_r1);
+            __m128 v_rc11 = _mm_mul_ps(v_r1, cbin), v_rc10 = _mm_sub_ps(v_r1, v_rc11);
+            __m128 v_rc01 = _mm_mul_ps(v_r0, cbin), v_rc00 = _mm_sub_ps(v_r0, v_rc01);
+            __m128 v_rco111 = _mm_mul_ps(v_rc11, obin), v_rco110 = _mm_sub_ps(v_rc11, v_rco111);
+            __m128 v_rco101 = _mm_mul_ps(v_rc10, obin), v_rco100 = _mm_sub_ps(v_rc10, v_rco101);
+            __m128 v_rco011 = _mm_mul_ps(v_rc01, obin), v_rco010 = _mm_sub_ps(v_rc01, v_rco011);
+            __m128 v_rco001 = _mm_mul_ps(v_rc00, obin), v_rco000 = _mm_sub_ps(v_rc00, v_rco001);
+
+            _mm_store_ps(rco_buf, v_rco000);
+            _mm_store_ps(rco_buf + 4, v_rco001);
+            _mm_store_ps(rco_buf + 8, v_rco010);
+            _mm_store_ps(rco_buf + 12, v_rco011);
+            _mm_store_ps(rco_buf + 16, v_rco100);
+            _mm_store_ps(rco_buf + 20, v_rco101);
+            _mm_store_ps(rco_buf + 24, v_rco110);
+            _mm_store_ps(rco_buf + 28, v_rco111);
+
+            for( int m = 0; m < 4; m++ )
+            {
+                int hidx = idx_buf[m];
+                hist[hidx] += rco_buf[m];
+                hist[hidx+1] += rco_buf[4+m];
+                hist[hidx+(n+2)] += rco_buf[8+m];
+                hist[hidx+(n+3)] += rco_buf[12+m];
+                hist[hidx+(d+2)*(n+2)] += rco_buf[16+m];
+                hist[hidx+(d+2)*(n+2)+1] += rco_buf[20+m];
+                hist[hidx+(d+3)*(n+2)] += rco_buf[24+m];
+                hist[hidx+(d+3)*(n+2)+1] += rco_buf[28+m];
+            }
+        }
+    }
+#endif
+
+    for( ; k < len; k++ )
     {
         float rbin = RBin[k], cbin = CBin[k];
         float obin = (Ori[k] - ori)*bins_per_rad;
@@ -615,6 +834,9 @@ static void calcSIFTDescriptor( const Mat& img, Point2f ptf, float ori, float sc
         hist[idx+(d+3)*(n+2)+1] += v_rco111;
     }
 
+    // the non-float descriptors are normalized in the scratch buffer and stored by the final loop
+    float* raw = dstType == CV_32F ? (float*)dst : hist + histlen;
+
     // finalize histogram, since the orientation histograms are circular
     for( i = 0; i < d; i++ )
         for( j = 0; j < d; j++ )
@@ -623,7 +845,7 @@ static void calcSIFTDescriptor( const Mat& img, Point2f ptf, float ori, float sc
             hist[idx] += hist[idx+n];
             hist[idx+1] += hist[idx+n+1];
             for( k = 0; k < n; k++ )
-                dst[(i*d + j)*n + k] = hist[idx+k];
+                raw[(i*d + j)*n + k] = hist[idx+k];
         }
     // copy histogram to the descriptor,
     // apply hysteresis thresholding
@@ -632,65 +854,99 @@ static void calcSIFTDescriptor( const Mat& img, Point2f ptf, float ori, float sc
     float nrm2 = 0;
     len = d*d*n;
     for( k = 0; k < len; k++ )
-        nrm2 += dst[k]*dst[k];
+        nrm2 += raw[k]*raw[k];
     float thr = std::sqrt(nrm2)*SIFT_DESCR_MAG_THR;
     for( i = 0, nrm2 = 0; i < k; i++ )
     {
-        float val = std::min(dst[i], thr);
-        dst[i] = val;
+        float val = std::min(raw[i], thr);
+        raw[i] = val;
         nrm2 += val*val;
     }
     nrm2 = SIFT_INT_DESCR_FCTR/std::max(std::sqrt(nrm2), FLT_EPSILON);
 
 #if 1
-    for( k = 0; k < len; k++ )
+    if( dstType == CV_8U )
+    {
+        for( k = 0; k < len; k++ )
+            dst[k] = saturate_cast<uchar>(raw[k]*nrm2);
+    }
+    else
     {
-        dst[k] = saturate_cast<uchar>(dst[k]*nrm2);
+        for( k = 0; k < len; k++ )
+            raw[k] = saturate_cast<uchar>(raw[k]*nrm2);
     }
 #else
     float nrm1 = 0;
     for( k = 0; k < len; k++ )
     {
-        dst[k] *= nrm2;
-        nrm1 += dst[k];
+        raw[k] *= nrm2;
+        nrm1 += raw[k];
     }
     nrm1 = 1.f/std::max(nrm1, FLT_EPSILON);
     for( k = 0; k < len; k++ )
     {
-        dst[k] = std::sqrt(dst[k] * nrm1);//saturate_cast<uchar>(std::sqrt(dst[k] * nrm1)*SIFT_INT_DESCR_FCTR);
+        raw[k] = std::sqrt(raw[k] * nrm1);//saturate_cast<uchar>(std::sqrt(raw[k] * nrm1)*SIFT_INT_DESCR_FCTR);
     }
 #endif
 }
 
-static void calcDescriptors(const std::vector<Mat>& gpyr, const std::vector<KeyPoint>& keypoints,
-                            Mat& descriptors, int nOctaveLayers, int firstOctave )
+// Multi-threaded computation of the descriptors, one row per keypoint
+struct SIFTDescriptorInvoker : ParallelLoopBody
 {
-    int d = SIFT_DESCR_WIDTH, n = SIFT_DESCR_HIST_BINS;
+    SIFTDescriptorInvoker( const std::vector<Mat>& _gpyr, const std::vector<KeyPoint>& _keypoints,
+                           Mat& _descriptors, int _nOctaveLayers, int _firstOctave )
+    {
+        gpyr = &_gpyr;
+        keypoints = &_keypoints;
+        descriptors = &_descriptors;
+        nOctaveLayers = _nOctaveLayers;
+        firstOctave = _firstOctave;
+    }
 
-    for( size_t i = 0; i < keypoints.size(); i++ )
+    void operator()(const Range& range) const
     {
-        KeyPoint kpt = keypoints[i];
-        int octave, layer;
-        float scale;
-        unpackOctave(kpt, octave, layer, scale);
-        CV_Assert(octave >= firstOctave && layer <= nOctaveLayers+2);
-        float size=kpt.size*scale;
-        Point2f ptf(kpt.pt.x*scale, kpt.pt.y*scale);
-        const Mat& img = gpyr[(octave - firstOctave)*(nOctaveLayers + 3) + layer];
+        int d = SIFT_DESCR_WIDTH, n = SIFT_DESCR_HIST_BINS;
 
-        float angle = 360.f - kpt.angle;
-        if(std::abs(angle - 360.f) < FLT_EPSILON)
-            angle = 0.f;
-        calcSIFTDescriptor(img, ptf, angle, size*0.5f, d, n, descriptors.ptr<float>((int)i));
+        for( int i = range.start; i < range.end; i++ )
+        {
+            KeyPoint kpt = (*keypoints)[i];
+            int octave, layer;
+            float scale;
+            unpackOctave(kpt, octave, layer, scale);
+            CV_Assert(octave >= firstOctave && layer <= nOctaveLayers+2);
+            float size=kpt.size*scale;
+            Point2f ptf(kpt.pt.x*scale, kpt.pt.y*scale);
+            const Mat& img = (*gpyr)[(octave - firstOctave)*(nOctaveLayers + 3) + layer];
+
+            float angle = 360.f - kpt.angle;
+            if(std::abs(angle - 360.f) < FLT_EPSILON)
+                angle = 0.f;
+            calcSIFTDescriptor(img, ptf, angle, size*0.5f, d, n, descriptors->ptr(i), descriptors->type());
+        }
     }
+
+    const std::vector<Mat>* gpyr;
+    const std::vector<KeyPoint>* keypoints;
+    Mat* descriptors;
+    int nOctaveLayers;
+    int firstOctave;
+};
+
+static void calcDescriptors(const std::vector<Mat>& gpyr, const std::vector<KeyPoint>& keypoints,
+                            Mat& descriptors, int nOctaveLayers, int firstOctave )
+{
+    parallel_for_( Range(0, (int)keypoints.size()),
+                   SIFTDescriptorInvoker(gpyr, keypoints, descriptors, nOctaveLayers, firstOctave) );
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
 SIFT::SIFT( int _nfeatures, int _nOctaveLayers,
-           double _contrastThreshold, double _edgeThreshold, double _sigma )
+           double _contrastThreshold, double _edgeThreshold, double _sigma, int _descType,
+           int _gridSize )
     : nfeatures(_nfeatures), nOctaveLayers(_nOctaveLayers),
-    contrastThreshold(_contrastThreshold), edgeThreshold(_edgeThreshold), sigma(_sigma)
+    contrastThreshold(_contrastThreshold), edgeThreshold(_edgeThreshold), sigma(_sigma),
+    descType(_descType), gridSize(_gridSize)
 {
 }
 
@@ -701,7 +957,8 @@ int SIFT::descriptorSize() const
 
 int SIFT::descriptorType() const
 {
-    return CV_32F;
+    CV_Assert( descType == CV_32F || descType == CV_8U );
+    return descType;
 }
 
 int SIFT::defaultNorm() const
@@ -723,13 +980,6 @@ void SIFT::operator()(InputArray _image, InputArray _mask,
                       bool useProvidedKeypoints) const
 {
     int firstOctave = -1, actualNOctaves = 0, actualNLayers = 0;
-    Mat image = _image.getMat(), mask = _mask.getMat();
-
-    if( image.empty() || image.depth() != CV_8U )
-        CV_Error( Error::StsBadArg, "image is empty or has incorrect depth (!=CV_8U)" );
-
-    if( !mask.empty() && mask.type() != CV_8UC1 )
-        CV_Error( Error::StsBadArg, "mask has incorrect type (!=CV_8UC1)" );
 
     if( useProvidedKeypoints )
     {
@@ -750,25 +1000,80 @@ void SIFT::operator()(InputArray _image, InputArray _mask,
         actualNOctaves = maxOctave - firstOctave + 1;
     }
 
+    Pyramid pyr;
+    buildPyramid(_image, pyr, firstOctave, actualNOctaves, !useProvidedKeypoints);
+
+    (*this)(pyr, _mask, keypoints, _descriptors, useProvidedKeypoints);
+}
+
+void SIFT::buildPyramid(InputArray _image, Pyramid& pyr, int firstOctave, int nOctaves, bool withDoG) const
+{
+    Mat image = _image.getMat();
+
+    if( image.empty() || image.depth() != CV_8U )
+        CV_Error( Error::StsBadArg, "image is empty or has incorrect depth (!=CV_8U)" );
+
+    CV_Assert( firstOctave == -1 || firstOctave == 0 );
+
     Mat base = createInitialImage(image, firstOctave < 0, (float)sigma);
-    std::vector<Mat> gpyr, dogpyr;
-    int nOctaves = actualNOctaves > 0 ? actualNOctaves : cvRound(std::log( (double)std::min( base.cols, base.rows ) ) / std::log(2.) - 2) - firstOctave;
+    if( nOctaves <= 0 )
+        nOctaves = cvRound(std::log( (double)std::min( base.cols, base.rows ) ) / std::log(2.) - 2) - firstOctave;
+    // images too small for a single octave get an empty pyramid, which yields no features
+    nOctaves = std::max(nOctaves, 0);
 
     //double t, tf = getTickFrequency();
     //t = (double)getTickCount();
-    buildGaussianPyramid(base, gpyr, nOctaves);
-    buildDoGPyramid(gpyr, dogpyr);
+    buildGaussianPyramid(base, pyr.gaussian, nOctaves);
+    if( withDoG )
+        buildDoGPyramid(pyr.gaussian, pyr.dog);
+    else
+        pyr.dog.clear();
 
     //t = (double)getTickCount() - t;
     //printf("pyramid construction time: %g\n", t*1000./tf);
 
+    pyr.firstOctave = firstOctave;
+    pyr.nOctaveLayers = nOctaveLayers;
+    pyr.sigma = sigma;
+}
+
+void SIFT::operator()(const Pyramid& pyr, InputArray _mask,
+                      std::vector<KeyPoint>& keypoints,
+                      OutputArray _descriptors,
+                      bool useProvidedKeypoints) const
+{
+    Mat mask = _mask.getMat();
+
+    if( !mask.empty() && mask.type() != CV_8UC1 )
+        CV_Error( Error::StsBadArg, "mask has incorrect type (!=CV_8UC1)" );
+
+    if( pyr.nOctaveLayers != nOctaveLayers || pyr.sigma != sigma )
+        CV_Error( Error::StsBadArg, "the pyramid was not built or was built with different parameters" );
+
+    if( pyr.gaussian.empty() )
+    {
+        // the image was too small for a single octave
+        keypoints.clear();
+        if( _descriptors.needed() )
+            _descriptors.release();
+        return;
+    }
+
+    int firstOctave = pyr.firstOctave;
+    int nOctaves = (int)pyr.gaussian.size()/(nOctaveLayers + 3);
+
     if( !useProvidedKeypoints )
     {
+        if( pyr.dog.empty() )
+            CV_Error( Error::StsBadArg, "the pyramid has been built without DoG layers needed for detection" );
+
         //t = (double)getTickCount();
-        findScaleSpaceExtrema(gpyr, dogpyr, keypoints);
+        findScaleSpaceExtrema(pyr.gaussian, pyr.dog, keypoints);
         KeyPointsFilter::removeDuplicated( keypoints );
 
-        if( nfeatures > 0 )
+        if( nfeatures > 0 && gridSize > 1 )
+            retainBestInGrid(keypoints, pyr.gaussian[0].size(), nfeatures, gridSize);
+        else if( nfeatures > 0 )
             KeyPointsFilter::retainBest(keypoints, nfeatures);
         //t = (double)getTickCount() - t;
         //printf("keypoint detection time: %g\n", t*1000./tf);
@@ -788,6 +1093,15 @@ void SIFT::operator()(InputArray _image, InputArray _mask,
     }
     else
     {
+        for( size_t i = 0; i < keypoints.size(); i++ )
+        {
+            int octave, layer;
+            float scale;
+            unpackOctave(keypoints[i], octave, layer, scale);
+            if( octave < firstOctave || octave - firstOctave >= nOctaves || layer > nOctaveLayers + 2 )
+                CV_Error( Error::StsBadArg, "the keypoint scale is not covered by the pyramid" );
+        }
+
         // filter keypoints by mask
         //KeyPointsFilter::runByPixelsMask( keypoints, mask );
     }
@@ -796,15 +1110,253 @@ void SIFT::operator()(InputArray _image, InputArray _mask,
     {
         //t = (double)getTickCount();
         int dsize = descriptorSize();
-        _descriptors.create((int)keypoints.size(), dsize, CV_32F);
+        _descriptors.create((int)keypoints.size(), dsize, descriptorType());
         Mat descriptors = _descriptors.getMat();
 
-        calcDescriptors(gpyr, keypoints, descriptors, nOctaveLayers, firstOctave);
+        calcDescriptors(pyr.gaussian, keypoints, descriptors, nOctaveLayers, firstOctave);
         //t = (double)getTickCount() - t;
         //printf("descriptor extraction time: %g\n", t*1000./tf);
     }
 }
 
+// Detection (and description) in the tiles of a large image, one tile per task
+struct SIFTTileInvoker : ParallelLoopBody
+{
+    SIFTTileInvoker( const SIFT& _sift, const Mat& _image, const Mat& _mask,
+                     const std::vector<Rect>& _cores, int _margin, bool _withDescriptors,
+                     std::vector<std::vector<KeyPoint> >& _tileKeypoints, std::vector<Mat>& _tileDescriptors )
+    {
+        sift = &_sift;
+        image = &_image;
+        mask = &_mask;
+        cores = &_cores;
+        margin = _margin;
+        withDescriptors = _withDescriptors;
+        tileKeypoints = &_tileKeypoints;
+        tileDescriptors = &_tileDescriptors;
+    }
+
+    void operator()(const Range& range) const
+    {
+        for( int t = range.start; t < range.end; t++ )
+        {
+            const Rect& core = (*cores)[t];
+            Rect roi(core.x - margin, core.y - margin, core.width + margin*2, core.height + margin*2);
+            roi &= Rect(0, 0, image->cols, image->rows);
+
+            // the tile's octave count follows from the size of roi, as documented in the header
+            std::vector<KeyPoint> keypoints;
+            Mat descriptors;
+            (*sift)((*image)(roi), mask->empty() ? Mat() : (*mask)(roi), keypoints,
+                    withDescriptors ? _OutputArray(descriptors) : noArray());
+
+            // keep the keypoints of the tile's own part of the image only
+            std::vector<KeyPoint>& kpts = (*tileKeypoints)[t];
+            Mat& descs = (*tileDescriptors)[t];
+            kpts.clear();
+            for( size_t i = 0; i < keypoints.size(); i++ )
+            {
+                KeyPoint kpt = keypoints[i];
+                kpt.pt.x += roi.x;
+                kpt.pt.y += roi.y;
+                if( !core.contains(Point(cvFloor(kpt.pt.x), cvFloor(kpt.pt.y))) )
+                    continue;
+                if( withDescriptors )
+                    descs.push_back(descriptors.row((int)i));
+                kpts.push_back(kpt);
+            }
+        }
+    }
+
+    const SIFT* sift;
+    const Mat* image;
+    const Mat* mask;
+    const std::vector<Rect>* cores;
+    int margin;
+    bool withDescriptors;
+    std::vector<std::vector<KeyPoint> >* tileKeypoints;
+    std::vector<Mat>* tileDescriptors;
+};
+
+// Splits the image into tiles of the given size, the last row and column may be smaller
+static void makeTiles( Size imageSize, Size tileSize, std::vector<Rect>& cores )
+{
+    cores.clear();
+    for( int y = 0; y < imageSize.height; y += tileSize.height )
+        for( int x = 0; x < imageSize.width; x += tileSize.width )
+            cores.push_back(Rect(x, y, std::min(tileSize.width, imageSize.width - x),
+                                 std::min(tileSize.height, imageSize.height - y)));
+}
+
+// Merges the features of the tiles and applies the nfeatures budget to the result
+static void mergeTileFeatures( const std::vector<std::vector<KeyPoint> >& tileKeypoints,
+                               const std::vector<Mat>& tileDescriptors, Size imageSize,
+                               int nfeatures, int gridSize, int dcols, int dtype,
+                               std::vector<KeyPoint>& keypoints, OutputArray _descriptors )
+{
+    bool withDescriptors = _descriptors.needed();
+    int ntiles = (int)tileKeypoints.size();
+
+    keypoints.clear();
+    for( int t = 0; t < ntiles; t++ )
+        keypoints.insert(keypoints.end(), tileKeypoints[t].begin(), tileKeypoints[t].end());
+
+    if( nfeatures > 0 && (int)keypoints.size() > nfeatures )
+    {
+        // keep the descriptor rows in sync with the retained keypoints
+        if( withDescriptors )
+            for( size_t i = 0; i < keypoints.size(); i++ )
+                keypoints[i].class_id = (int)i;
+
+        if( gridSize > 1 )
+            retainBestInGrid(keypoints, imageSize, nfeatures, gridSize);
+        else
+            KeyPointsFilter::retainBest(keypoints, nfeatures);
+    }
+
+    if( withDescriptors )
+    {
+        Mat all;
+        for( int t = 0; t < ntiles; t++ )
+            if( !tileDescriptors[t].empty() )
+                all.push_back(tileDescriptors[t]);
+
+        _descriptors.create((int)keypoints.size(), dcols, dtype);
+        Mat descriptors = _descriptors.getMat();
+        bool retained = nfeatures > 0 && all.rows > (int)keypoints.size();
+        for( size_t i = 0; i < keypoints.size(); i++ )
+        {
+            int row = retained ? keypoints[i].class_id : (int)i;
+            all.row(row).copyTo(descriptors.row((int)i));
+            if( retained )
+                keypoints[i].class_id = -1;
+        }
+    }
+}
+
+void SIFT::detectAndComputeTiled(InputArray _image, InputArray _mask,
+                                 std::vector<KeyPoint>& keypoints,
+                                 OutputArray _descriptors,
+                                 Size tileSize, int tileMargin) const
+{
+    Mat image = _image.getMat(), mask = _mask.getMat();
+
+    if( image.empty() || image.depth() != CV_8U )
+        CV_Error( Error::StsBadArg, "image is empty or has incorrect depth (!=CV_8U)" );
+
+    if( !mask.empty() && (mask.type() != CV_8UC1 || mask.size() != image.size()) )
+        CV_Error( Error::StsBadArg, "mask has incorrect type (!=CV_8UC1) or size" );
+
+    CV_Assert( tileSize.width > 0 && tileSize.height > 0 && tileMargin >= 0 );
+
+    std::vector<Rect> cores;
+    makeTiles(image.size(), tileSize, cores);
+
+    // the tiles themselves detect all the features, the budget is applied to the merged result
+    SIFT tileSift(0, nOctaveLayers, contrastThreshold, edgeThreshold, sigma, descType);
+    bool withDescriptors = _descriptors.needed();
+    int ntiles = (int)cores.size();
+    std::vector<std::vector<KeyPoint> > tileKeypoints(ntiles);
+    std::vector<Mat> tileDescriptors(ntiles);
+
+    // process the tiles in groups to bound the number of pyramids in memory
+    int group = std::max(getNumThreads(), 1);
+    for( int t = 0; t < ntiles; t += group )
+        parallel_for_( Range(t, std::min(t + group, ntiles)),
+                       SIFTTileInvoker(tileSift, image, mask, cores, tileMargin, withDescriptors,
+                                       tileKeypoints, tileDescriptors) );
+
+    mergeTileFeatures(tileKeypoints, tileDescriptors, image.size(), nfeatures, gridSize,
+                      descriptorSize(), descriptorType(), keypoints, _descriptors);
+}
+
+// The pixels of frame differing from the reference by more than threshold,
+// without the spots smaller than filterSize x filterSize
+void findChanges( const Mat& frame, const Mat& reference, int threshold, int filterSize, Mat& changes )
+{
+    absdiff(frame, reference, changes);
+    cv::threshold(changes, changes, std::max(threshold, 0), 255, THRESH_BINARY);
+    if( filterSize > 1 )
+        morphologyEx(changes, changes, MORPH_OPEN, getStructuringElement(MORPH_RECT, Size(filterSize, filterSize)));
+}
+
+void SIFT::detectAndComputeNext(InputArray _image, InputArray _changeMask, FrameCache& cache,
+                                std::vector<KeyPoint>& keypoints, OutputArray _descriptors) const
+{
+    Mat image = _image.getMat(), changeMask = _changeMask.getMat();
+
+    if( image.empty() || image.depth() != CV_8U )
+        CV_Error( Error::StsBadArg, "image is empty or has incorrect depth (!=CV_8U)" );
+
+    if( !changeMask.empty() && (changeMask.type() != CV_8UC1 || changeMask.size() != image.size()) )
+        CV_Error( Error::StsBadArg, "changeMask has incorrect type (!=CV_8UC1) or size" );
+
+    CV_Assert( cache.tileSize.width > 0 && cache.tileSize.height > 0 && cache.tileMargin >= 0 );
+
+    Mat gray = image;
+    if( image.channels() > 1 )
+        cvtColor(image, gray, COLOR_BGR2GRAY);
+
+    std::vector<Rect> cores;
+    makeTiles(gray.size(), cache.tileSize, cores);
+    int ntiles = (int)cores.size();
+
+    bool reset = cache.frame.size() != gray.size() || cache.tiles != cores ||
+                 (int)cache.tileKeypoints.size() != ntiles || (int)cache.tileDescriptors.size() != ntiles;
+    bool foundChanges = !reset && changeMask.empty();
+    if( foundChanges )
+        findChanges(gray, cache.frame, cache.changeThreshold, cache.changeFilterSize, changeMask);
+
+    // a tile only depends on the pixels of its own part of the image extended by the margin
+    int margin = cache.tileMargin;
+    std::vector<Rect> dirtyCores;
+    std::vector<int> dirtyIdx;
+    for( int t = 0; t < ntiles; t++ )
+    {
+        const Rect& core = cores[t];
+        Rect roi(core.x - margin, core.y - margin, core.width + margin*2, core.height + margin*2);
+        roi &= Rect(0, 0, gray.cols, gray.rows);
+        if( reset || countNonZero(changeMask(roi)) > 0 )
+        {
+            dirtyCores.push_back(core);
+            dirtyIdx.push_back(t);
+        }
+    }
+
+    if( reset )
+    {
+        cache.tiles = cores;
+        cache.tileKeypoints.assign(ntiles, std::vector<KeyPoint>());
+        cache.tileDescriptors.assign(ntiles, Mat());
+    }
+
+    SIFT tileSift(0, nOctaveLayers, contrastThreshold, edgeThreshold, sigma, descType);
+    int ndirty = (int)dirtyCores.size();
+    std::vector<std::vector<KeyPoint> > tileKeypoints(ndirty);
+    std::vector<Mat> tileDescriptors(ndirty);
+    Mat nomask;
+
+    int group = std::max(getNumThreads(), 1);
+    for( int t = 0; t < ndirty; t += group )
+        parallel_for_( Range(t, std::min(t + group, ndirty)),
+                       SIFTTileInvoker(tileSift, gray, nomask, dirtyCores, margin, true,
+                                       tileKeypoints, tileDescriptors) );
+
+    for( int t = 0; t < ndirty; t++ )
+    {
+        cache.tileKeypoints[dirtyIdx[t]].swap(tileKeypoints[t]);
+        cache.tileDescriptors[dirtyIdx[t]] = tileDescriptors[t];
+    }
+    // the reference keeps the unchanged pixels, so the changes below the threshold add up
+    if( foundChanges )
+        gray.copyTo(cache.frame, changeMask);
+    else
+        gray.copyTo(cache.frame);
+
+    mergeTileFeatures(cache.tileKeypoints, cache.tileDescriptors, gray.size(), nfeatures, gridSize,
+                      descriptorSize(), descriptorType(), keypoints, _descriptors);
+}
+
 void SIFT::detectImpl( InputArray image, std::vector<KeyPoint>& keypoints, InputArray mask) const
 {
     (*this)(image.getMat(), mask.getMat(), keypoints, noArray());
@@ -101,32 +101,222 @@ computeIntegralImages( const Mat& matI, Mat& matS, Mat& matT, Mat& _FT,
     }
 }
 
+static const int STAR_MAX_PATTERN = 17;
+static const int starSizes0[] = {1, 2, 3, 4, 6, 8, 11, 12, 16, 22, 23, 32, 45, 46, 64, 90, 128, -1};
+static const int starPairs[][2] = {{1, 0}, {3, 1}, {4, 2}, {5, 3}, {7, 4}, {8, 5}, {9, 6},
+                                   {11, 8}, {13, 10}, {14, 11}, {15, 12}, {16, 14}, {-1, -1}};
+
+template <typename iiMatType> struct StarFeature
+{
+    int area;
+    iiMatType* p[8];
+};
+
+// Computes the bi-level filter responses of a range of image rows
+template <typename iiMatType> struct StarDetectorResponseInvoker : ParallelLoopBody
+{
+    StarDetectorResponseInvoker( const StarFeature<iiMatType>* _f, float (*_invSizes)[2], const int* _sizes1,
+                                 int _npatterns, int _maxIdx, int _border, int _step, bool _useSIMD,
+                                 Mat& _responses, Mat& _sizes )
+    {
+        f = _f;
+        invSizes = _invSizes;
+        sizes1 = _sizes1;
+        npatterns = _npatterns;
+        maxIdx = _maxIdx;
+        border = _border;
+        step = _step;
+        useSIMD = _useSIMD;
+#if CV_AVX2
+        useAVX2 = cv::checkHardwareSupport(CV_CPU_AVX2);
+#endif
+        responses = &_responses;
+        sizes = &_sizes;
+    }
+
+    void operator()(const Range& range) const
+    {
+        int cols = responses->cols;
+
+#if CV_SSE2
+        __m128 invSizes4[STAR_MAX_PATTERN][2];
+        __m128 sizes1_4[STAR_MAX_PATTERN];
+        union { int i; float f; } absmask;
+        absmask.i = 0x7fffffff;
+        if( useSIMD )
+        {
+            for(int i = 0; i < npatterns; i++ )
+            {
+                _mm_store_ps((float*)&invSizes4[i][0], _mm_set1_ps(invSizes[i][0]));
+                _mm_store_ps((float*)&invSizes4[i][1], _mm_set1_ps(invSizes[i][1]));
+            }
+
+            for(int i = 0; i <= maxIdx; i++ )
+                _mm_store_ps((float*)&sizes1_4[i], _mm_set1_ps((float)sizes1[i]));
+        }
+#endif
+
+        for( int y = range.start; y < range.end; y++ )
+        {
+            int x = border;
+            float* r_ptr = responses->ptr<float>(y);
+            short* s_ptr = sizes->ptr<short>(y);
+
+            memset( r_ptr, 0, border*sizeof(r_ptr[0]));
+            memset( s_ptr, 0, border*sizeof(s_ptr[0]));
+            memset( r_ptr + cols - border, 0, border*sizeof(r_ptr[0]));
+            memset( s_ptr + cols - border, 0, border*sizeof(s_ptr[0]));
+
+#if CV_AVX2
+            if( useSIMD && useAVX2 )
+            {
+                __m256 absmask8 = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+                for( ; x <= cols - border - 8; x += 8 )
+                {
+                    int ofs = y*step + x;
+                    __m256 vals[STAR_MAX_PATTERN];
+                    __m256 bestResponse = _mm256_setzero_ps();
+                    __m256 bestSize = _mm256_setzero_ps();
+
+                    for(int i = 0; i <= maxIdx; i++ )
+                    {
+                        const iiMatType** p = (const iiMatType**)&f[i].p[0];
+                        __m256i r0 = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(p[0]+ofs)),
+                                                      _mm256_loadu_si256((const __m256i*)(p[1]+ofs)));
+                        __m256i r1 = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(p[3]+ofs)),
+                                                      _mm256_loadu_si256((const __m256i*)(p[2]+ofs)));
+                        __m256i r2 = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(p[4]+ofs)),
+                                                      _mm256_loadu_si256((const __m256i*)(p[5]+ofs)));
+                        __m256i r3 = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(p[7]+ofs)),
+                                                      _mm256_loadu_si256((const __m256i*)(p[6]+ofs)));
+                        r0 = _mm256_add_epi32(_mm256_add_epi32(r0,r1), _mm256_add_epi32(r2,r3));
+                        vals[i] = _mm256_cvtepi32_ps(r0);
+                    }
+
+                    for(int i = 0; i < npatterns; i++ )
+                    {
+                        __m256 inner_sum = vals[starPairs[i][1]];
+                        __m256 outer_sum = _mm256_sub_ps(vals[starPairs[i][0]], inner_sum);
+                        __m256 response = _mm256_sub_ps(_mm256_mul_ps(inner_sum, _mm256_set1_ps(invSizes[i][1])),
+                            _mm256_mul_ps(outer_sum, _mm256_set1_ps(invSizes[i][0])));
+                        __m256 swapmask = _mm256_cmp_ps(_mm256_and_ps(response,absmask8),
+                            _mm256_and_ps(bestResponse,absmask8), _CMP_GT_OQ);
+                        bestResponse = _mm256_blendv_ps(bestResponse, response, swapmask);
+                        bestSize = _mm256_blendv_ps(bestSize, _mm256_set1_ps((float)sizes1[starPairs[i][0]]), swapmask);
+                    }
+
+                    _mm256_storeu_ps(r_ptr + x, bestResponse);
+                    __m256i bestSize8 = _mm256_cvtps_epi32(bestSize);
+                    _mm_storeu_si128((__m128i*)(s_ptr + x),
+                        _mm_packs_epi32(_mm256_castsi256_si128(bestSize8), _mm256_extracti128_si256(bestSize8, 1)));
+                }
+            }
+#endif
+#if CV_SSE2
+            if( useSIMD )
+            {
+                __m128 absmask4 = _mm_set1_ps(absmask.f);
+                for( ; x <= cols - border - 4; x += 4 )
+                {
+                    int ofs = y*step + x;
+                    __m128 vals[STAR_MAX_PATTERN];
+                    __m128 bestResponse = _mm_setzero_ps();
+                    __m128 bestSize = _mm_setzero_ps();
+
+                    for(int i = 0; i <= maxIdx; i++ )
+                    {
+                        const iiMatType** p = (const iiMatType**)&f[i].p[0];
+                        __m128i r0 = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(p[0]+ofs)),
+                                                   _mm_loadu_si128((const __m128i*)(p[1]+ofs)));
+                        __m128i r1 = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(p[3]+ofs)),
+                                                   _mm_loadu_si128((const __m128i*)(p[2]+ofs)));
+                        __m128i r2 = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(p[4]+ofs)),
+                                                   _mm_loadu_si128((const __m128i*)(p[5]+ofs)));
+                        __m128i r3 = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(p[7]+ofs)),
+                                                   _mm_loadu_si128((const __m128i*)(p[6]+ofs)));
+                        r0 = _mm_add_epi32(_mm_add_epi32(r0,r1), _mm_add_epi32(r2,r3));
+                        _mm_store_ps((float*)&vals[i], _mm_cvtepi32_ps(r0));
+                    }
+
+                    for(int i = 0; i < npatterns; i++ )
+                    {
+                        __m128 inner_sum = vals[starPairs[i][1]];
+                        __m128 outer_sum = _mm_sub_ps(vals[starPairs[i][0]], inner_sum);
+                        __m128 response = _mm_sub_ps(_mm_mul_ps(inner_sum, invSizes4[i][1]),
+                            _mm_mul_ps(outer_sum, invSizes4[i][0]));
+                        __m128 swapmask = _mm_cmpgt_ps(_mm_and_ps(response,absmask4),
+                            _mm_and_ps(bestResponse,absmask4));
+                        bestResponse = _mm_xor_ps(bestResponse,
+                            _mm_and_ps(_mm_xor_ps(response,bestResponse), swapmask));
+                        bestSize = _mm_xor_ps(bestSize,
+                            _mm_and_ps(_mm_xor_ps(sizes1_4[starPairs[i][0]], bestSize), swapmask));
+                    }
+
+                    _mm_storeu_ps(r_ptr + x, bestResponse);
+                    _mm_storel_epi64((__m128i*)(s_ptr + x),
+                        _mm_packs_epi32(_mm_cvtps_epi32(bestSize),_mm_setzero_si128()));
+                }
+            }
+#endif
+            for( ; x < cols - border; x++ )
+            {
+                int ofs = y*step + x;
+                int vals[STAR_MAX_PATTERN];
+                float bestResponse = 0;
+                int bestSize = 0;
+
+                for(int i = 0; i <= maxIdx; i++ )
+                {
+                    const iiMatType** p = (const iiMatType**)&f[i].p[0];
+                    vals[i] = (int)(p[0][ofs] - p[1][ofs] - p[2][ofs] + p[3][ofs] +
+                        p[4][ofs] - p[5][ofs] - p[6][ofs] + p[7][ofs]);
+                }
+                for(int i = 0; i < npatterns; i++ )
+                {
+                    int inner_sum = vals[starPairs[i][1]];
+                    int outer_sum = vals[starPairs[i][0]] - inner_sum;
+                    float response = inner_sum*invSizes[i][1] - outer_sum*invSizes[i][0];
+                    if( fabs(response) > fabs(bestResponse) )
+                    {
+                        bestResponse = response;
+                        bestSize = sizes1[starPairs[i][0]];
+                    }
+                }
+
+                r_ptr[x] = bestResponse;
+                s_ptr[x] = (short)bestSize;
+            }
+        }
+    }
+
+    const StarFeature<iiMatType>* f;
+    float (*invSizes)[2];
+    const int* sizes1;
+    int npatterns;
+    int maxIdx;
+    int border;
+    int step;
+    bool useSIMD;
+#if CV_AVX2
+    bool useAVX2;
+#endif
+    Mat* responses;
+    Mat* sizes;
+};
+
 template <typename iiMatType> static int
 StarDetectorComputeResponses( const Mat& img, Mat& responses, Mat& sizes,
                               int maxSize, int iiType )
 {
-    const int MAX_PATTERN = 17;
-    static const int sizes0[] = {1, 2, 3, 4, 6, 8, 11, 12, 16, 22, 23, 32, 45, 46, 64, 90, 128, -1};
-    static const int pairs[][2] = {{1, 0}, {3, 1}, {4, 2}, {5, 3}, {7, 4}, {8, 5}, {9, 6},
-                                   {11, 8}, {13, 10}, {14, 11}, {15, 12}, {16, 14}, {-1, -1}};
-    float invSizes[MAX_PATTERN][2];
-    int sizes1[MAX_PATTERN];
+    float invSizes[STAR_MAX_PATTERN][2];
+    int sizes1[STAR_MAX_PATTERN];
 
+    bool useSIMD = false;
 #if CV_SSE2
-    __m128 invSizes4[MAX_PATTERN][2];
-    __m128 sizes1_4[MAX_PATTERN];
-    union { int i; float f; } absmask;
-    absmask.i = 0x7fffffff;
-    volatile bool useSIMD = cv::checkHardwareSupport(CV_CPU_SSE2) && iiType == CV_32S;
+    useSIMD = cv::checkHardwareSupport(CV_CPU_SSE2) && iiType == CV_32S;
 #endif
 
-    struct StarFeature
-    {
-        int area;
-        iiMatType* p[8];
-    };
-
-    StarFeature f[MAX_PATTERN];
+    StarFeature<iiMatType> f[STAR_MAX_PATTERN];
 
     Mat sum, tilted, flatTilted;
     int y, rows = img.rows, cols = img.cols;
@@ -135,15 +325,15 @@ StarDetectorComputeResponses( const Mat& img, Mat& responses, Mat& sizes,
     responses.create( img.size(), CV_32F );
     sizes.create( img.size(), CV_16S );
 
-    while( pairs[npatterns][0] >= 0 && !
-          ( sizes0[pairs[npatterns][0]] >= maxSize
-           || sizes0[pairs[npatterns+1][0]] + sizes0[pairs[npatterns+1][0]]/2 >= std::min(rows, cols) ) )
+    while( starPairs[npatterns][0] >= 0 && !
+          ( starSizes0[starPairs[npatterns][0]] >= maxSize
+           || starSizes0[starPairs[npatterns+1][0]] + starSizes0[starPairs[npatterns+1][0]]/2 >= std::min(rows, cols) ) )
     {
         ++npatterns;
     }
 
-    npatterns += (pairs[npatterns-1][0] >= 0);
-    maxIdx = pairs[npatterns-1][0];
+    npatterns += (starPairs[npatterns-1][0] >= 0);
+    maxIdx = starPairs[npatterns-1][0];
 
     // Create the integral image appropriate for our type & usage
     if ( img.type() == CV_8U )
@@ -161,7 +351,7 @@ StarDetectorComputeResponses( const Mat& img, Mat& responses, Mat& sizes,
 
     for(int i = 0; i <= maxIdx; i++ )
     {
-        int ur_size = sizes0[i], t_size = sizes0[i] + sizes0[i]/2;
+        int ur_size = starSizes0[i], t_size = starSizes0[i] + starSizes0[i]/2;
         int ur_area = (2*ur_size + 1)*(2*ur_size + 1);
         int t_area = t_size*t_size + (t_size + 1)*(t_size + 1);
 
@@ -176,37 +366,23 @@ StarDetectorComputeResponses( const Mat& img, Mat& responses, Mat& sizes,
         f[i].p[7] = tilted.ptr<iiMatType>() - t_size*step + 1;
 
         f[i].area = ur_area + t_area;
-        sizes1[i] = sizes0[i];
+        sizes1[i] = starSizes0[i];
     }
     // negate end points of the size range
     // for a faster rejection of very small or very large features in non-maxima suppression.
     sizes1[0] = -sizes1[0];
     sizes1[1] = -sizes1[1];
     sizes1[maxIdx] = -sizes1[maxIdx];
-    border = sizes0[maxIdx] + sizes0[maxIdx]/2;
+    border = starSizes0[maxIdx] + starSizes0[maxIdx]/2;
 
     for(int i = 0; i < npatterns; i++ )
     {
-        int innerArea = f[pairs[i][1]].area;
-        int outerArea = f[pairs[i][0]].area - innerArea;
+        int innerArea = f[starPairs[i][1]].area;
+        int outerArea = f[starPairs[i][0]].area - innerArea;
         invSizes[i][0] = 1.f/outerArea;
         invSizes[i][1] = 1.f/innerArea;
     }
 
-#if CV_SSE2
-    if( useSIMD )
-    {
-        for(int i = 0; i < npatterns; i++ )
-        {
-            _mm_store_ps((float*)&invSizes4[i][0], _mm_set1_ps(invSizes[i][0]));
-            _mm_store_ps((float*)&invSizes4[i][1], _mm_set1_ps(invSizes[i][1]));
-        }
-
-        for(int i = 0; i <= maxIdx; i++ )
-            _mm_store_ps((float*)&sizes1_4[i], _mm_set1_ps((float)sizes1[i]));
-    }
-#endif
-
     for( y = 0; y < border; y++ )
     {
         float* r_ptr = responses.ptr<float>(y);
@@ -220,91 +396,12 @@ StarDetectorComputeResponses( const Mat& img, Mat& responses, Mat& sizes,
         memset( s_ptr2, 0, cols*sizeof(s_ptr2[0]));
     }
 
-    for( y = border; y < rows - border; y++ )
+    if( border < rows - border )
     {
-        int x = border;
-        float* r_ptr = responses.ptr<float>(y);
-        short* s_ptr = sizes.ptr<short>(y);
-
-        memset( r_ptr, 0, border*sizeof(r_ptr[0]));
-        memset( s_ptr, 0, border*sizeof(s_ptr[0]));
-        memset( r_ptr + cols - border, 0, border*sizeof(r_ptr[0]));
-        memset( s_ptr + cols - border, 0, border*sizeof(s_ptr[0]));
-
-#if CV_SSE2
-        if( useSIMD )
-        {
-            __m128 absmask4 = _mm_set1_ps(absmask.f);
-            for( ; x <= cols - border - 4; x += 4 )
-            {
-                int ofs = y*step + x;
-                __m128 vals[MAX_PATTERN];
-                __m128 bestResponse = _mm_setzero_ps();
-                __m128 bestSize = _mm_setzero_ps();
-
-                for(int i = 0; i <= maxIdx; i++ )
-                {
-                    const iiMatType** p = (const iiMatType**)&f[i].p[0];
-                    __m128i r0 = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(p[0]+ofs)),
-                                               _mm_loadu_si128((const __m128i*)(p[1]+ofs)));
-                    __m128i r1 = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(p[3]+ofs)),
-                                               _mm_loadu_si128((const __m128i*)(p[2]+ofs)));
-                    __m128i r2 = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(p[4]+ofs)),
-                                               _mm_loadu_si128((const __m128i*)(p[5]+ofs)));
-                    __m128i r3 = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(p[7]+ofs)),
-                                               _mm_loadu_si128((const __m128i*)(p[6]+ofs)));
-                    r0 = _mm_add_epi32(_mm_add_epi32(r0,r1), _mm_add_epi32(r2,r3));
-                    _mm_store_ps((float*)&vals[i], _mm_cvtepi32_ps(r0));
-                }
-
-                for(int i = 0; i < npatterns; i++ )
-                {
-                    __m128 inner_sum = vals[pairs[i][1]];
-                    __m128 outer_sum = _mm_sub_ps(vals[pairs[i][0]], inner_sum);
-                    __m128 response = _mm_sub_ps(_mm_mul_ps(inner_sum, invSizes4[i][1]),
-                        _mm_mul_ps(outer_sum, invSizes4[i][0]));
-                    __m128 swapmask = _mm_cmpgt_ps(_mm_and_ps(response,absmask4),
-                        _mm_and_ps(bestResponse,absmask4));
-                    bestResponse = _mm_xor_ps(bestResponse,
-                        _mm_and_ps(_mm_xor_ps(response,bestResponse), swapmask));
-                    bestSize = _mm_xor_ps(bestSize,
-                        _mm_and_ps(_mm_xor_ps(sizes1_4[pairs[i][0]], bestSize), swapmask));
-                }
-
-                _mm_storeu_ps(r_ptr + x, bestResponse);
-                _mm_storel_epi64((__m128i*)(s_ptr + x),
-                    _mm_packs_epi32(_mm_cvtps_epi32(bestSize),_mm_setzero_si128()));
-            }
-        }
-#endif
-        for( ; x < cols - border; x++ )
-        {
-            int ofs = y*step + x;
-            int vals[MAX_PATTERN];
-            float bestResponse = 0;
-            int bestSize = 0;
-
-            for(int i = 0; i <= maxIdx; i++ )
-            {
-                const iiMatType** p = (const iiMatType**)&f[i].p[0];
-                vals[i] = (int)(p[0][ofs] - p[1][ofs] - p[2][ofs] + p[3][ofs] +
-                    p[4][ofs] - p[5][ofs] - p[6][ofs] + p[7][ofs]);
-            }
-            for(int i = 0; i < npatterns; i++ )
-            {
-                int inner_sum = vals[pairs[i][1]];
-                int outer_sum = vals[pairs[i][0]] - inner_sum;
-                float response = inner_sum*invSizes[i][1] - outer_sum*invSizes[i][0];
-                if( fabs(response) > fabs(bestResponse) )
-                {
-                    bestResponse = response;
-                    bestSize = sizes1[pairs[i][0]];
-                }
-            }
-
-            r_ptr[x] = bestResponse;
-            s_ptr[x] = (short)bestSize;
-        }
+        StarDetectorResponseInvoker<iiMatType> invoker( f, invSizes, sizes1, npatterns, maxIdx,
+                                                        border, step, useSIMD, responses, sizes );
+        parallel_for_( Range(border, rows - border), invoker,
+                       (double)(rows - border*2)*cols/(1 << 16) );
     }
 
     return border;
@@ -349,110 +446,146 @@ static bool StarDetectorSuppressLines( const Mat& responses, const Mat& sizes, P
 }
 
 
-static void
-StarDetectorSuppressNonmax( const Mat& responses, const Mat& sizes,
-                            std::vector<KeyPoint>& keypoints, int border,
-                            int responseThreshold,
-                            int lineThresholdProjected,
-                            int lineThresholdBinarized,
-                            int suppressNonmaxSize )
+// Finds the local extrema of the responses in a range of rows of (suppressNonmaxSize/2 + 1)-pixel blocks
+struct StarDetectorSuppressNonmaxInvoker : ParallelLoopBody
 {
-    int x, y, x1, y1, delta = suppressNonmaxSize/2;
-    int rows = responses.rows, cols = responses.cols;
-    const float* r_ptr = responses.ptr<float>();
-    int rstep = (int)(responses.step/sizeof(r_ptr[0]));
-    const short* s_ptr = sizes.ptr<short>();
-    int sstep = (int)(sizes.step/sizeof(s_ptr[0]));
-    short featureSize = 0;
+    StarDetectorSuppressNonmaxInvoker( const Mat& _responses, const Mat& _sizes,
+                                       std::vector<std::vector<KeyPoint> >& _blockRowKeypoints,
+                                       int _border, int _responseThreshold,
+                                       int _lineThresholdProjected, int _lineThresholdBinarized,
+                                       int _suppressNonmaxSize )
+    {
+        responses = &_responses;
+        sizes = &_sizes;
+        blockRowKeypoints = &_blockRowKeypoints;
+        border = _border;
+        responseThreshold = _responseThreshold;
+        lineThresholdProjected = _lineThresholdProjected;
+        lineThresholdBinarized = _lineThresholdBinarized;
+        suppressNonmaxSize = _suppressNonmaxSize;
+    }
 
-    for( y = border; y < rows - border; y += delta+1 )
-        for( x = border; x < cols - border; x += delta+1 )
+    void operator()(const Range& range) const
+    {
+        int x, y, x1, y1, delta = suppressNonmaxSize/2;
+        int rows = responses->rows, cols = responses->cols;
+        const float* r_ptr = responses->ptr<float>();
+        int rstep = (int)(responses->step/sizeof(r_ptr[0]));
+        const short* s_ptr = sizes->ptr<short>();
+        int sstep = (int)(sizes->step/sizeof(s_ptr[0]));
+        short featureSize = 0;
+
+        for( int by = range.start; by < range.end; by++ )
         {
-            float maxResponse = (float)responseThreshold;
-            float minResponse = (float)-responseThreshold;
-            Point maxPt(-1, -1), minPt(-1, -1);
-            int tileEndY = MIN(y + delta, rows - border - 1);
-            int tileEndX = MIN(x + delta, cols - border - 1);
-
-            for( y1 = y; y1 <= tileEndY; y1++ )
-                for( x1 = x; x1 <= tileEndX; x1++ )
-                {
-                    float val = r_ptr[y1*rstep + x1];
-                    if( maxResponse < val )
-                    {
-                        maxResponse = val;
-                        maxPt = Point(x1, y1);
-                    }
-                    else if( minResponse > val )
-                    {
-                        minResponse = val;
-                        minPt = Point(x1, y1);
-                    }
-                }
+            std::vector<KeyPoint>& keypoints = (*blockRowKeypoints)[by];
+            y = border + by*(delta+1);
 
-            if( maxPt.x >= 0 )
+            for( x = border; x < cols - border; x += delta+1 )
             {
-                for( y1 = maxPt.y - delta; y1 <= maxPt.y + delta; y1++ )
-                    for( x1 = maxPt.x - delta; x1 <= maxPt.x + delta; x1++ )
+                float maxResponse = (float)responseThreshold;
+                float minResponse = (float)-responseThreshold;
+                Point maxPt(-1, -1), minPt(-1, -1);
+                int tileEndY = MIN(y + delta, rows - border - 1);
+                int tileEndX = MIN(x + delta, cols - border - 1);
+
+                for( y1 = y; y1 <= tileEndY; y1++ )
+                    for( x1 = x; x1 <= tileEndX; x1++ )
                     {
                         float val = r_ptr[y1*rstep + x1];
-                        if( val >= maxResponse && (y1 != maxPt.y || x1 != maxPt.x))
-                            goto skip_max;
+                        if( maxResponse < val )
+                        {
+                            maxResponse = val;
+                            maxPt = Point(x1, y1);
+                        }
+                        else if( minResponse > val )
+                        {
+                            minResponse = val;
+                            minPt = Point(x1, y1);
+                        }
                     }
 
-                if( (featureSize = s_ptr[maxPt.y*sstep + maxPt.x]) >= 4 &&
-                    !StarDetectorSuppressLines( responses, sizes, maxPt, lineThresholdProjected,
-                                                lineThresholdBinarized ))
+                if( maxPt.x >= 0 )
                 {
-                    KeyPoint kpt((float)maxPt.x, (float)maxPt.y, featureSize, -1, maxResponse);
-                    keypoints.push_back(kpt);
-                }
-            }
-        skip_max:
-            if( minPt.x >= 0 )
-            {
-                for( y1 = minPt.y - delta; y1 <= minPt.y + delta; y1++ )
-                    for( x1 = minPt.x - delta; x1 <= minPt.x + delta; x1++ )
+                    for( y1 = maxPt.y - delta; y1 <= maxPt.y + delta; y1++ )
+                        for( x1 = maxPt.x - delta; x1 <= maxPt.x + delta; x1++ )
+                        {
+                            float val = r_ptr[y1*rstep + x1];
+                            if( val >= maxResponse && (y1 != maxPt.y || x1 != maxPt.x))
+                                goto skip_max;
+                        }
+
+                    if( (featureSize = s_ptr[maxPt.y*sstep + maxPt.x]) >= 4 &&
+                        !StarDetectorSuppressLines( *responses, *sizes, maxPt, lineThresholdProjected,
+                                                    lineThresholdBinarized ))
                     {
-                        float val = r_ptr[y1*rstep + x1];
-                        if( val <= minResponse && (y1 != minPt.y || x1 != minPt.x))
-                            goto skip_min;
+                        KeyPoint kpt((float)maxPt.x, (float)maxPt.y, featureSize, -1, maxResponse);
+                        keypoints.push_back(kpt);
                     }
-
-                if( (featureSize = s_ptr[minPt.y*sstep + minPt.x]) >= 4 &&
-                    !StarDetectorSuppressLines( responses, sizes, minPt,
-                                               lineThresholdProjected, lineThresholdBinarized))
+                }
+            skip_max:
+                if( minPt.x >= 0 )
                 {
-                    KeyPoint kpt((float)minPt.x, (float)minPt.y, featureSize, -1, maxResponse);
-                    keypoints.push_back(kpt);
+                    for( y1 = minPt.y - delta; y1 <= minPt.y + delta; y1++ )
+                        for( x1 = minPt.x - delta; x1 <= minPt.x + delta; x1++ )
+                        {
+                            float val = r_ptr[y1*rstep + x1];
+                            if( val <= minResponse && (y1 != minPt.y || x1 != minPt.x))
+                                goto skip_min;
+                        }
+
+                    if( (featureSize = s_ptr[minPt.y*sstep + minPt.x]) >= 4 &&
+                        !StarDetectorSuppressLines( *responses, *sizes, minPt,
+                                                   lineThresholdProjected, lineThresholdBinarized))
+                    {
+                        KeyPoint kpt((float)minPt.x, (float)minPt.y, featureSize, -1, maxResponse);
+                        keypoints.push_back(kpt);
+                    }
                 }
+            skip_min:
+                ;
             }
-        skip_min:
-            ;
         }
-}
-
-StarDetector::StarDetector(int _maxSize, int _responseThreshold,
-                           int _lineThresholdProjected,
-                           int _lineThresholdBinarized,
-                           int _suppressNonmaxSize)
-: maxSize(_maxSize), responseThreshold(_responseThreshold),
-    lineThresholdProjected(_lineThresholdProjected),
-    lineThresholdBinarized(_lineThresholdBinarized),
-    suppressNonmaxSize(_suppressNonmaxSize)
-{}
+    }
 
+    const Mat* responses;
+    const Mat* sizes;
+    std::vector<std::vector<KeyPoint> >* blockRowKeypoints;
+    int border;
+    int responseThreshold;
+    int lineThresholdProjected;
+    int lineThresholdBinarized;
+    int suppressNonmaxSize;
+};
 
-void StarDetector::detectImpl( InputArray _image, std::vector<KeyPoint>& keypoints, InputArray _mask ) const
+static void
+StarDetectorSuppressNonmax( const Mat& responses, const Mat& sizes,
+                            std::vector<KeyPoint>& keypoints, int border,
+                            int responseThreshold,
+                            int lineThresholdProjected,
+                            int lineThresholdBinarized,
+                            int suppressNonmaxSize )
 {
-    Mat image = _image.getMat(), mask = _mask.getMat(), grayImage = image;
-    if( image.channels() > 1 ) cvtColor( image, grayImage, COLOR_BGR2GRAY );
-
-    (*this)(grayImage, keypoints);
-    KeyPointsFilter::runByPixelsMask( keypoints, mask );
+    int delta = suppressNonmaxSize/2;
+    int rows = responses.rows;
+    if( border >= rows - border )
+        return;
+
+    // every row of blocks collects its own keypoints, they are merged in the scan order
+    int nblockRows = (rows - border*2 + delta)/(delta + 1);
+    std::vector<std::vector<KeyPoint> > blockRowKeypoints(nblockRows);
+    parallel_for_( Range(0, nblockRows),
+                   StarDetectorSuppressNonmaxInvoker( responses, sizes, blockRowKeypoints, border,
+                                                      responseThreshold, lineThresholdProjected,
+                                                      lineThresholdBinarized, suppressNonmaxSize ) );
+
+    for( int i = 0; i < nblockRows; i++ )
+        keypoints.insert(keypoints.end(), blockRowKeypoints[i].begin(), blockRowKeypoints[i].end());
 }
 
-void StarDetector::operator()(const Mat& img, std::vector<KeyPoint>& keypoints) const
+static void
+StarDetectorDetect( const Mat& img, std::vector<KeyPoint>& keypoints, int maxSize,
+                    int responseThreshold, int lineThresholdProjected,
+                    int lineThresholdBinarized, int suppressNonmaxSize )
 {
     Mat responses, sizes;
     int border;
@@ -471,6 +604,40 @@ void StarDetector::operator()(const Mat& img, std::vector<KeyPoint>& keypoints)
                                     lineThresholdBinarized, suppressNonmaxSize );
 }
 
+StarDetector::StarDetector(int _maxSize, int _responseThreshold,
+                           int _lineThresholdProjected,
+                           int _lineThresholdBinarized,
+                           int _suppressNonmaxSize,
+                           int _nfeatures, int _gridSize)
+: maxSize(_maxSize), responseThreshold(_responseThreshold),
+    lineThresholdProjected(_lineThresholdProjected),
+    lineThresholdBinarized(_lineThresholdBinarized),
+    suppressNonmaxSize(_suppressNonmaxSize),
+    nfeatures(_nfeatures), gridSize(_gridSize)
+{}
+
+
+void StarDetector::detectImpl( InputArray _image, std::vector<KeyPoint>& keypoints, InputArray _mask ) const
+{
+    Mat image = _image.getMat(), mask = _mask.getMat(), grayImage = image;
+    if( image.channels() > 1 ) cvtColor( image, grayImage, COLOR_BGR2GRAY );
+
+    StarDetectorDetect( grayImage, keypoints, maxSize, responseThreshold, lineThresholdProjected,
+                        lineThresholdBinarized, suppressNonmaxSize );
+    KeyPointsFilter::runByPixelsMask( keypoints, mask );
+    if( nfeatures > 0 )
+        retainBestInGrid( keypoints, grayImage.size(), nfeatures, std::max(gridSize, 1) );
+}
+
+void StarDetector::operator()(const Mat& img, std::vector<KeyPoint>& keypoints) const
+{
+    StarDetectorDetect( img, keypoints, maxSize, responseThreshold, lineThresholdProjected,
+                        lineThresholdBinarized, suppressNonmaxSize );
+    if( nfeatures > 0 )
+        retainBestInGrid( keypoints, img.size(), nfeatures, std::max(gridSize, 1) );
+}
+
+
 }
 }
 
@@ -163,12 +163,23 @@ resizeHaarPattern( const int src[][5], SurfHF* dst, int n, int oldSize, int newS
     }
 }
 
+/*
+ * Range of the layer samples whose wavelets are centered around the pixels
+ * [start, end), extended by 'extra' samples on each side
+ */
+static inline Range calcSampleRange( int start, int end, int sampleStep, int extra, int limit )
+{
+    return Range( std::max(start/sampleStep - extra, 0),
+                  std::min((end + sampleStep - 1)/sampleStep + extra, limit) );
+}
+
 /*
  * Calculate the determinant and trace of the Hessian for a layer of the
- * scale-space pyramid
+ * scale-space pyramid. Only the samples needed to search the maxima in
+ * roi are computed.
  */
 static void calcLayerDetAndTrace( const Mat& sum, int size, int sampleStep,
-                                  Mat& det, Mat& trace )
+                                  Mat& det, Mat& trace, const Rect& roi )
 {
     const int NX=3, NY=3, NXY=4;
     const int dx_s[NX][5] = { {0, 2, 3, 7, 1}, {3, 2, 6, 7, -2}, {6, 2, 9, 7, 1} };
@@ -191,12 +202,18 @@ static void calcLayerDetAndTrace( const Mat& sum, int size, int sampleStep,
     /* Ignore pixels where some of the kernel is outside the image */
     int margin = (size/2)/sampleStep;
 
-    for( int i = 0; i < samples_i; i++ )
+    /* The maxima search reads one sample more around its own range */
+    Range rows = calcSampleRange( roi.y, roi.y + roi.height, sampleStep, 3, det.rows );
+    Range cols = calcSampleRange( roi.x, roi.x + roi.width, sampleStep, 3, det.cols );
+    int i0 = std::max(rows.start - margin, 0), i1 = std::min(rows.end - margin, samples_i);
+    int j0 = std::max(cols.start - margin, 0), j1 = std::min(cols.end - margin, samples_j);
+
+    for( int i = i0; i < i1; i++ )
     {
-        const int* sum_ptr = sum.ptr<int>(i*sampleStep);
+        const int* sum_ptr = sum.ptr<int>(i*sampleStep) + j0*sampleStep;
         float* det_ptr = &det.at<float>(i+margin, margin);
         float* trace_ptr = &trace.at<float>(i+margin, margin);
-        for( int j = 0; j < samples_j; j++ )
+        for( int j = j0; j < j1; j++ )
         {
             float dx  = calcHaarPattern( sum_ptr, Dx , 3 );
             float dy  = calcHaarPattern( sum_ptr, Dy , 3 );
@@ -265,9 +282,10 @@ struct SURFBuildInvoker : ParallelLoopBody
 {
     SURFBuildInvoker( const Mat& _sum, const std::vector<int>& _sizes,
                       const std::vector<int>& _sampleSteps,
-                      std::vector<Mat>& _dets, std::vector<Mat>& _traces )
+                      std::vector<Mat>& _dets, std::vector<Mat>& _traces, const Rect& _roi )
     {
         sum = &_sum;
+        roi = _roi;
         sizes = &_sizes;
         sampleSteps = &_sampleSteps;
         dets = &_dets;
@@ -277,10 +295,11 @@ struct SURFBuildInvoker : ParallelLoopBody
     void operator()(const Range& range) const
     {
         for( int i=range.start; i<range.end; i++ )
-            calcLayerDetAndTrace( *sum, (*sizes)[i], (*sampleSteps)[i], (*dets)[i], (*traces)[i] );
+            calcLayerDetAndTrace( *sum, (*sizes)[i], (*sampleSteps)[i], (*dets)[i], (*traces)[i], roi );
     }
 
     const Mat *sum;
+    Rect roi;
     const std::vector<int> *sizes;
     const std::vector<int> *sampleSteps;
     std::vector<Mat>* dets;
@@ -294,9 +313,10 @@ struct SURFFindInvoker : ParallelLoopBody
                      const std::vector<Mat>& _dets, const std::vector<Mat>& _traces,
                      const std::vector<int>& _sizes, const std::vector<int>& _sampleSteps,
                      const std::vector<int>& _middleIndices, std::vector<KeyPoint>& _keypoints,
-                     int _nOctaveLayers, float _hessianThreshold )
+                     int _nOctaveLayers, float _hessianThreshold, const Rect& _roi )
     {
         sum = &_sum;
+        roi = _roi;
         mask_sum = &_mask_sum;
         dets = &_dets;
         traces = &_traces;
@@ -311,7 +331,7 @@ struct SURFFindInvoker : ParallelLoopBody
     static void findMaximaInLayer( const Mat& sum, const Mat& mask_sum,
                    const std::vector<Mat>& dets, const std::vector<Mat>& traces,
                    const std::vector<int>& sizes, std::vector<KeyPoint>& keypoints,
-                   int octave, int layer, float hessianThreshold, int sampleStep );
+                   int octave, int layer, float hessianThreshold, int sampleStep, const Rect& roi );
 
     void operator()(const Range& range) const
     {
@@ -321,7 +341,7 @@ struct SURFFindInvoker : ParallelLoopBody
             int octave = i / nOctaveLayers;
             findMaximaInLayer( *sum, *mask_sum, *dets, *traces, *sizes,
                                *keypoints, octave, layer, hessianThreshold,
-                               (*sampleSteps)[layer] );
+                               (*sampleSteps)[layer], roi );
         }
     }
 
@@ -335,6 +355,7 @@ struct SURFFindInvoker : ParallelLoopBody
     std::vector<KeyPoint>* keypoints;
     int nOctaveLayers;
     float hessianThreshold;
+    Rect roi;
 
     static Mutex findMaximaInLayer_m;
 };
@@ -344,12 +365,13 @@ Mutex SURFFindInvoker::findMaximaInLayer_m;
 
 /*
  * Find the maxima in the determinant of the Hessian in a layer of the
- * scale-space pyramid
+ * scale-space pyramid. Only the samples that can produce a keypoint
+ * located in roi are searched.
  */
 void SURFFindInvoker::findMaximaInLayer( const Mat& sum, const Mat& mask_sum,
                    const std::vector<Mat>& dets, const std::vector<Mat>& traces,
                    const std::vector<int>& sizes, std::vector<KeyPoint>& keypoints,
-                   int octave, int layer, float hessianThreshold, int sampleStep )
+                   int octave, int layer, float hessianThreshold, int sampleStep, const Rect& roi )
 {
     // Wavelet Data
     const int NM=1;
@@ -370,11 +392,15 @@ void SURFFindInvoker::findMaximaInLayer( const Mat& sum, const Mat& mask_sum,
 
     int step = (int)(dets[layer].step/dets[layer].elemSize());
 
-    for( int i = margin; i < layer_rows - margin; i++ )
+    /* The interpolation moves a keypoint by up to one sample */
+    Range rows = calcSampleRange( roi.y, roi.y + roi.height, sampleStep, 2, layer_rows - margin );
+    Range cols = calcSampleRange( roi.x, roi.x + roi.width, sampleStep, 2, layer_cols - margin );
+
+    for( int i = std::max(margin, rows.start); i < rows.end; i++ )
     {
         const float* det_ptr = dets[layer].ptr<float>(i);
         const float* trace_ptr = traces[layer].ptr<float>(i);
-        for( int j = margin; j < layer_cols-margin; j++ )
+        for( int j = std::max(margin, cols.start); j < cols.end; j++ )
         {
             float val0 = det_ptr[j];
             if( val0 > hessianThreshold )
@@ -463,7 +489,7 @@ struct KeypointGreater
 
 
 static void fastHessianDetector( const Mat& sum, const Mat& mask_sum, std::vector<KeyPoint>& keypoints,
-                                 int nOctaves, int nOctaveLayers, float hessianThreshold )
+                                 int nOctaves, int nOctaveLayers, float hessianThreshold, const Rect& roi )
 {
     /* Sampling step along image x and y axes at first octave. This is doubled
        for each additional octave. WARNING: Increasing this improves speed,
@@ -503,13 +529,13 @@ static void fastHessianDetector( const Mat& sum, const Mat& mask_sum, std::vecto
 
     // Calculate hessian determinant and trace samples in each layer
     parallel_for_( Range(0, nTotalLayers),
-                   SURFBuildInvoker(sum, sizes, sampleSteps, dets, traces) );
+                   SURFBuildInvoker(sum, sizes, sampleSteps, dets, traces, roi) );
 
     // Find maxima in the determinant of the hessian
     parallel_for_( Range(0, nMiddleLayers),
                    SURFFindInvoker(sum, mask_sum, dets, traces, sizes,
                                    sampleSteps, middleIndices, keypoints,
-                                   nOctaveLayers, hessianThreshold) );
+                                   nOctaveLayers, hessianThreshold, roi) );
 
     std::sort(keypoints.begin(), keypoints.end(), KeypointGreater());
 }
@@ -521,7 +547,7 @@ struct SURFInvoker : ParallelLoopBody
 
     SURFInvoker( const Mat& _img, const Mat& _sum,
                  std::vector<KeyPoint>& _keypoints, Mat& _descriptors,
-                 bool _extended, bool _upright )
+                 bool _extended, bool _upright, bool _orientation )
     {
         keypoints = &_keypoints;
         descriptors = &_descriptors;
@@ -529,6 +555,12 @@ struct SURFInvoker : ParallelLoopBody
         sum = &_sum;
         extended = _extended;
         upright = _upright;
+        orientation = _orientation;
+
+        useSIMD = false;
+#if CV_SSE2
+        useSIMD = checkHardwareSupport(CV_CPU_SSE2);
+#endif
 
         // Simple bound for number of grid points in circle of radius ORI_RADIUS
         const int nOriSampleBound = (2*ORI_RADIUS+1)*(2*ORI_RADIUS+1);
@@ -574,7 +606,11 @@ struct SURFInvoker : ParallelLoopBody
         // array lengths.  Maybe because it is a constant known at compile time
         const int nOriSampleBound =(2*ORI_RADIUS+1)*(2*ORI_RADIUS+1);
 
+        const int nOriSearch = 360/SURF_ORI_SEARCH_INC;
+
         float X[nOriSampleBound], Y[nOriSampleBound], angle[nOriSampleBound];
+        float sumX[nOriSearch], sumY[nOriSearch];
+        float vbuf[128];
         uchar PATCH[PATCH_SZ+1][PATCH_SZ+1];
         float DX[PATCH_SZ][PATCH_SZ], DY[PATCH_SZ][PATCH_SZ];
         Mat _patch(PATCH_SZ+1, PATCH_SZ+1, CV_8U, PATCH);
@@ -616,10 +652,32 @@ struct SURFInvoker : ParallelLoopBody
             }
 
             float descriptor_dir = 360.f - 90.f;
+            if( upright == 0 && !orientation )
+            {
+                /* Detection only: keep the angle the detector assigned, but drop
+                   the keypoints the orientation assignment would have dropped */
+                for( kk = 0, nangle = 0; kk < nOriSamples; kk++ )
+                {
+                    int x = cvRound( center.x + apt[kk].x*s - (float)(grad_wav_size-1)/2 );
+                    int y = cvRound( center.y + apt[kk].y*s - (float)(grad_wav_size-1)/2 );
+                    if( (unsigned)y < (unsigned)(sum->rows - grad_wav_size) &&
+                        (unsigned)x < (unsigned)(sum->cols - grad_wav_size) )
+                    {
+                        nangle++;
+                        break;
+                    }
+                }
+                if( nangle == 0 )
+                    kp.size = -1;
+                continue;
+            }
             if (upright == 0)
             {
                 resizeHaarPattern( dx_s, dx_t, NX, 4, grad_wav_size, sum->cols );
                 resizeHaarPattern( dy_s, dy_t, NY, 4, grad_wav_size, sum->cols );
+#if CV_SSE2
+                __m128 w4 = _mm_setr_ps(dx_t[0].w, dx_t[1].w, dy_t[0].w, dy_t[1].w);
+#endif
                 for( kk = 0, nangle = 0; kk < nOriSamples; kk++ )
                 {
                     int x = cvRound( center.x + apt[kk].x*s - (float)(grad_wav_size-1)/2 );
@@ -628,8 +686,29 @@ struct SURFInvoker : ParallelLoopBody
                         x < 0 || x >= sum->cols - grad_wav_size )
                         continue;
                     const int* ptr = &sum->at<int>(y, x);
-                    float vx = calcHaarPattern( ptr, dx_t, 2 );
-                    float vy = calcHaarPattern( ptr, dy_t, 2 );
+                    float vx, vy;
+#if CV_SSE2
+                    if( useSIMD )
+                    {
+                        // both rectangles of both wavelets at once, summed in double as calcHaarPattern does
+                        __m128i r = _mm_sub_epi32(
+                            _mm_add_epi32(_mm_setr_epi32(ptr[dx_t[0].p0], ptr[dx_t[1].p0], ptr[dy_t[0].p0], ptr[dy_t[1].p0]),
+                                          _mm_setr_epi32(ptr[dx_t[0].p3], ptr[dx_t[1].p3], ptr[dy_t[0].p3], ptr[dy_t[1].p3])),
+                            _mm_add_epi32(_mm_setr_epi32(ptr[dx_t[0].p1], ptr[dx_t[1].p1], ptr[dy_t[0].p1], ptr[dy_t[1].p1]),
+                                          _mm_setr_epi32(ptr[dx_t[0].p2], ptr[dx_t[1].p2], ptr[dy_t[0].p2], ptr[dy_t[1].p2])));
+                        __m128 w = _mm_mul_ps(_mm_cvtepi32_ps(r), w4);
+                        __m128d dx2 = _mm_cvtps_pd(w);
+                        __m128d dy2 = _mm_cvtps_pd(_mm_movehl_ps(w, w));
+                        __m128d d = _mm_add_pd(_mm_unpacklo_pd(dx2, dy2), _mm_unpackhi_pd(dx2, dy2));
+                        vx = (float)_mm_cvtsd_f64(d);
+                        vy = (float)_mm_cvtsd_f64(_mm_unpackhi_pd(d, d));
+                    }
+                    else
+#endif
+                    {
+                        vx = calcHaarPattern( ptr, dx_t, 2 );
+                        vy = calcHaarPattern( ptr, dy_t, 2 );
+                    }
                     X[nangle] = vx*aptw[kk];
                     Y[nangle] = vy*aptw[kk];
                     nangle++;
@@ -646,10 +725,39 @@ struct SURFInvoker : ParallelLoopBody
 
                 phase( Mat(1, nangle, CV_32F, X), Mat(1, nangle, CV_32F, Y), Mat(1, nangle, CV_32F, angle), true );
 
-                float bestx = 0, besty = 0, descriptor_mod = 0;
-                for( i = 0; i < 360; i += SURF_ORI_SEARCH_INC )
+                i = 0;
+#if CV_SSE2
+                if( useSIMD )
+                {
+                    // 4 window positions at once; every lane adds the samples in the scalar order
+                    int iangle[nOriSampleBound];
+                    for( j = 0; j < nangle; j++ )
+                        iangle[j] = cvRound(angle[j]);
+
+                    __m128i winLo = _mm_set1_epi32(ORI_WIN/2), winHi = _mm_set1_epi32(360-ORI_WIN/2);
+                    for( ; i <= 360 - SURF_ORI_SEARCH_INC*4; i += SURF_ORI_SEARCH_INC*4 )
+                    {
+                        __m128i dir = _mm_setr_epi32(i, i + SURF_ORI_SEARCH_INC, i + SURF_ORI_SEARCH_INC*2,
+                                                     i + SURF_ORI_SEARCH_INC*3);
+                        __m128 sumx4 = _mm_setzero_ps(), sumy4 = _mm_setzero_ps();
+                        for( j = 0; j < nangle; j++ )
+                        {
+                            __m128i d = _mm_sub_epi32(_mm_set1_epi32(iangle[j]), dir);
+                            __m128i sign = _mm_srai_epi32(d, 31);
+                            d = _mm_sub_epi32(_mm_xor_si128(d, sign), sign);
+                            __m128 inwin = _mm_castsi128_ps(_mm_or_si128(_mm_cmplt_epi32(d, winLo),
+                                                                         _mm_cmpgt_epi32(d, winHi)));
+                            sumx4 = _mm_add_ps(sumx4, _mm_and_ps(_mm_set1_ps(X[j]), inwin));
+                            sumy4 = _mm_add_ps(sumy4, _mm_and_ps(_mm_set1_ps(Y[j]), inwin));
+                        }
+                        _mm_storeu_ps(sumX + i/SURF_ORI_SEARCH_INC, sumx4);
+                        _mm_storeu_ps(sumY + i/SURF_ORI_SEARCH_INC, sumy4);
+                    }
+                }
+#endif
+                for( ; i < 360; i += SURF_ORI_SEARCH_INC )
                 {
-                    float sumx = 0, sumy = 0, temp_mod;
+                    float sumx = 0, sumy = 0;
                     for( j = 0; j < nangle; j++ )
                     {
                         int d = std::abs(cvRound(angle[j]) - i);
@@ -659,12 +767,19 @@ struct SURFInvoker : ParallelLoopBody
                             sumy += Y[j];
                         }
                     }
-                    temp_mod = sumx*sumx + sumy*sumy;
+                    sumX[i/SURF_ORI_SEARCH_INC] = sumx;
+                    sumY[i/SURF_ORI_SEARCH_INC] = sumy;
+                }
+
+                float bestx = 0, besty = 0, descriptor_mod = 0;
+                for( i = 0; i < nOriSearch; i++ )
+                {
+                    float temp_mod = sumX[i]*sumX[i] + sumY[i]*sumY[i];
                     if( temp_mod > descriptor_mod )
                     {
                         descriptor_mod = temp_mod;
-                        bestx = sumx;
-                        besty = sumy;
+                        bestx = sumX[i];
+                        besty = sumY[i];
                     }
                 }
                 descriptor_dir = fastAtan2( -besty, bestx );
@@ -774,7 +889,27 @@ struct SURFInvoker : ParallelLoopBody
 
             // Calculate gradients in x and y with wavelets of size 2s
             for( i = 0; i < PATCH_SZ; i++ )
-                for( j = 0; j < PATCH_SZ; j++ )
+            {
+                j = 0;
+#if CV_SSE2
+                if( useSIMD )
+                {
+                    __m128i z = _mm_setzero_si128();
+                    for( ; j <= PATCH_SZ - 4; j += 4 )
+                    {
+                        __m128i p00 = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(*(const int*)&PATCH[i][j]), z), z);
+                        __m128i p01 = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(*(const int*)&PATCH[i][j+1]), z), z);
+                        __m128i p10 = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(*(const int*)&PATCH[i+1][j]), z), z);
+                        __m128i p11 = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(*(const int*)&PATCH[i+1][j+1]), z), z);
+                        __m128 dw = _mm_loadu_ps(&DW[i*PATCH_SZ + j]);
+                        __m128i vx = _mm_add_epi32(_mm_sub_epi32(p01, p00), _mm_sub_epi32(p11, p10));
+                        __m128i vy = _mm_add_epi32(_mm_sub_epi32(p10, p00), _mm_sub_epi32(p11, p01));
+                        _mm_storeu_ps(&DX[i][j], _mm_mul_ps(_mm_cvtepi32_ps(vx), dw));
+                        _mm_storeu_ps(&DY[i][j], _mm_mul_ps(_mm_cvtepi32_ps(vy), dw));
+                    }
+                }
+#endif
+                for( ; j < PATCH_SZ; j++ )
                 {
                     float dw = DW[i*PATCH_SZ + j];
                     float vx = (PATCH[i][j+1] - PATCH[i][j] + PATCH[i+1][j+1] - PATCH[i+1][j])*dw;
@@ -782,12 +917,58 @@ struct SURFInvoker : ParallelLoopBody
                     DX[i][j] = vx;
                     DY[i][j] = vy;
                 }
+            }
 
-            // Construct the descriptor
-            vec = descriptors->ptr<float>(k);
+            // Construct the descriptor; the non-float ones are accumulated in a local buffer
+            // and stored by the normalization loop
+            float* vec0 = descriptors->type() == CV_32F ? descriptors->ptr<float>(k) : vbuf;
+            vec = vec0;
             for( kk = 0; kk < dsize; kk++ )
                 vec[kk] = 0;
             double square_mag = 0;
+#if CV_SSE2
+            if( useSIMD )
+            {
+                // every lane accumulates one descriptor bin in the scalar order
+                __m128 absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+                __m128 z = _mm_setzero_ps();
+                __m128 hi = _mm_castsi128_ps(_mm_set_epi32(-1, -1, 0, 0));
+                for( i = 0; i < 4; i++ )
+                    for( j = 0; j < 4; j++ )
+                    {
+                        __m128 acc0 = z, acc1 = z;
+                        for(int y = i*5; y < i*5+5; y++ )
+                        {
+                            for(int x = j*5; x < j*5+5; x++ )
+                            {
+                                __m128 t = _mm_unpacklo_ps(_mm_load_ss(&DX[y][x]), _mm_load_ss(&DY[y][x]));
+                                __m128 v = _mm_movelh_ps(t, _mm_and_ps(t, absmask)); // tx, ty, |tx|, |ty|
+                                if( extended )
+                                {
+                                    // tx, |tx| go to bins 0,1 if ty >= 0, else to 2,3; ty, |ty| to 4,5 if tx >= 0, else to 6,7
+                                    __m128 ge = _mm_cmpge_ps(t, z);
+                                    __m128 txv = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2,0,2,0));
+                                    __m128 tyv = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3,1,3,1));
+                                    __m128 tyge = _mm_shuffle_ps(ge, ge, _MM_SHUFFLE(1,1,1,1));
+                                    __m128 txge = _mm_shuffle_ps(ge, ge, _MM_SHUFFLE(0,0,0,0));
+                                    acc0 = _mm_add_ps(acc0, _mm_and_ps(txv, _mm_xor_ps(tyge, hi)));
+                                    acc1 = _mm_add_ps(acc1, _mm_and_ps(tyv, _mm_xor_ps(txge, hi)));
+                                }
+                                else
+                                    acc0 = _mm_add_ps(acc0, v);
+                            }
+                        }
+                        _mm_storeu_ps(vec, acc0);
+                        if( extended )
+                            _mm_storeu_ps(vec + 4, acc1);
+                        int nbins = extended ? 8 : 4;
+                        for( kk = 0; kk < nbins; kk++ )
+                            square_mag += vec[kk]*vec[kk];
+                        vec += nbins;
+                    }
+            }
+            else
+#endif
             if( extended )
             {
                 // 128-bin descriptor
@@ -844,10 +1025,19 @@ struct SURFInvoker : ParallelLoopBody
             }
 
             // unit vector is essential for contrast invariance
-            vec = descriptors->ptr<float>(k);
+            vec = vec0;
             float scale = (float)(1./(std::sqrt(square_mag) + DBL_EPSILON));
-            for( kk = 0; kk < dsize; kk++ )
-                vec[kk] *= scale;
+            if( descriptors->type() == CV_8U )
+            {
+                uchar* dst = descriptors->ptr(k);
+                for( kk = 0; kk < dsize; kk++ )
+                    dst[kk] = saturate_cast<uchar>((vec[kk]*scale + 1.f)*127.5f);
+            }
+            else
+            {
+                for( kk = 0; kk < dsize; kk++ )
+                    vec[kk] *= scale;
+            }
         }
     }
 
@@ -858,6 +1048,8 @@ struct SURFInvoker : ParallelLoopBody
     Mat* descriptors;
     bool extended;
     bool upright;
+    bool orientation;
+    bool useSIMD;
 
     // Pre-calculated values
     int nOriSamples;
@@ -874,19 +1066,32 @@ SURF::SURF()
     upright = false;
     nOctaves = 4;
     nOctaveLayers = 3;
+    descType = CV_32F;
+    nfeatures = 0;
+    gridSize = 1;
 }
 
-SURF::SURF(double _threshold, int _nOctaves, int _nOctaveLayers, bool _extended, bool _upright)
+SURF::SURF(double _threshold, int _nOctaves, int _nOctaveLayers, bool _extended, bool _upright,
+           int _descType, int _nfeatures, int _gridSize)
 {
     hessianThreshold = _threshold;
     extended = _extended;
     upright = _upright;
     nOctaves = _nOctaves;
     nOctaveLayers = _nOctaveLayers;
+    descType = _descType;
+    nfeatures = _nfeatures;
+    gridSize = _gridSize;
 }
 
 int SURF::descriptorSize() const { return extended ? 128 : 64; }
-int SURF::descriptorType() const { return CV_32F; }
+
+int SURF::descriptorType() const
+{
+    CV_Assert( descType == CV_32F || descType == CV_8U );
+    return descType;
+}
+
 int SURF::defaultNorm() const { return NORM_L2; }
 
 void SURF::operator()(InputArray imgarg, InputArray maskarg,
@@ -901,12 +1106,11 @@ void SURF::operator()(InputArray _img, InputArray _mask,
                       bool useProvidedKeypoints) const
 {
     int imgtype = _img.type(), imgcn = CV_MAT_CN(imgtype);
-    bool doDescriptors = _descriptors.needed();
 
     CV_Assert(!_img.empty() && CV_MAT_DEPTH(imgtype) == CV_8U && (imgcn == 1 || imgcn == 3 || imgcn == 4));
     CV_Assert(_descriptors.needed() || !useProvidedKeypoints);
 
-    if( ocl::useOpenCL() )
+    if( ocl::useOpenCL() && descriptorType() == CV_32F )
     {
         SURF_OCL ocl_surf;
         UMat gpu_kpt;
@@ -933,27 +1137,122 @@ void SURF::operator()(InputArray _img, InputArray _mask,
         }
     }
 
-    Mat img = _img.getMat(), mask = _mask.getMat(), mask1, sum, msum;
+    Mat img = _img.getMat(), sum;
 
     if( imgcn > 1 )
         cvtColor(img, img, COLOR_BGR2GRAY);
 
-    CV_Assert(mask.empty() || (mask.type() == CV_8U && mask.size() == img.size()));
+    integral(img, sum, CV_32S);
+
+    detectAndComputeIntegral(img, sum, _mask, keypoints, _descriptors, useProvidedKeypoints);
+}
+
+// Removes the keypoints SURFInvoker would drop: those too large for the image and,
+// unless upright, those without a single orientation sample inside the image
+static void removeUnsampledKeypoints( std::vector<KeyPoint>& keypoints, const Mat& sum, bool upright )
+{
+    const int R = SURFInvoker::ORI_RADIUS;
+    size_t i, j;
+    for( i = j = 0; i < keypoints.size(); i++ )
+    {
+        const Point2f& center = keypoints[i].pt;
+        float s = keypoints[i].size*1.2f/9.0f;
+        int grad_wav_size = 2*cvRound( 2*s );
+        bool sampled = sum.rows >= grad_wav_size && sum.cols >= grad_wav_size;
+        if( sampled && !upright )
+        {
+            sampled = false;
+            for( int u = -R; u <= R && !sampled; u++ )
+                for( int v = -R; v <= R && !sampled; v++ )
+                {
+                    if( u*u + v*v > R*R )
+                        continue;
+                    int x = cvRound( center.x + u*s - (float)(grad_wav_size-1)/2 );
+                    int y = cvRound( center.y + v*s - (float)(grad_wav_size-1)/2 );
+                    sampled = (unsigned)y < (unsigned)(sum.rows - grad_wav_size) &&
+                              (unsigned)x < (unsigned)(sum.cols - grad_wav_size);
+                }
+        }
+        if( sampled )
+            keypoints[j++] = keypoints[i];
+    }
+    keypoints.resize(j);
+}
+
+void SURF::detectAndComputeIntegral(InputArray _img, InputArray _sum, InputArray _mask,
+                                    CV_OUT std::vector<KeyPoint>& keypoints,
+                                    OutputArray _descriptors,
+                                    bool useProvidedKeypoints,
+                                    bool computeOrientation, Rect _roi) const
+{
+    Mat img = _img.getMat(), sum = _sum.getMat(), mask = _mask.getMat(), mask1, msum;
+    bool doDescriptors = _descriptors.needed();
+
+    CV_Assert(sum.type() == CV_32SC1 && sum.rows > 1 && sum.cols > 1);
+    CV_Assert(!doDescriptors || (img.type() == CV_8UC1 && img.rows == sum.rows-1 && img.cols == sum.cols-1));
+    CV_Assert(doDescriptors || !useProvidedKeypoints);
+    CV_Assert(computeOrientation || !doDescriptors);
+
+    Size imgSize(sum.cols-1, sum.rows-1);
+    CV_Assert(mask.empty() || (mask.type() == CV_8U && mask.size() == imgSize));
     CV_Assert(hessianThreshold >= 0);
     CV_Assert(nOctaves > 0);
     CV_Assert(nOctaveLayers > 0);
 
-    integral(img, sum, CV_32S);
-
     // Compute keypoints only if we are not asked for evaluating the descriptors are some given locations:
     if( !useProvidedKeypoints )
     {
+        Rect imgRect(Point(), imgSize);
+        Rect roi = _roi.area() > 0 ? (_roi & imgRect) : imgRect;
+
         if( !mask.empty() )
         {
+            // A feature is found as long as its largest wavelet overlaps the mask,
+            // so the Hessian is only evaluated around the non-zero part of the mask
+            Mat rowMax, colMax;
+            reduce(mask, rowMax, 1, REDUCE_MAX);
+            reduce(mask, colMax, 0, REDUCE_MAX);
+            int y0 = 0, y1 = imgSize.height, x0 = 0, x1 = imgSize.width;
+            while( y0 < y1 && rowMax.at<uchar>(y0) == 0 ) y0++;
+            while( y1 > y0 && rowMax.at<uchar>(y1-1) == 0 ) y1--;
+            while( x0 < x1 && colMax.at<uchar>(x0) == 0 ) x0++;
+            while( x1 > x0 && colMax.at<uchar>(x1-1) == 0 ) x1--;
+
+            int maxSize = (SURF_HAAR_SIZE0 + SURF_HAAR_SIZE_INC*(nOctaveLayers+1)) << (nOctaves-1);
+            if( y0 < y1 )
+                roi &= Rect(x0 - maxSize, y0 - maxSize, x1 - x0 + maxSize*2, y1 - y0 + maxSize*2);
+            else
+                roi = Rect();
+
             cv::min(mask, 1, mask1);
             integral(mask1, msum, CV_32S);
         }
-        fastHessianDetector( sum, msum, keypoints, nOctaves, nOctaveLayers, (float)hessianThreshold );
+
+        if( roi.area() > 0 )
+            fastHessianDetector( sum, msum, keypoints, nOctaves, nOctaveLayers, (float)hessianThreshold, roi );
+        else
+            keypoints.clear();
+
+        if( _roi.area() > 0 )
+        {
+            size_t i, j;
+            for( i = j = 0; i < keypoints.size(); i++ )
+            {
+                const Point2f& pt = keypoints[i].pt;
+                if( pt.x >= _roi.x && pt.y >= _roi.y &&
+                    pt.x < _roi.x + _roi.width && pt.y < _roi.y + _roi.height )
+                    keypoints[j++] = keypoints[i];
+            }
+            keypoints.resize(j);
+        }
+
+        // bound the orientation and descriptor work by the keypoint budget, after dropping
+        // the keypoints SURFInvoker would drop so that the budget is not spent on them
+        if( nfeatures > 0 )
+        {
+            removeUnsampledKeypoints(keypoints, sum, upright);
+            retainBestInGrid(keypoints, imgSize, nfeatures, std::max(gridSize, 1));
+        }
     }
 
     int i, j, N = (int)keypoints.size();
@@ -961,27 +1260,28 @@ void SURF::operator()(InputArray _img, InputArray _mask,
     {
         Mat descriptors;
         bool _1d = false;
-        int dcols = extended ? 128 : 64;
-        size_t dsize = dcols*sizeof(float);
+        int dcols = extended ? 128 : 64, dtype = descriptorType();
+        size_t dsize = dcols*CV_ELEM_SIZE(dtype);
 
         if( doDescriptors )
         {
-            _1d = _descriptors.kind() == _InputArray::STD_VECTOR && _descriptors.type() == CV_32F;
+            _1d = _descriptors.kind() == _InputArray::STD_VECTOR && _descriptors.type() == dtype;
             if( _1d )
             {
-                _descriptors.create(N*dcols, 1, CV_32F);
+                _descriptors.create(N*dcols, 1, dtype);
                 descriptors = _descriptors.getMat().reshape(1, N);
             }
             else
             {
-                _descriptors.create(N, dcols, CV_32F);
+                _descriptors.create(N, dcols, dtype);
                 descriptors = _descriptors.getMat();
             }
         }
 
         // we call SURFInvoker in any case, even if we do not need descriptors,
         // since it computes orientation of each feature.
-        parallel_for_(Range(0, N), SURFInvoker(img, sum, keypoints, descriptors, extended, upright) );
+        parallel_for_(Range(0, N), SURFInvoker(img, sum, keypoints, descriptors, extended, upright,
+                                               computeOrientation) );
 
         // remove keypoints that were marked for deletion
         for( i = j = 0; i < N; i++ )
@@ -1013,6 +1313,184 @@ void SURF::operator()(InputArray _img, InputArray _mask,
 }
 
 
+// Number of the non-zero cells in the tiles [x0, x1) x [y0, y1) of a tile map, tsum is its integral
+static inline int countTiles( const Mat& tsum, int x0, int y0, int x1, int y1 )
+{
+    x0 = std::max(x0, 0); y0 = std::max(y0, 0);
+    x1 = std::min(x1, tsum.cols - 1); y1 = std::min(y1, tsum.rows - 1);
+    if( x0 >= x1 || y0 >= y1 )
+        return 0;
+    return tsum.at<int>(y1, x1) - tsum.at<int>(y0, x1) - tsum.at<int>(y1, x0) + tsum.at<int>(y0, x0);
+}
+
+void SURF::detectAndComputeNext(InputArray _img, InputArray _changeMask, FrameCache& cache,
+                                CV_OUT std::vector<KeyPoint>& keypoints,
+                                OutputArray _descriptors) const
+{
+    Mat img = _img.getMat(), changeMask = _changeMask.getMat(), sum;
+
+    CV_Assert(!img.empty() && img.depth() == CV_8U);
+    if( img.channels() > 1 )
+        cvtColor(img, img, COLOR_BGR2GRAY);
+
+    CV_Assert(changeMask.empty() || (changeMask.type() == CV_8UC1 && changeMask.size() == img.size()));
+    CV_Assert(cache.tileSize > 0);
+
+    integral(img, sum, CV_32S);
+
+    // the features are found without the budget, it is applied to the merged result
+    SURF surf(hessianThreshold, nOctaves, nOctaveLayers, extended, upright, descType);
+
+    bool foundChanges = cache.frame.size() == img.size() && changeMask.empty();
+    if( cache.frame.size() != img.size() )
+    {
+        cache.descriptors.release();
+        surf.detectAndComputeIntegral(img, sum, noArray(), cache.keypoints, cache.descriptors);
+    }
+    else
+    {
+        if( foundChanges )
+            findChanges(img, cache.frame, cache.changeThreshold, cache.changeFilterSize, changeMask);
+
+        int ts = cache.tileSize;
+        int tcols = (img.cols + ts - 1)/ts, trows = (img.rows + ts - 1)/ts;
+        Mat dirty(trows, tcols, CV_8U), affected(trows, tcols, CV_8U), tsum;
+        for( int ty = 0; ty < trows; ty++ )
+            for( int tx = 0; tx < tcols; tx++ )
+            {
+                Rect tile(tx*ts, ty*ts, std::min(ts, img.cols - tx*ts), std::min(ts, img.rows - ty*ts));
+                dirty.at<uchar>(ty, tx) = countNonZero(changeMask(tile)) > 0;
+            }
+        integral(dirty, tsum, CV_32S);
+
+        // A keypoint depends on the pixels covered by the largest filter around it,
+        // plus one sample for the non-maxima suppression and one for the interpolation
+        int maxStep = 1 << (nOctaves-1);
+        int maxSize = (SURF_HAAR_SIZE0 + SURF_HAAR_SIZE_INC*(nOctaveLayers+1)) << (nOctaves-1);
+        int detMargin = maxSize/2 + maxStep*2 + 2;
+        int r = (detMargin + ts - 1)/ts;
+        for( int ty = 0; ty < trows; ty++ )
+            for( int tx = 0; tx < tcols; tx++ )
+                affected.at<uchar>(ty, tx) = countTiles(tsum, tx - r, ty - r, tx + r + 1, ty + r + 1) > 0;
+
+        // The cached keypoints of the affected tiles are detected again below; the others are
+        // kept, and only their orientation and descriptor are recomputed if the changes reach them
+        std::vector<KeyPoint> kept, refresh;
+        Mat keptDescriptors;
+        for( size_t i = 0; i < cache.keypoints.size(); i++ )
+        {
+            const KeyPoint& kp = cache.keypoints[i];
+            int tx = std::min(std::max(cvFloor(kp.pt.x/ts), 0), tcols - 1);
+            int ty = std::min(std::max(cvFloor(kp.pt.y/ts), 0), trows - 1);
+            if( affected.at<uchar>(ty, tx) )
+                continue;
+
+            // the rotated 20s x 20s window covers the orientation samples and their wavelets
+            int radius = cvCeil(kp.size*(1.2f/9.0f)*15) + 2;
+            if( countTiles(tsum, cvFloor((kp.pt.x - radius)/ts), cvFloor((kp.pt.y - radius)/ts),
+                           cvFloor((kp.pt.x + radius)/ts) + 1, cvFloor((kp.pt.y + radius)/ts) + 1) > 0 )
+                refresh.push_back(kp);
+            else
+            {
+                kept.push_back(kp);
+                keptDescriptors.push_back(cache.descriptors.row((int)i));
+            }
+        }
+
+        if( !refresh.empty() )
+        {
+            Mat descriptors;
+            surf.detectAndComputeIntegral(img, sum, noArray(), refresh, descriptors, true);
+            kept.insert(kept.end(), refresh.begin(), refresh.end());
+            keptDescriptors.push_back(descriptors);
+        }
+
+        // The affected tiles are merged into horizontal runs, and the runs spanning the same
+        // tiles in consecutive rows into rectangles
+        std::vector<Rect> runs;
+        for( int ty = 0; ty < trows; ty++ )
+            for( int tx = 0; tx < tcols; )
+            {
+                if( !affected.at<uchar>(ty, tx) )
+                {
+                    tx++;
+                    continue;
+                }
+                int tx0 = tx;
+                while( tx < tcols && affected.at<uchar>(ty, tx) )
+                    tx++;
+
+                size_t k = 0;
+                for( ; k < runs.size(); k++ )
+                    if( runs[k].x == tx0 && runs[k].width == tx - tx0 && runs[k].y + runs[k].height == ty )
+                        break;
+                if( k < runs.size() )
+                    runs[k].height++;
+                else
+                    runs.push_back(Rect(tx0, ty, tx - tx0, 1));
+            }
+
+        for( size_t k = 0; k < runs.size(); k++ )
+        {
+            const Rect& run = runs[k];
+            Rect roi(run.x*ts, run.y*ts, run.width*ts, run.height*ts);
+
+            // the keypoints interpolated slightly outside of the image belong to the border tiles
+            if( run.x == 0 ) { roi.x -= maxSize; roi.width += maxSize; }
+            if( run.y == 0 ) { roi.y -= maxSize; roi.height += maxSize; }
+            if( run.x + run.width == tcols ) roi.width += maxSize;
+            if( run.y + run.height == trows ) roi.height += maxSize;
+
+            std::vector<KeyPoint> found;
+            Mat descriptors;
+            surf.detectAndComputeIntegral(img, sum, noArray(), found, descriptors, false, true, roi);
+            if( !found.empty() )
+            {
+                kept.insert(kept.end(), found.begin(), found.end());
+                keptDescriptors.push_back(descriptors);
+            }
+        }
+
+        cache.keypoints.swap(kept);
+        cache.descriptors = keptDescriptors;
+    }
+    // the reference keeps the unchanged pixels, so the changes below the threshold add up
+    if( foundChanges )
+        img.copyTo(cache.frame, changeMask);
+    else
+        img.copyTo(cache.frame);
+
+    keypoints = cache.keypoints;
+    int i, n = (int)keypoints.size();
+    std::vector<int> rows(n);
+    for( i = 0; i < n; i++ )
+        rows[i] = i;
+
+    if( nfeatures > 0 && n > nfeatures )
+    {
+        // class_id holds the sign of the Laplacian, it is borrowed to track the descriptor rows
+        for( i = 0; i < n; i++ )
+            keypoints[i].class_id = i;
+        retainBestInGrid(keypoints, img.size(), nfeatures, std::max(gridSize, 1));
+
+        n = (int)keypoints.size();
+        rows.resize(n);
+        for( i = 0; i < n; i++ )
+        {
+            rows[i] = keypoints[i].class_id;
+            keypoints[i].class_id = cache.keypoints[rows[i]].class_id;
+        }
+    }
+
+    if( _descriptors.needed() )
+    {
+        _descriptors.create(n, descriptorSize(), descriptorType());
+        Mat descriptors = _descriptors.getMat();
+        for( i = 0; i < n; i++ )
+            cache.descriptors.row(rows[i]).copyTo(descriptors.row(i));
+    }
+}
+
 void SURF::detectImpl( InputArray image, std::vector<KeyPoint>& keypoints, InputArray mask) const
 {
     (*this)(image.getMat(), mask.getMat(), keypoints, noArray(), false);
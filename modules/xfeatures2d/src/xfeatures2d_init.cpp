@@ -59,7 +59,9 @@ CV_INIT_ALGORITHM(StarDetector, "Feature2D.STAR",
                   obj.info()->addParam(obj, "responseThreshold", obj.responseThreshold);
                   obj.info()->addParam(obj, "lineThresholdProjected", obj.lineThresholdProjected);
                   obj.info()->addParam(obj, "lineThresholdBinarized", obj.lineThresholdBinarized);
-                  obj.info()->addParam(obj, "suppressNonmaxSize", obj.suppressNonmaxSize))
+                  obj.info()->addParam(obj, "suppressNonmaxSize", obj.suppressNonmaxSize);
+                  obj.info()->addParam(obj, "nFeatures", obj.nfeatures);
+                  obj.info()->addParam(obj, "gridSize", obj.gridSize))
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -76,7 +78,10 @@ CV_INIT_ALGORITHM(SURF, "Feature2D.SURF",
                   obj.info()->addParam(obj, "nOctaves", obj.nOctaves);
                   obj.info()->addParam(obj, "nOctaveLayers", obj.nOctaveLayers);
                   obj.info()->addParam(obj, "extended", obj.extended);
-                  obj.info()->addParam(obj, "upright", obj.upright))
+                  obj.info()->addParam(obj, "upright", obj.upright);
+                  obj.info()->addParam(obj, "descriptorType", obj.descType);
+                  obj.info()->addParam(obj, "nFeatures", obj.nfeatures);
+                  obj.info()->addParam(obj, "gridSize", obj.gridSize))
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -85,7 +90,9 @@ CV_INIT_ALGORITHM(SIFT, "Feature2D.SIFT",
                   obj.info()->addParam(obj, "nOctaveLayers", obj.nOctaveLayers);
                   obj.info()->addParam(obj, "contrastThreshold", obj.contrastThreshold);
                   obj.info()->addParam(obj, "edgeThreshold", obj.edgeThreshold);
-                  obj.info()->addParam(obj, "sigma", obj.sigma))
+                  obj.info()->addParam(obj, "sigma", obj.sigma);
+                  obj.info()->addParam(obj, "descriptorType", obj.descType);
+                  obj.info()->addParam(obj, "gridSize", obj.gridSize))
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////
 
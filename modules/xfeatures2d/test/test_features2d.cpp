@@ -1231,3 +1231,369 @@ TEST(DISABLED_Features2d_SURF_using_mask, regression)
     FeatureDetectorUsingMaskTest test(Algorithm::create<FeatureDetector>("Feature2D.SURF"));
     test.safe_run();
 }
+
+TEST(Features2d_SIFT_pyramid, reuse_matches_direct)
+{
+    const string imageFilename = string(cvtest::TS::ptr()->get_data_path()) + FEATURES2D_DIR + "/" + IMAGE_FILENAME;
+    Mat image = imread(imageFilename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(image.empty()) << "Image " << imageFilename << " can not be read";
+
+    SIFT sift;
+    vector<KeyPoint> keypoints, pyrKeypoints;
+    Mat descriptors, pyrDescriptors;
+    sift(image, noArray(), keypoints, descriptors);
+
+    SIFT::Pyramid pyr;
+    sift.buildPyramid(image, pyr);
+    sift(pyr, noArray(), pyrKeypoints, noArray());
+    sift(pyr, noArray(), pyrKeypoints, pyrDescriptors, true);
+
+    ASSERT_EQ(keypoints.size(), pyrKeypoints.size());
+    for (size_t i = 0; i < keypoints.size(); ++i)
+    {
+        ASSERT_EQ(keypoints[i].pt, pyrKeypoints[i].pt);
+        ASSERT_EQ(keypoints[i].octave, pyrKeypoints[i].octave);
+    }
+    ASSERT_EQ(0, norm(descriptors, pyrDescriptors, NORM_INF));
+}
+
+TEST(Features2d_SIFT_pyramid, tiny_image_has_no_features)
+{
+    // a 1-pixel wide image is too small for a single octave
+    Mat tiny(1, 32, CV_8U);
+    randu(tiny, 0, 256);
+
+    SIFT sift;
+    vector<KeyPoint> keypoints(1);
+    Mat descriptors(1, sift.descriptorSize(), sift.descriptorType());
+    ASSERT_NO_THROW(sift(tiny, noArray(), keypoints, descriptors));
+    EXPECT_TRUE(keypoints.empty());
+    EXPECT_TRUE(descriptors.empty());
+
+    // as are the 1-pixel trailing tiles of an image without tile margins
+    const string imageFilename = string(cvtest::TS::ptr()->get_data_path()) + FEATURES2D_DIR + "/" + IMAGE_FILENAME;
+    Mat image = imread(imageFilename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(image.empty()) << "Image " << imageFilename << " can not be read";
+
+    Size tileSize(image.cols - 1, image.rows - 1);
+    ASSERT_NO_THROW(sift.detectAndComputeTiled(image, noArray(), keypoints, descriptors, tileSize, 0));
+    EXPECT_FALSE(keypoints.empty());
+    EXPECT_EQ(keypoints.size(), (size_t)descriptors.rows);
+}
+
+TEST(Features2d_SIFT_tiled, single_tile_matches_direct)
+{
+    const string imageFilename = string(cvtest::TS::ptr()->get_data_path()) + FEATURES2D_DIR + "/" + IMAGE_FILENAME;
+    Mat image = imread(imageFilename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(image.empty()) << "Image " << imageFilename << " can not be read";
+
+    SIFT sift;
+    vector<KeyPoint> keypoints, tiledKeypoints;
+    Mat descriptors, tiledDescriptors;
+    sift(image, noArray(), keypoints, descriptors);
+    sift.detectAndComputeTiled(image, noArray(), tiledKeypoints, tiledDescriptors, image.size(), 0);
+
+    ASSERT_EQ(keypoints.size(), tiledKeypoints.size());
+    for (size_t i = 0; i < keypoints.size(); ++i)
+        ASSERT_EQ(keypoints[i].pt, tiledKeypoints[i].pt);
+    ASSERT_EQ(0, norm(descriptors, tiledDescriptors, NORM_INF));
+
+    // small tiles find the same fine-scale features away from the tile borders
+    const int tile = 128, margin = 96;
+    sift.detectAndComputeTiled(image, noArray(), tiledKeypoints, tiledDescriptors, Size(tile, tile), margin);
+    ASSERT_EQ(tiledKeypoints.size(), (size_t)tiledDescriptors.rows);
+
+    int checked = 0, found = 0;
+    for (size_t i = 0; i < keypoints.size(); ++i)
+    {
+        const KeyPoint& kpt = keypoints[i];
+        int octave = kpt.octave & 255;
+        octave = octave < 128 ? octave : (-128 | octave);
+        int x = cvFloor(kpt.pt.x) % tile, y = cvFloor(kpt.pt.y) % tile;
+        if (octave > 0 || x < 2 || x >= tile - 2 || y < 2 || y >= tile - 2)
+            continue;
+        checked++;
+        for (size_t j = 0; j < tiledKeypoints.size(); ++j)
+            if (norm(kpt.pt - tiledKeypoints[j].pt) < 1e-3 && kpt.octave == tiledKeypoints[j].octave)
+            {
+                found++;
+                break;
+            }
+    }
+    ASSERT_GT(checked, 0);
+    EXPECT_GE(found, checked * 95 / 100);
+}
+
+TEST(Features2d_BRIEF_integral, matches_compute)
+{
+    const string imageFilename = string(cvtest::TS::ptr()->get_data_path()) + FEATURES2D_DIR + "/" + IMAGE_FILENAME;
+    Mat image = imread(imageFilename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(image.empty()) << "Image " << imageFilename << " can not be read";
+
+    vector<KeyPoint> keypoints;
+    FAST(image, keypoints, 20);
+
+    BriefDescriptorExtractor brief(32);
+    vector<KeyPoint> integralKeypoints = keypoints;
+    Mat descriptors, integralDescriptors, sum;
+    brief.compute(image, keypoints, descriptors);
+    integral(image, sum, CV_32S);
+    brief.computeFromIntegral(sum, integralKeypoints, integralDescriptors);
+
+    ASSERT_EQ(keypoints.size(), integralKeypoints.size());
+    ASSERT_EQ(0, norm(descriptors, integralDescriptors, NORM_HAMMING));
+}
+
+TEST(Features2d_SURF_integral, roi_and_detection_only)
+{
+    const string imageFilename = string(cvtest::TS::ptr()->get_data_path()) + FEATURES2D_DIR + "/" + IMAGE_FILENAME;
+    Mat image = imread(imageFilename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(image.empty()) << "Image " << imageFilename << " can not be read";
+
+    SURF surf(400);
+    vector<KeyPoint> keypoints;
+    surf(image, noArray(), keypoints);
+
+    Mat sum;
+    integral(image, sum, CV_32S);
+    Rect roi(image.cols/4, image.rows/4, image.cols/2, image.rows/2);
+
+    vector<KeyPoint> expected;
+    for (size_t i = 0; i < keypoints.size(); ++i)
+        if (roi.contains(Point(cvFloor(keypoints[i].pt.x), cvFloor(keypoints[i].pt.y))))
+            expected.push_back(keypoints[i]);
+
+    vector<KeyPoint> roiKeypoints;
+    surf.detectAndComputeIntegral(noArray(), sum, noArray(), roiKeypoints, noArray(), false, false, roi);
+
+    ASSERT_EQ(expected.size(), roiKeypoints.size());
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        ASSERT_EQ(expected[i].pt, roiKeypoints[i].pt);
+        ASSERT_EQ(-1.f, roiKeypoints[i].angle);
+    }
+}
+
+TEST(Features2d_SURF_nfeatures, budget_is_filled)
+{
+    const string imageFilename = string(cvtest::TS::ptr()->get_data_path()) + FEATURES2D_DIR + "/" + IMAGE_FILENAME;
+    Mat image = imread(imageFilename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(image.empty()) << "Image " << imageFilename << " can not be read";
+
+    vector<KeyPoint> keypoints;
+    Mat descriptors;
+    SURF(400)(image, noArray(), keypoints, descriptors);
+    int total = (int)keypoints.size();
+    ASSERT_GT(total, 10);
+
+    // the keypoints dropped near the image borders do not take a place in the budget
+    for (int gridSize = 1; gridSize <= 4; gridSize *= 4)
+    {
+        SURF(400, 4, 2, true, false, CV_32F, total, gridSize)(image, noArray(), keypoints, descriptors);
+        EXPECT_EQ(total, (int)keypoints.size()) << "gridSize " << gridSize;
+        EXPECT_EQ(total, descriptors.rows) << "gridSize " << gridSize;
+
+        SURF(400, 4, 2, true, false, CV_32F, total/2, gridSize)(image, noArray(), keypoints, descriptors);
+        EXPECT_EQ(total/2, (int)keypoints.size()) << "gridSize " << gridSize;
+        EXPECT_EQ(total/2, descriptors.rows) << "gridSize " << gridSize;
+    }
+}
+
+TEST(Features2d_SIFT_descriptorType, uchar_matches_float)
+{
+    const string imageFilename = string(cvtest::TS::ptr()->get_data_path()) + FEATURES2D_DIR + "/" + IMAGE_FILENAME;
+    Mat image = imread(imageFilename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(image.empty()) << "Image " << imageFilename << " can not be read";
+
+    SIFT sift, sift8u(0, 3, 0.04, 10, 1.6, CV_8U);
+    vector<KeyPoint> keypoints;
+    Mat descriptors, descriptors8u;
+    sift(image, noArray(), keypoints, descriptors);
+    sift8u(image, noArray(), keypoints, descriptors8u, true);
+
+    ASSERT_EQ(CV_8U, descriptors8u.type());
+    Mat converted;
+    descriptors8u.convertTo(converted, CV_32F);
+    ASSERT_EQ(0, norm(descriptors, converted, NORM_INF));
+}
+
+TEST(Features2d_SURF_descriptorType, uchar_matches_float)
+{
+    const string imageFilename = string(cvtest::TS::ptr()->get_data_path()) + FEATURES2D_DIR + "/" + IMAGE_FILENAME;
+    Mat image = imread(imageFilename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(image.empty()) << "Image " << imageFilename << " can not be read";
+
+    SURF surf(400.), surf8u(400., 4, 2, true, false, CV_8U);
+    vector<KeyPoint> keypoints;
+    Mat descriptors, descriptors8u;
+    surf(image, noArray(), keypoints, descriptors);
+    surf8u(image, noArray(), keypoints, descriptors8u, true);
+    ASSERT_EQ(CV_8U, descriptors8u.type());
+
+    // the components are mapped from [-1, 1] to [0, 255] and rounded
+    Mat converted;
+    descriptors8u.convertTo(converted, CV_32F, 1./127.5, -1.);
+    ASSERT_LE(norm(descriptors, converted, NORM_INF), 0.5/127.5 + 1e-6);
+
+    // BFMatcher takes the 8-bit descriptors as they are
+    vector<DMatch> matches;
+    BFMatcher(surf8u.defaultNorm()).match(descriptors8u, descriptors8u, matches);
+    ASSERT_EQ(keypoints.size(), matches.size());
+
+    // and the rounding hardly ever changes the nearest float descriptor
+    BFMatcher(surf.defaultNorm()).match(converted, descriptors, matches);
+    int found = 0;
+    for (size_t i = 0; i < matches.size(); ++i)
+        found += matches[i].queryIdx == matches[i].trainIdx;
+    EXPECT_GE(found, cvRound(matches.size()*0.99));
+}
+
+TEST(Features2d_retainBestInGrid, budget_is_spread_over_cells)
+{
+    // a strong cluster in the top-left corner and weak keypoints elsewhere
+    vector<KeyPoint> keypoints;
+    for (int i = 0; i < 100; ++i)
+        keypoints.push_back(KeyPoint(Point2f(5.f + i % 10, 5.f + i / 10), 7.f, -1, 100.f + i));
+    for (int i = 0; i < 3; ++i)
+    {
+        keypoints.push_back(KeyPoint(Point2f(150.f + i, 20.f), 7.f, -1, 1.f + i));
+        keypoints.push_back(KeyPoint(Point2f(20.f, 150.f + i), 7.f, -1, 1.f + i));
+        keypoints.push_back(KeyPoint(Point2f(150.f, 150.f + i), 7.f, -1, 1.f + i));
+    }
+
+    vector<KeyPoint> kept = keypoints;
+    retainBestInGrid(kept, Size(200, 200), 20, 2);
+    ASSERT_EQ(20u, kept.size());
+
+    int counts[4] = { 0, 0, 0, 0 };
+    for (size_t i = 0; i < kept.size(); ++i)
+        counts[(kept[i].pt.y >= 100 ? 2 : 0) + (kept[i].pt.x >= 100 ? 1 : 0)]++;
+    ASSERT_EQ(11, counts[0]);
+    ASSERT_EQ(3, counts[1]);
+    ASSERT_EQ(3, counts[2]);
+    ASSERT_EQ(3, counts[3]);
+
+    // the strongest keypoints of the cluster are kept, in their original order
+    for (size_t i = 0; i < 11; ++i)
+        ASSERT_EQ(100.f + 89 + i, kept[i].response);
+}
+
+struct KeyPointIndexLess
+{
+    KeyPointIndexLess(const vector<KeyPoint>& _keypoints) : keypoints(&_keypoints) {}
+
+    bool operator()(int a, int b) const
+    {
+        const KeyPoint &ka = (*keypoints)[a], &kb = (*keypoints)[b];
+        if (ka.pt.y != kb.pt.y) return ka.pt.y < kb.pt.y;
+        if (ka.pt.x != kb.pt.x) return ka.pt.x < kb.pt.x;
+        if (ka.size != kb.size) return ka.size < kb.size;
+        return ka.response < kb.response;
+    }
+
+    const vector<KeyPoint>* keypoints;
+};
+
+static vector<int> sortedKeyPointIndices(const vector<KeyPoint>& keypoints)
+{
+    vector<int> idx(keypoints.size());
+    for (size_t i = 0; i < idx.size(); ++i)
+        idx[i] = (int)i;
+    std::sort(idx.begin(), idx.end(), KeyPointIndexLess(keypoints));
+    return idx;
+}
+
+TEST(Features2d_SURF_sequence, matches_full_extraction)
+{
+    const string imageFilename = string(cvtest::TS::ptr()->get_data_path()) + FEATURES2D_DIR + "/" + IMAGE_FILENAME;
+    Mat image = imread(imageFilename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(image.empty()) << "Image " << imageFilename << " can not be read";
+
+    Mat frame = image.clone();
+    rectangle(frame, Rect(frame.cols/3, frame.rows/3, 40, 30), Scalar::all(255), -1);
+
+    SURF surf(500., 2, 2);
+    SURF::FrameCache cache;
+    vector<KeyPoint> keypoints, expected;
+    Mat descriptors, expectedDescriptors;
+    surf.detectAndComputeNext(image, noArray(), cache, keypoints, descriptors);
+    surf.detectAndComputeNext(frame, noArray(), cache, keypoints, descriptors);
+    Mat sum;
+    integral(frame, sum, CV_32S);
+    surf.detectAndComputeIntegral(frame, sum, noArray(), expected, expectedDescriptors);
+
+    ASSERT_EQ(expected.size(), keypoints.size());
+    vector<int> idx = sortedKeyPointIndices(keypoints), expectedIdx = sortedKeyPointIndices(expected);
+    for (size_t i = 0; i < idx.size(); ++i)
+    {
+        const KeyPoint &kp = keypoints[idx[i]], &ekp = expected[expectedIdx[i]];
+        ASSERT_EQ(ekp.pt, kp.pt);
+        ASSERT_EQ(ekp.size, kp.size);
+        ASSERT_EQ(ekp.angle, kp.angle);
+        ASSERT_EQ(0, norm(expectedDescriptors.row(expectedIdx[i]), descriptors.row(idx[i]), NORM_INF));
+    }
+}
+
+TEST(Features2d_SURF_sequence, change_threshold)
+{
+    const string imageFilename = string(cvtest::TS::ptr()->get_data_path()) + FEATURES2D_DIR + "/" + IMAGE_FILENAME;
+    Mat image = imread(imageFilename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(image.empty()) << "Image " << imageFilename << " can not be read";
+    // no saturation below
+    image.convertTo(image, CV_8U, 0.5, 50);
+
+    SURF surf(500., 2, 2);
+    SURF::FrameCache cache;
+    cache.changeThreshold = 2;
+    vector<KeyPoint> first, keypoints, expected;
+    Mat firstDescriptors, descriptors, expectedDescriptors;
+    surf.detectAndComputeNext(image, noArray(), cache, first, firstDescriptors);
+
+    // changes up to the threshold are ignored, the cached features are returned
+    Mat frame = image + Scalar::all(2);
+    surf.detectAndComputeNext(frame, noArray(), cache, keypoints, descriptors);
+    ASSERT_EQ(first.size(), keypoints.size());
+    for (size_t i = 0; i < first.size(); ++i)
+        ASSERT_EQ(first[i].pt, keypoints[i].pt);
+    ASSERT_EQ(0, norm(firstDescriptors, descriptors, NORM_INF));
+
+    // but they add up: the reference is still the first frame, which differs by 4 now
+    frame = image + Scalar::all(4);
+    surf.detectAndComputeNext(frame, noArray(), cache, keypoints, descriptors);
+    Mat sum;
+    integral(frame, sum, CV_32S);
+    surf.detectAndComputeIntegral(frame, sum, noArray(), expected, expectedDescriptors);
+
+    ASSERT_EQ(expected.size(), keypoints.size());
+    vector<int> idx = sortedKeyPointIndices(keypoints), expectedIdx = sortedKeyPointIndices(expected);
+    for (size_t i = 0; i < idx.size(); ++i)
+    {
+        ASSERT_EQ(expected[expectedIdx[i]].pt, keypoints[idx[i]].pt);
+        ASSERT_EQ(0, norm(expectedDescriptors.row(expectedIdx[i]), descriptors.row(idx[i]), NORM_INF));
+    }
+}
+
+TEST(Features2d_SIFT_sequence, matches_tiled_extraction)
+{
+    const string imageFilename = string(cvtest::TS::ptr()->get_data_path()) + FEATURES2D_DIR + "/" + IMAGE_FILENAME;
+    Mat image = imread(imageFilename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(image.empty()) << "Image " << imageFilename << " can not be read";
+
+    Mat frame = image.clone();
+    rectangle(frame, Rect(10, 10, 30, 20), Scalar::all(255), -1);
+
+    SIFT sift;
+    SIFT::FrameCache cache;
+    cache.tileSize = Size(96, 96);
+    cache.tileMargin = 32;
+    vector<KeyPoint> keypoints, expected;
+    Mat descriptors, expectedDescriptors;
+    sift.detectAndComputeNext(image, noArray(), cache, keypoints, descriptors);
+    sift.detectAndComputeNext(frame, noArray(), cache, keypoints, descriptors);
+    sift.detectAndComputeTiled(frame, noArray(), expected, expectedDescriptors, cache.tileSize, cache.tileMargin);
+
+    ASSERT_EQ(expected.size(), keypoints.size());
+    for (size_t i = 0; i < expected.size(); ++i)
+        ASSERT_EQ(expected[i].pt, keypoints[i].pt);
+    ASSERT_EQ(0, norm(expectedDescriptors, descriptors, NORM_INF));
+}
@@ -82,14 +82,18 @@ class CV_EXPORTS GuidedFilter : public Algorithm
 {
 public:
 
+    /*Work buffers are kept between calls, so filtering many sources with one guide is cheap,
+      but an instance must not be used from several threads at once*/
     virtual void filter(InputArray src, OutputArray dst, int dDepth = -1) = 0;
 };
 
-/*Fabric function for Guided Filter*/
-CV_EXPORTS Ptr<GuidedFilter> createGuidedFilter(InputArray guide, int radius, double eps);
+/*Fabric function for Guided Filter.
+  scale > 1 selects the fast guided filter: the coefficients are computed on the guide and the source
+  subsampled scale times (with radius scaled accordingly), then bilinearly upsampled and applied at full size*/
+CV_EXPORTS Ptr<GuidedFilter> createGuidedFilter(InputArray guide, int radius, double eps, int scale = 1);
 
 /*One-line Guided Filter call*/
-CV_EXPORTS void guidedFilter(InputArray guide, InputArray src, OutputArray dst, int radius, double eps, int dDepth = -1);
+CV_EXPORTS void guidedFilter(InputArray guide, InputArray src, OutputArray dst, int radius, double eps, int dDepth = -1, int scale = 1);
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -119,8 +123,45 @@ CV_EXPORTS void amFilter(InputArray joint, InputArray src, OutputArray dst, doub
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
+/*Engines of the joint bilateral filter*/
+enum JointBilateralFilterEngine
+{
+    /*exact filtering over the circular window of diameter d, O(d^2) per pixel*/
+    JBF_BRUTE_FORCE,
+
+    /*dense bilateral grid sampled at sigmaSpace and sigmaColor, for 1-3 channel guides.
+      It takes (rows/sigmaSpace + 6)*(cols/sigmaSpace + 6)*(src channels + 1) floats times
+      (channel range/sigmaColor + 6) for every guide channel; above 64 MiB or for 4-channel guides
+      JBF_PERMUTOHEDRAL is used instead*/
+    JBF_BILATERAL_GRID,
+
+    /*sparse permutohedral lattice, for guides with any number of channels*/
+    JBF_PERMUTOHEDRAL
+};
+
+/*Interface for Joint Bilateral Filter (brute force engine) with a fixed guide*/
+class CV_EXPORTS JointBilateralFilter : public Algorithm
+{
+public:
+
+    virtual void filter(InputArray src, OutputArray dst) = 0;
+
+    /*Filters several sources of the guide depth in one pass over the guide:
+      the weights of every window are computed once and shared by all sources and channels*/
+    virtual void filterMultiple(InputArrayOfArrays srcs, OutputArrayOfArrays dsts) = 0;
+};
+
+/*Fabric function for Joint Bilateral Filter.
+  The bordered guide, the color weights table and the spatial kernel are computed here once*/
+CV_EXPORTS
+Ptr<JointBilateralFilter> createJointBilateralFilter(InputArray joint, int d, double sigmaColor, double sigmaSpace, int borderType = BORDER_DEFAULT);
+
+/*One-line Joint Bilateral Filter call.
+  JBF_BILATERAL_GRID and JBF_PERMUTOHEDRAL filter with gaussian kernels (euclidean distance in the guide space)
+  in time independent of sigmaSpace, d and borderType are ignored by them.
+  8U, 16U and 32F images are accepted, the brute force engine filters 16U sources without float copies*/
 CV_EXPORTS
-void jointBilateralFilter(InputArray joint, InputArray src, OutputArray dst, int d, double sigmaColor, double sigmaSpace, int borderType = BORDER_DEFAULT);
+void jointBilateralFilter(InputArray joint, InputArray src, OutputArray dst, int d, double sigmaColor, double sigmaSpace, int borderType = BORDER_DEFAULT, int engine = JBF_BRUTE_FORCE);
 
 }
 }
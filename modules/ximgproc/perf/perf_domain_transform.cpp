@@ -86,4 +86,33 @@ PERF_TEST_P( DomainTransformTest, perf,
     SANITY_CHECK(dst);
 }
 
+typedef tuple<SourceMatType, DTFMode> DTTest4KParams;
+typedef TestBaseWithParam<DTTest4KParams> DomainTransformTest4K;
+
+PERF_TEST_P( DomainTransformTest4K, perf,
+             Combine(
+                      Values(CV_8UC3, CV_32FC3, CV_32FC4),
+                      DTFMode::all()
+                    )
+           )
+{
+    int srcType = get<0>(GetParam());
+    int dtfType = get<1>(GetParam());
+    Size size(3840, 2160);
+
+    Mat guide(size, CV_8UC3);
+    Mat src(size, srcType);
+    Mat dst(size, srcType);
+
+    declare.in(guide, src, WARMUP_RNG).out(dst).tbb_threads(cv::getNumberOfCPUs());
+
+    cv::setNumThreads(cv::getNumberOfCPUs());
+    TEST_CYCLE_N(5)
+    {
+        dtFilter(guide, src, dst, 10.0, 30.0, dtfType);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
 }
\ No newline at end of file
@@ -78,4 +78,28 @@ PERF_TEST_P( GuidedFilterPerfTest, perf, Combine(GuideTypes::all(), SrcTypes::al
     SANITY_CHECK(dst);
 }
 
+typedef tuple<SrcTypes, int> FastGFParams;
+typedef TestBaseWithParam<FastGFParams> FastGuidedFilterPerfTest;
+
+PERF_TEST_P( FastGuidedFilterPerfTest, perf, Combine(SrcTypes::all(), Values(1, 2, 4)) )
+{
+    FastGFParams params = GetParam();
+    int srcType = get<0>(params);
+    int scale   = get<1>(params);
+
+    Mat guide(sz1080p, CV_8UC3);
+    Mat src(sz1080p, srcType);
+    Mat dst(sz1080p, srcType);
+
+    declare.in(guide, src, WARMUP_RNG).out(dst).tbb_threads(cv::getNumberOfCPUs());
+
+    cv::setNumThreads(cv::getNumberOfCPUs());
+    TEST_CYCLE_N(3)
+    {
+        guidedFilter(guide, src, dst, 16, 100.0, -1, scale);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
 }
\ No newline at end of file
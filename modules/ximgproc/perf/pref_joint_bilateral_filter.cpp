@@ -82,4 +82,83 @@ PERF_TEST_P(JointBilateralFilterTest, perf,
     
     SANITY_CHECK(dst);
 }
+
+typedef tuple<MatType, int, bool> JBFMultipleTestParam;
+typedef TestBaseWithParam<JBFMultipleTestParam> JointBilateralFilterMultipleTest;
+
+PERF_TEST_P(JointBilateralFilterMultipleTest, perf,
+    Combine(
+    Values(CV_8U, CV_32F),
+    Values(1, 3),
+    Values(false, true))
+)
+{
+    JBFMultipleTestParam params = GetParam();
+    int depth       = get<0>(params);
+    int jCn         = get<1>(params);
+    bool shared     = get<2>(params);
+
+    //one color guide and several one-channel maps (depth, confidence, labels, ...)
+    const int srcsNum = 4;
+    Mat joint(szVGA, CV_MAKE_TYPE(depth, jCn));
+    std::vector<Mat> srcs(srcsNum), dsts(srcsNum);
+    for (int i = 0; i < srcsNum; i++)
+    {
+        srcs[i].create(szVGA, CV_MAKE_TYPE(depth, 1));
+        dsts[i].create(szVGA, CV_MAKE_TYPE(depth, 1));
+        declare.in(srcs[i], WARMUP_RNG).out(dsts[i]);
+    }
+
+    cv::setNumThreads(cv::getNumberOfCPUs());
+    declare.in(joint, WARMUP_RNG).tbb_threads(cv::getNumberOfCPUs()).time(120);
+
+    TEST_CYCLE_N(1)
+    {
+        if (shared)
+        {
+            Ptr<JointBilateralFilter> jbf = createJointBilateralFilter(joint, 0, 32.0, 8.0);
+            jbf->filterMultiple(srcs, dsts);
+        }
+        else
+        {
+            for (int i = 0; i < srcsNum; i++)
+                jointBilateralFilter(joint, srcs[i], dsts[i], 0, 32.0, 8.0);
+        }
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
+CV_ENUM(JBFEngine, JBF_BRUTE_FORCE, JBF_BILATERAL_GRID, JBF_PERMUTOHEDRAL)
+typedef tuple<double, MatType, int, JBFEngine> JBFEngineTestParam;
+typedef TestBaseWithParam<JBFEngineTestParam> JointBilateralFilterEngineTest;
+
+PERF_TEST_P(JointBilateralFilterEngineTest, perf,
+    Combine(
+    Values(4.0, 16.0, 32.0),
+    Values(CV_8U, CV_32F),
+    Values(1, 3),
+    JBFEngine::all())
+)
+{
+    JBFEngineTestParam params = GetParam();
+    double sigmaS   = get<0>(params);
+    int depth       = get<1>(params);
+    int jCn         = get<2>(params);
+    int engine      = get<3>(params);
+
+    Mat joint(szVGA, CV_MAKE_TYPE(depth, jCn));
+    Mat src(szVGA, CV_MAKE_TYPE(depth, 1));
+    Mat dst(szVGA, src.type());
+
+    cv::setNumThreads(cv::getNumberOfCPUs());
+    declare.in(joint, src, WARMUP_RNG).out(dst).tbb_threads(cv::getNumberOfCPUs()).time(120);
+
+    TEST_CYCLE_N(1)
+    {
+        jointBilateralFilter(joint, src, dst, 0, 32.0, sigmaS, BORDER_DEFAULT, engine);
+    }
+
+    SANITY_CHECK_NOTHING();
+}
 }
\ No newline at end of file
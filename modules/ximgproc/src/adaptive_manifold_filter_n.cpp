@@ -55,6 +55,235 @@ using namespace cv::ximgproc::intrinsics;
 
 void computeEigenVector(const Mat1f& X, const Mat1b& mask, Mat1f& dst, int num_pca_iterations, const Mat1f& rand_vec);
 
+/*Row-parallel building blocks of the filter, each row (or strip of columns) is computed exactly as in a serial loop*/
+
+struct HFilterHor_ParBody : public ParallelLoopBody
+{
+    const Mat1f &src;
+    Mat &dst;
+    float a;
+
+    HFilterHor_ParBody(const Mat1f& src_, Mat& dst_, float a_) : src(src_), dst(dst_), a(a_) {}
+
+    void operator () (const Range& range) const
+    {
+        for (int y = range.start; y < range.end; ++y)
+        {
+            const float* src_row = src[y];
+            float* dst_row = dst.ptr<float>(y);
+
+            dst_row[0] = src_row[0];
+            for (int x = 1; x < src.cols; ++x)
+            {
+                dst_row[x] = src_row[x] + a * (dst_row[x - 1] - src_row[x]);
+            }
+            for (int x = src.cols - 2; x >= 0; --x)
+            {
+                dst_row[x] = dst_row[x] + a * (dst_row[x + 1] - dst_row[x]);
+            }
+        }
+    }
+};
+
+struct HFilterVert_ParBody : public ParallelLoopBody
+{
+    Mat &dst;
+    float a;
+    enum { BLOCK_COLS = 64 };
+
+    HFilterVert_ParBody(Mat& dst_, float a_) : dst(dst_), a(a_) {}
+
+    Range getRange() const { return Range(0, (dst.cols + BLOCK_COLS - 1) / BLOCK_COLS); }
+
+    void operator () (const Range& range) const
+    {
+        int j0 = range.start * BLOCK_COLS;
+        int cols = std::min(range.end * BLOCK_COLS, dst.cols) - j0;
+
+        for (int y = 1; y < dst.rows; ++y)
+        {
+            float* dst_cur_row = dst.ptr<float>(y) + j0;
+            float* dst_prev_row = dst.ptr<float>(y-1) + j0;
+
+            rf_vert_row_pass(dst_cur_row, dst_prev_row, a, cols);
+        }
+        for (int y = dst.rows - 2; y >= 0; --y)
+        {
+            float* dst_cur_row = dst.ptr<float>(y) + j0;
+            float* dst_prev_row = dst.ptr<float>(y+1) + j0;
+
+            rf_vert_row_pass(dst_cur_row, dst_prev_row, a, cols);
+        }
+    }
+};
+
+struct ComputeDTHor_ParBody : public ParallelLoopBody
+{
+    vector<Mat> &srcCn;
+    Mat &dst;
+    float sigmaRatioSqr, lnAlpha;
+
+    ComputeDTHor_ParBody(vector<Mat>& srcCn_, Mat& dst_, float sigmaRatioSqr_, float lnAlpha_)
+        : srcCn(srcCn_), dst(dst_), sigmaRatioSqr(sigmaRatioSqr_), lnAlpha(lnAlpha_) {}
+
+    void operator () (const Range& range) const
+    {
+        int cnNum = (int)srcCn.size();
+        int w = srcCn[0].cols;
+
+        for (int i = range.start; i < range.end; i++)
+        {
+            float *dstRow = dst.ptr<float>(i);
+
+            for (int cn = 0; cn < cnNum; cn++)
+            {
+                float *curCnRow = srcCn[cn].ptr<float>(i);
+
+                if (cn == 0)
+                    sqr_dif(dstRow, curCnRow, curCnRow + 1, w - 1);
+                else
+                    add_sqr_dif(dstRow, curCnRow, curCnRow + 1, w - 1);
+            }
+
+            mad(dstRow, dstRow, sigmaRatioSqr, 1.0f, w - 1);
+            sqrt_(dstRow, dstRow, w - 1);
+            mul(dstRow, dstRow, lnAlpha, w - 1);
+        }
+
+        Mat dstRows = dst.rowRange(range);
+        cv::exp(dstRows, dstRows);
+    }
+};
+
+struct ComputeDTVer_ParBody : public ParallelLoopBody
+{
+    vector<Mat> &srcCn;
+    Mat &dst;
+    float sigmaRatioSqr, lnAlpha;
+
+    ComputeDTVer_ParBody(vector<Mat>& srcCn_, Mat& dst_, float sigmaRatioSqr_, float lnAlpha_)
+        : srcCn(srcCn_), dst(dst_), sigmaRatioSqr(sigmaRatioSqr_), lnAlpha(lnAlpha_) {}
+
+    void operator () (const Range& range) const
+    {
+        int cnNum = (int)srcCn.size();
+        int w = srcCn[0].cols;
+
+        for (int i = range.start; i < range.end; i++)
+        {
+            float *dstRow = dst.ptr<float>(i);
+
+            for (int cn = 0; cn < cnNum; cn++)
+            {
+                float *srcRow1 = srcCn[cn].ptr<float>(i);
+                float *srcRow2 = srcCn[cn].ptr<float>(i+1);
+
+                if (cn == 0)
+                    sqr_dif(dstRow, srcRow1, srcRow2, w);
+                else
+                    add_sqr_dif(dstRow, srcRow1, srcRow2, w);
+            }
+
+            mad(dstRow, dstRow, sigmaRatioSqr, 1.0f, w);
+            sqrt_(dstRow, dstRow, w);
+            mul(dstRow, dstRow, lnAlpha, w);
+        }
+
+        Mat dstRows = dst.rowRange(range);
+        cv::exp(dstRows, dstRows);
+    }
+};
+
+struct ComputeWk_ParBody : public ParallelLoopBody
+{
+    vector<Mat> &etak, &jointCn;
+    Mat &dst;
+    Mat1f &minDistToManifoldSquared;
+    float argConst;
+
+    ComputeWk_ParBody(vector<Mat>& etak_, vector<Mat>& jointCn_, Mat& dst_, Mat1f& minDist_, float argConst_)
+        : etak(etak_), jointCn(jointCn_), dst(dst_), minDistToManifoldSquared(minDist_), argConst(argConst_) {}
+
+    void operator () (const Range& range) const
+    {
+        int cnNum = (int)jointCn.size();
+        int w = dst.cols;
+
+        for (int i = range.start; i < range.end; i++)
+        {
+            float *dstRow = dst.ptr<float>(i);
+
+            for (int cn = 0; cn < cnNum; cn++)
+            {
+                float *eta_kCnRow = etak[cn].ptr<float>(i);
+                float *jointCnRow = jointCn[cn].ptr<float>(i);
+
+                if (cn == 0)
+                {
+                    sqr_dif(dstRow, eta_kCnRow, jointCnRow, w);
+                }
+                else
+                {
+                    add_sqr_dif(dstRow, eta_kCnRow, jointCnRow, w);
+                }
+            }
+
+            if (!minDistToManifoldSquared.empty())
+            {
+                float *minDistRow = minDistToManifoldSquared.ptr<float>(i);
+                min_(minDistRow, minDistRow, dstRow, w);
+            }
+
+            mul(dstRow, dstRow, argConst, w);
+        }
+
+        Mat dstRows = dst.rowRange(range);
+        cv::exp(dstRows, dstRows);
+    }
+};
+
+/*Sums of the projections of the masked rows of X, one sum per image row. The row sums are added up afterwards,
+  which doesn't depend on the number of threads, but rounds differently from a single running sum over all pixels*/
+struct EigenVectorSums_ParBody : public ParallelLoopBody
+{
+    const Mat1f &X;
+    const Mat1b &mask;
+    const Mat1f &vec;
+    Mat1f &rowSums;
+
+    EigenVectorSums_ParBody(const Mat1f& X_, const Mat1b& mask_, const Mat1f& vec_, Mat1f& rowSums_)
+        : X(X_), mask(mask_), vec(vec_), rowSums(rowSums_) {}
+
+    void operator () (const Range& range) const
+    {
+        const float* vec_row = vec[0];
+
+        for (int y = range.start; y < range.end; ++y)
+        {
+            const uchar* mask_row = mask[y];
+            float* sum_row = rowSums[y];
+
+            for (int c = 0; c < X.cols; ++c)
+                sum_row[c] = 0.0f;
+
+            for (int x = 0, ind = y*mask.cols; x < mask.cols; ++x, ++ind)
+            {
+                if (mask_row[x])
+                {
+                    const float* X_row = X[ind];
+
+                    float dots = 0.0;
+                    for (int c = 0; c < X.cols; ++c)
+                        dots += vec_row[c] * X_row[c];
+
+                    for (int c = 0; c < X.cols; ++c)
+                        sum_row[c] += dots * X_row[c];
+                }
+            }
+        }
+    }
+};
+
 inline double Log2(double n)
 {
     return log(n) / log(2.0);
@@ -132,15 +361,9 @@ private:
     vector<Mat> jointCn;
     vector<Mat> srcCn;
 
-    vector<Mat> etaFull;
-
     vector<Mat> sum_w_ki_Psi_blur_;
     Mat sum_w_ki_Psi_blur_0_;    
     
-    Mat w_k;
-    Mat Psi_splat_0_small;
-    vector<Mat> Psi_splat_small;
-
     Mat1f minDistToManifoldSquared;
     
     int curTreeHeight;
@@ -148,6 +371,32 @@ private:
 
     RNG rnd;
 
+    /*Initial vectors of the PCA of the inner nodes, indexed by the position of the node in the depth-first order*/
+    Mat1f pcaInitVecs;
+
+    /*Buffers used to process a subtree of manifolds. The sibling subtrees of the top levels are filtered
+      in parallel, each one with its own buffers and sums, which are merged in a fixed order afterwards*/
+    struct ManifoldBuffers
+    {
+        vector<Mat> etaFull;
+        Mat w_k;
+        Mat Psi_splat_0_small;
+        vector<Mat> Psi_splat_small;
+
+        vector<Mat> sum_w_ki_Psi_blur;
+        Mat sum_w_ki_Psi_blur_0;
+        Mat1f minDistToManifoldSquared;
+    };
+
+    vector< Ptr<ManifoldBuffers> > freeBuffers;
+    Mutex freeBuffersLock;
+
+    /*The subtrees are forked down to this tree level (up to 4 concurrent subtrees), deeper ones are traversed
+      serially. The depth is fixed, so the order of the sums and the result don't depend on the number of threads*/
+    enum { PARALLEL_TREE_LEVELS = 2 };
+
+    struct Subtrees_ParBody;
+
 private: /*inline functions*/
 
     double getNormalizer(int depth)
@@ -218,13 +467,24 @@ private:
 
     void initSrcAndJoint(InputArray src_, InputArray joint_);
 
-    void buildManifoldsAndPerformFiltering(vector<Mat>& eta, Mat1b& cluster, int treeLevel);
+    void buildManifoldsAndPerformFiltering(vector<Mat>& eta, Mat1b& cluster, int treeLevel, int nodeId, ManifoldBuffers& buf);
 
     void gatherResult(InputArray src_, OutputArray dst_);
 
-    void compute_w_k(vector<Mat>& etak, Mat& dst, float sigma, int curTreeLevel);
+    void compute_w_k(vector<Mat>& etak, Mat& dst, float sigma, Mat1f& minDist);
 
-    void computeClusters(Mat1b& cluster, Mat1b& cluster_minus, Mat1b& cluster_plus);
+    void computeClusters(Mat1b& cluster, Mat1b& cluster_minus, Mat1b& cluster_plus, vector<Mat>& etaFull, const Mat1f& initVec);
+
+    void generatePCAInitVecs(int nodeId, int treeLevel);
+
+    int getSubtreeSize(int treeLevel)
+    {
+        return (1 << (curTreeHeight - treeLevel + 1)) - 1;
+    }
+
+    Ptr<ManifoldBuffers> acquireBuffers();
+
+    void releaseBuffers(const Ptr<ManifoldBuffers>& buf);
 
     void computeEta(Mat& teta, Mat1b& cluster, vector<Mat>& etaDst);
 
@@ -238,6 +498,24 @@ private:
     static void computeDTVer(vector<Mat>& srcCn, Mat& dst, float ss, float sr);
 };
 
+struct AdaptiveManifoldFilterN::Subtrees_ParBody : public ParallelLoopBody
+{
+    AdaptiveManifoldFilterN &amf;
+    vector<Mat> *eta[2];
+    Mat1b *cluster[2];
+    int nodeId[2];
+    ManifoldBuffers *buf[2];
+    int treeLevel;
+
+    Subtrees_ParBody(AdaptiveManifoldFilterN& amf_, int treeLevel_) : amf(amf_), treeLevel(treeLevel_) {}
+
+    void operator () (const Range& range) const
+    {
+        for (int i = range.start; i < range.end; i++)
+            amf.buildManifoldsAndPerformFiltering(*eta[i], *cluster[i], treeLevel, nodeId[i], *buf[i]);
+    }
+};
+
 CV_INIT_ALGORITHM(AdaptiveManifoldFilterN, "AdaptiveManifoldFilter",
     obj.info()->addParam(obj, "sigma_s", obj.sigma_s_, false, 0, 0, "Filter spatial standard deviation");
     obj.info()->addParam(obj, "sigma_r", obj.sigma_r_, false, 0, 0, "Filter range standard deviation");
@@ -260,14 +538,6 @@ void AdaptiveManifoldFilterN::initBuffers(InputArray src_, InputArray joint_)
 {
     initSrcAndJoint(src_, joint_);
 
-    jointCn.resize(jointCnNum);
-    Psi_splat_small.resize(jointCnNum);
-    for (int i = 0; i < jointCnNum; i++)
-    {
-        //jointCn[i].create(srcSize, CV_32FC1);
-        Psi_splat_small[i].create(smallSize, CV_32FC1);
-    }
-
     srcCn.resize(srcCnNum);
     sum_w_ki_Psi_blur_.resize(srcCnNum);
     for (int i = 0; i < srcCnNum; i++)
@@ -277,11 +547,12 @@ void AdaptiveManifoldFilterN::initBuffers(InputArray src_, InputArray joint_)
     }
 
     sum_w_ki_Psi_blur_0_ = Mat::zeros(srcSize, CV_32FC1);
-    w_k.create(srcSize, CV_32FC1);
-    Psi_splat_0_small.create(smallSize, CV_32FC1);
     
     if (adjust_outliers_)
+    {
         minDistToManifoldSquared.create(srcSize);
+        minDistToManifoldSquared.setTo(numeric_limits<float>::max());
+    }
 }
 
 void AdaptiveManifoldFilterN::initSrcAndJoint(InputArray src_, InputArray joint_)
@@ -290,12 +561,8 @@ void AdaptiveManifoldFilterN::initSrcAndJoint(InputArray src_, InputArray joint_
     smallSize = getSmallSize();
     srcCnNum = src_.channels();
 
+    //the source channels are not converted to float, the arithmetic with them is done with float results
     split(src_, srcCn);
-    if (src_.depth() != CV_32F)
-    {
-        for (int i = 0; i < srcCnNum; i++)
-            srcCn[i].convertTo(srcCn[i], CV_32F);
-    }
 
     if (joint_.empty() || joint_.getObj() == src_.getObj())
     {
@@ -344,17 +611,90 @@ void AdaptiveManifoldFilterN::filter(InputArray src, OutputArray dst, InputArray
     const double seedCoef = jointCn[0].at<float>(srcSize.height/2, srcSize.width/2);
     const uint64 baseCoef = numeric_limits<uint64>::max() / 0xFFFF;
     rnd.state = static_cast<int64>(baseCoef*seedCoef);
+
+    CV_Assert(curTreeHeight < 31);
+    pcaInitVecs.create(getSubtreeSize(1), jointCnNum);
+    generatePCAInitVecs(0, 1);
     
     Mat1b cluster0(srcSize, 0xFF);
     vector<Mat> eta0(jointCnNum);
     for (int i = 0; i < jointCnNum; i++)
         h_filter(jointCn[i], eta0[i], (float)sigma_s_);
 
-    buildManifoldsAndPerformFiltering(eta0, cluster0, 1);
+    ManifoldBuffers rootBuf;
+    rootBuf.sum_w_ki_Psi_blur = sum_w_ki_Psi_blur_;
+    rootBuf.sum_w_ki_Psi_blur_0 = sum_w_ki_Psi_blur_0_;
+    if (adjust_outliers_)
+        rootBuf.minDistToManifoldSquared = minDistToManifoldSquared;
+
+    buildManifoldsAndPerformFiltering(eta0, cluster0, 1, 0, rootBuf);
 
     gatherResult(src, dst);
 }
 
+void AdaptiveManifoldFilterN::generatePCAInitVecs(int nodeId, int treeLevel)
+{
+    //the vectors are drawn in the same order as the serial depth-first traversal would draw them
+    if (treeLevel >= curTreeHeight)
+        return;
+
+    Mat1f initVec = pcaInitVecs.row(nodeId);
+    if (useRNG)
+    {
+        rnd.fill(initVec, RNG::UNIFORM, -0.5, 0.5);
+    }
+    else
+    {
+        for (int i = 0; i < (int)initVec.total(); i++)
+            initVec(0, i) = (i % 2 == 0) ? 0.5f : -0.5f;
+    }
+
+    generatePCAInitVecs(nodeId + 1, treeLevel + 1);
+    generatePCAInitVecs(nodeId + 1 + getSubtreeSize(treeLevel + 1), treeLevel + 1);
+}
+
+Ptr<AdaptiveManifoldFilterN::ManifoldBuffers> AdaptiveManifoldFilterN::acquireBuffers()
+{
+    Ptr<ManifoldBuffers> buf;
+    {
+        AutoLock lock(freeBuffersLock);
+        if (!freeBuffers.empty())
+        {
+            buf = freeBuffers.back();
+            freeBuffers.pop_back();
+        }
+    }
+    if (buf.empty())
+        buf = makePtr<ManifoldBuffers>();
+
+    buf->sum_w_ki_Psi_blur.resize(srcCnNum);
+    for (int i = 0; i < srcCnNum; i++)
+    {
+        buf->sum_w_ki_Psi_blur[i].create(srcSize, CV_32FC1);
+        buf->sum_w_ki_Psi_blur[i].setTo(0.0);
+    }
+    buf->sum_w_ki_Psi_blur_0.create(srcSize, CV_32FC1);
+    buf->sum_w_ki_Psi_blur_0.setTo(0.0);
+
+    if (adjust_outliers_)
+    {
+        buf->minDistToManifoldSquared.create(srcSize);
+        buf->minDistToManifoldSquared.setTo(numeric_limits<float>::max());
+    }
+    else
+    {
+        buf->minDistToManifoldSquared.release();
+    }
+
+    return buf;
+}
+
+void AdaptiveManifoldFilterN::releaseBuffers(const Ptr<ManifoldBuffers>& buf)
+{
+    AutoLock lock(freeBuffersLock);
+    freeBuffers.push_back(buf);
+}
+
 void AdaptiveManifoldFilterN::gatherResult(InputArray src_, OutputArray dst_)
 {
     int dDepth = src_.depth();
@@ -381,9 +721,9 @@ void AdaptiveManifoldFilterN::gatherResult(InputArray src_, OutputArray dst_)
 
             divide(sum_w_ki_Psi_blur_[i], sum_w_ki_Psi_blur_0_, g);
 
-            subtract(g, f, g);
+            subtract(g, f, g, noArray(), CV_32F);
             multiply(alpha, g, g);
-            add(g, f, g);
+            add(g, f, g, noArray(), CV_32F);
 
             g.convertTo(g, dDepth);
         }
@@ -392,32 +732,38 @@ void AdaptiveManifoldFilterN::gatherResult(InputArray src_, OutputArray dst_)
     }
 }
 
-void AdaptiveManifoldFilterN::buildManifoldsAndPerformFiltering(vector<Mat>& eta, Mat1b& cluster, int treeLevel)
+void AdaptiveManifoldFilterN::buildManifoldsAndPerformFiltering(vector<Mat>& eta, Mat1b& cluster, int treeLevel, int nodeId, ManifoldBuffers& buf)
 {
     CV_DbgAssert((int)eta.size() == jointCnNum);
 
+    vector<Mat>& etaFull = buf.etaFull;
+    Mat& w_k = buf.w_k;
+
     //splatting
     Size etaSize = eta[0].size();
     CV_DbgAssert(etaSize == srcSize || etaSize == smallSize);
 
     if (etaSize == srcSize)
     {
-        compute_w_k(eta, w_k, sigma_r_over_sqrt_2, treeLevel);
+        compute_w_k(eta, w_k, sigma_r_over_sqrt_2, buf.minDistToManifoldSquared);
         etaFull = eta;
         downsample(eta, eta);
     }
     else
     {
         upsample(eta, etaFull);
-        compute_w_k(etaFull, w_k, sigma_r_over_sqrt_2, treeLevel);
+        compute_w_k(etaFull, w_k, sigma_r_over_sqrt_2, buf.minDistToManifoldSquared);
     }
-    
+
     //blurring
+    vector<Mat>& Psi_splat_small = buf.Psi_splat_small;
+    Mat& Psi_splat_0_small = buf.Psi_splat_0_small;
+
     Psi_splat_small.resize(srcCnNum);
     for (int si = 0; si < srcCnNum; si++)
     {
         Mat tmp;
-        multiply(srcCn[si], w_k, tmp);
+        multiply(srcCn[si], w_k, tmp, 1.0, CV_32F);
         downsample(tmp, Psi_splat_small[si]);
     }
     downsample(w_k, Psi_splat_0_small);
@@ -436,11 +782,11 @@ void AdaptiveManifoldFilterN::buildManifoldsAndPerformFiltering(vector<Mat>& eta
         {
             upsample(Psi_splat_small_blur[i], tmp);
             multiply(tmp, w_k, tmp);
-            add(sum_w_ki_Psi_blur_[i], tmp, sum_w_ki_Psi_blur_[i]);
+            add(buf.sum_w_ki_Psi_blur[i], tmp, buf.sum_w_ki_Psi_blur[i]);
         }
         upsample(Psi_splat_0_small_blur, tmp);
         multiply(tmp, w_k, tmp);
-        add(sum_w_ki_Psi_blur_0_, tmp, sum_w_ki_Psi_blur_0_);
+        add(buf.sum_w_ki_Psi_blur_0, tmp, buf.sum_w_ki_Psi_blur_0);
     }
 
     //build new manifolds
@@ -448,7 +794,7 @@ void AdaptiveManifoldFilterN::buildManifoldsAndPerformFiltering(vector<Mat>& eta
     {
         Mat1b cluster_minus, cluster_plus;
 
-        computeClusters(cluster, cluster_minus, cluster_plus);
+        computeClusters(cluster, cluster_minus, cluster_plus, etaFull, pcaInitVecs.row(nodeId));
 
         vector<Mat> eta_minus(jointCnNum), eta_plus(jointCnNum);
         {
@@ -461,8 +807,41 @@ void AdaptiveManifoldFilterN::buildManifoldsAndPerformFiltering(vector<Mat>& eta
         eta.clear();
         cluster.release();
 
-        buildManifoldsAndPerformFiltering(eta_minus, cluster_minus, treeLevel + 1);
-        buildManifoldsAndPerformFiltering(eta_plus, cluster_plus, treeLevel + 1);
+        int nodeIdMinus = nodeId + 1;
+        int nodeIdPlus = nodeId + 1 + getSubtreeSize(treeLevel + 1);
+
+        if (treeLevel > PARALLEL_TREE_LEVELS)
+        {
+            //both subtrees add to the sums of this node, as the serial depth-first traversal does
+            buildManifoldsAndPerformFiltering(eta_minus, cluster_minus, treeLevel + 1, nodeIdMinus, buf);
+            buildManifoldsAndPerformFiltering(eta_plus, cluster_plus, treeLevel + 1, nodeIdPlus, buf);
+            return;
+        }
+
+        //the minus subtree continues with the buffers of this node, the plus subtree runs concurrently
+        //with its own ones and its sums are added afterwards
+        Ptr<ManifoldBuffers> plusBuf = acquireBuffers();
+
+        Subtrees_ParBody subtrees(*this, treeLevel + 1);
+        subtrees.eta[0] = &eta_minus;
+        subtrees.cluster[0] = &cluster_minus;
+        subtrees.nodeId[0] = nodeIdMinus;
+        subtrees.buf[0] = &buf;
+        subtrees.eta[1] = &eta_plus;
+        subtrees.cluster[1] = &cluster_plus;
+        subtrees.nodeId[1] = nodeIdPlus;
+        subtrees.buf[1] = plusBuf.get();
+
+        parallel_for_(Range(0, 2), subtrees);
+
+        for (int i = 0; i < srcCnNum; i++)
+            add(buf.sum_w_ki_Psi_blur[i], plusBuf->sum_w_ki_Psi_blur[i], buf.sum_w_ki_Psi_blur[i]);
+        add(buf.sum_w_ki_Psi_blur_0, plusBuf->sum_w_ki_Psi_blur_0, buf.sum_w_ki_Psi_blur_0);
+
+        if (adjust_outliers_)
+            cv::min(buf.minDistToManifoldSquared, plusBuf->minDistToManifoldSquared, buf.minDistToManifoldSquared);
+
+        releaseBuffers(plusBuf);
     }
 }
 
@@ -470,14 +849,12 @@ void AdaptiveManifoldFilterN::collectGarbage()
 {
     srcCn.clear();
     jointCn.clear();
-    etaFull.clear();
     sum_w_ki_Psi_blur_.clear();
-    Psi_splat_small.clear();
+    freeBuffers.clear();
 
     sum_w_ki_Psi_blur_0_.release();
-    w_k.release();
-    Psi_splat_0_small.release();
     minDistToManifoldSquared.release();
+    pcaInitVecs.release();
 }
 
 void AdaptiveManifoldFilterN::h_filter(const Mat1f& src, Mat& dst, float sigma)
@@ -488,88 +865,26 @@ void AdaptiveManifoldFilterN::h_filter(const Mat1f& src, Mat& dst, float sigma)
 
     dst.create(src.size(), CV_32FC1);
 
-    for (int y = 0; y < src.rows; ++y)
-    {
-        const float* src_row = src[y];
-        float* dst_row = dst.ptr<float>(y);
-
-        dst_row[0] = src_row[0];
-        for (int x = 1; x < src.cols; ++x)
-        {
-            dst_row[x] = src_row[x] + a * (dst_row[x - 1] - src_row[x]);
-        }
-        for (int x = src.cols - 2; x >= 0; --x)
-        {
-            dst_row[x] = dst_row[x] + a * (dst_row[x + 1] - dst_row[x]);
-        }
-    }
-
-    for (int y = 1; y < src.rows; ++y)
-    {
-        float* dst_cur_row = dst.ptr<float>(y);
-        float* dst_prev_row = dst.ptr<float>(y-1);
-
-        rf_vert_row_pass(dst_cur_row, dst_prev_row, a, src.cols);
-    }
-    for (int y = src.rows - 2; y >= 0; --y)
-    {
-        float* dst_cur_row = dst.ptr<float>(y);
-        float* dst_prev_row = dst.ptr<float>(y+1);
+    HFilterHor_ParBody horBody(src, dst, a);
+    parallel_for_(Range(0, src.rows), horBody);
 
-        rf_vert_row_pass(dst_cur_row, dst_prev_row, a, src.cols);
-    }
+    HFilterVert_ParBody vertBody(dst, a);
+    parallel_for_(vertBody.getRange(), vertBody);
 }
 
-void AdaptiveManifoldFilterN::compute_w_k(vector<Mat>& etak, Mat& dst, float sigma, int curTreeLevel)
+void AdaptiveManifoldFilterN::compute_w_k(vector<Mat>& etak, Mat& dst, float sigma, Mat1f& minDist)
 {
     CV_DbgAssert((int)etak.size() == jointCnNum);
 
     dst.create(srcSize, CV_32FC1);
     float argConst = -0.5f / (sigma*sigma);
 
-    for (int i = 0; i < srcSize.height; i++)
-    {
-        float *dstRow = dst.ptr<float>(i);
-
-        for (int cn = 0; cn < jointCnNum; cn++)
-        {
-            float *eta_kCnRow = etak[cn].ptr<float>(i);
-            float *jointCnRow = jointCn[cn].ptr<float>(i);
-
-            if (cn == 0)
-            {
-                sqr_dif(dstRow, eta_kCnRow, jointCnRow, srcSize.width);
-            }
-            else
-            {
-                add_sqr_dif(dstRow, eta_kCnRow, jointCnRow, srcSize.width);
-            }
-        }
-
-        if (adjust_outliers_)
-        {
-            float *minDistRow = minDistToManifoldSquared.ptr<float>(i);
-
-            if (curTreeLevel != 1)
-            {
-                min_(minDistRow, minDistRow, dstRow, srcSize.width);
-            }
-            else
-            {
-                std::memcpy(minDistRow, dstRow, srcSize.width*sizeof(float));
-            }
-        }
-
-        mul(dstRow, dstRow, argConst, srcSize.width);
-        //Exp_32f(dstRow, dstRow, srcSize.width);
-    }
-
-    cv::exp(dst, dst);
+    ComputeWk_ParBody body(etak, jointCn, dst, minDist, argConst);
+    parallel_for_(Range(0, srcSize.height), body);
 }
 
 void AdaptiveManifoldFilterN::computeDTHor(vector<Mat>& srcCn, Mat& dst, float sigma_s, float sigma_r)
 {
-    int cnNum = (int)srcCn.size();
     int h = srcCn[0].rows;
     int w = srcCn[0].cols;
 
@@ -578,32 +893,12 @@ void AdaptiveManifoldFilterN::computeDTHor(vector<Mat>& srcCn, Mat& dst, float s
 
     dst.create(h, w-1, CV_32F);
 
-    for (int i = 0; i < h; i++)
-    {
-        float *dstRow = dst.ptr<float>(i);
-
-        for (int cn = 0; cn < cnNum; cn++)
-        {
-            float *curCnRow = srcCn[cn].ptr<float>(i);
-
-            if (cn == 0)
-                sqr_dif(dstRow, curCnRow, curCnRow + 1, w - 1);
-            else
-                add_sqr_dif(dstRow, curCnRow, curCnRow + 1, w - 1);
-        }
-        
-        mad(dstRow, dstRow, sigmaRatioSqr, 1.0f, w - 1);
-        sqrt_(dstRow, dstRow, w - 1);
-        mul(dstRow, dstRow, lnAlpha, w - 1);
-        //Exp_32f(dstRow, dstRow, w - 1);
-    }
-    
-    cv::exp(dst, dst);
+    ComputeDTHor_ParBody body(srcCn, dst, sigmaRatioSqr, lnAlpha);
+    parallel_for_(Range(0, h), body);
 }
 
 void AdaptiveManifoldFilterN::computeDTVer(vector<Mat>& srcCn, Mat& dst, float sigma_s, float sigma_r)
 {
-    int cnNum = (int)srcCn.size();
     int h = srcCn[0].rows;
     int w = srcCn[0].cols;
 
@@ -612,29 +907,8 @@ void AdaptiveManifoldFilterN::computeDTVer(vector<Mat>& srcCn, Mat& dst, float s
     float sigmaRatioSqr = (float) SQR(sigma_s / sigma_r);
     float lnAlpha       = (float) (-sqrt(2.0) / sigma_s);
 
-    for (int i = 0; i < h-1; i++)
-    {
-        float *dstRow = dst.ptr<float>(i);
-
-        for (int cn = 0; cn < cnNum; cn++)
-        {
-            float *srcRow1 = srcCn[cn].ptr<float>(i);
-            float *srcRow2 = srcCn[cn].ptr<float>(i+1);
-
-            if (cn == 0)
-                sqr_dif(dstRow, srcRow1, srcRow2, w);
-            else
-                add_sqr_dif(dstRow, srcRow1, srcRow2, w);
-        }
-
-        mad(dstRow, dstRow, sigmaRatioSqr, 1.0f, w);
-        sqrt_(dstRow, dstRow, w);
-
-        mul(dstRow, dstRow, lnAlpha, w);
-        //Exp_32f(dstRow, dstRow, w);
-    }
-
-    cv::exp(dst, dst);
+    ComputeDTVer_ParBody body(srcCn, dst, sigmaRatioSqr, lnAlpha);
+    parallel_for_(Range(0, h-1), body);
 }
 
 void AdaptiveManifoldFilterN::RFFilterPass(vector<Mat>& joint, vector<Mat>& Psi_splat, Mat& Psi_splat_0, vector<Mat>& Psi_splat_dst, Mat& Psi_splat_0_dst, float ss, float sr)
@@ -658,7 +932,7 @@ void AdaptiveManifoldFilterN::RFFilterPass(vector<Mat>& joint, vector<Mat>& Psi_
     dtf->filter(Psi_splat_0, Psi_splat_0_dst);
 }
 
-void AdaptiveManifoldFilterN::computeClusters(Mat1b& cluster, Mat1b& cluster_minus, Mat1b& cluster_plus)
+void AdaptiveManifoldFilterN::computeClusters(Mat1b& cluster, Mat1b& cluster_minus, Mat1b& cluster_plus, vector<Mat>& etaFull, const Mat1f& initVec)
 {
     Mat difEtaSrc;
     {
@@ -671,17 +945,6 @@ void AdaptiveManifoldFilterN::computeClusters(Mat1b& cluster, Mat1b& cluster_min
         CV_DbgAssert(difEtaSrc.cols == jointCnNum);
     }
 
-    Mat1f initVec(1, jointCnNum);
-    if (useRNG)
-    {
-        rnd.fill(initVec, RNG::UNIFORM, -0.5, 0.5);
-    }
-    else
-    {
-        for (int i = 0; i < (int)initVec.total(); i++)
-            initVec(0, i) = (i % 2 == 0) ? 0.5f : -0.5f;
-    }
-
     Mat1f eigenVec(1, jointCnNum);
     computeEigenVector(difEtaSrc, cluster, eigenVec, num_pca_iterations_, initVec);
 
@@ -730,43 +993,23 @@ void computeEigenVector(const Mat1f& X, const Mat1b& mask, Mat1f& dst, int num_p
     dst.create(rand_vec.size());
     rand_vec.copyTo(dst);
 
-    Mat1f t(X.size());
+    Mat1f rowSums(mask.rows, X.cols);
 
     float* dst_row = dst[0];
 
     for (int i = 0; i < num_pca_iterations; ++i)
     {
-        t.setTo(Scalar::all(0));
-
-        for (int y = 0, ind = 0; y < mask.rows; ++y)
-        {
-            const uchar* mask_row = mask[y];
-
-            for (int x = 0; x < mask.cols; ++x, ++ind)
-            {
-                if (mask_row[x])
-                {
-                    const float* X_row = X[ind];
-                    float* t_row = t[ind];
-
-                    float dots = 0.0;
-                    for (int c = 0; c < X.cols; ++c)
-                        dots += dst_row[c] * X_row[c];
-
-                    for (int c = 0; c < X.cols; ++c)
-                        t_row[c] = dots * X_row[c];
-                }
-            }
-        }
+        EigenVectorSums_ParBody body(X, mask, dst, rowSums);
+        parallel_for_(Range(0, mask.rows), body);
 
         dst.setTo(0.0);
-        for (int k = 0; k < X.rows; ++k)
+        for (int k = 0; k < rowSums.rows; ++k)
         {
-            const float* t_row = t[k];
+            const float* sum_row = rowSums[k];
 
             for (int c = 0; c < X.cols; ++c)
             {
-                dst_row[c] += t_row[c];
+                dst_row[c] += sum_row[c];
             }
         }
     }
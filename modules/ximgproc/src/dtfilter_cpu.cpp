@@ -43,6 +43,7 @@ namespace ximgproc
 {
 
 typedef Vec<uchar, 1> Vec1b;
+typedef Vec<ushort, 1> Vec1w;
 typedef Vec<float, 1> Vec1f;
 
 Ptr<DTFilterCPU> DTFilterCPU::create(InputArray guide, double sigmaSpatial, double sigmaColor, int mode, int numIters)
@@ -83,7 +84,7 @@ void DTFilterCPU::init(InputArray guide_, double sigmaSpatial_, double sigmaColo
     int depth = guide.depth();
 
     CV_Assert(cn <= 4);
-    CV_Assert((depth == CV_8U || depth == CV_32F) && !guide.empty());
+    CV_Assert((depth == CV_8U || depth == CV_16U || depth == CV_32F) && !guide.empty());
 
     #define CREATE_DTF(Vect) init_<Vect>(guide, sigmaSpatial_, sigmaColor_, mode_, numIters_);
 
@@ -91,6 +92,8 @@ void DTFilterCPU::init(InputArray guide_, double sigmaSpatial_, double sigmaColo
     {
         if (depth == CV_8U)
             CREATE_DTF(Vec1b);
+        if (depth == CV_16U)
+            CREATE_DTF(Vec1w);
         if (depth == CV_32F)
             CREATE_DTF(Vec1f);
     }
@@ -98,6 +101,8 @@ void DTFilterCPU::init(InputArray guide_, double sigmaSpatial_, double sigmaColo
     {
         if (depth == CV_8U)
             CREATE_DTF(Vec2b);
+        if (depth == CV_16U)
+            CREATE_DTF(Vec2w);
         if (depth == CV_32F)
             CREATE_DTF(Vec2f);
     }
@@ -105,6 +110,8 @@ void DTFilterCPU::init(InputArray guide_, double sigmaSpatial_, double sigmaColo
     {
         if (depth == CV_8U)
             CREATE_DTF(Vec3b);
+        if (depth == CV_16U)
+            CREATE_DTF(Vec3w);
         if (depth == CV_32F)
             CREATE_DTF(Vec3f);
     }
@@ -112,6 +119,8 @@ void DTFilterCPU::init(InputArray guide_, double sigmaSpatial_, double sigmaColo
     {
         if (depth == CV_8U)
             CREATE_DTF(Vec4b);
+        if (depth == CV_16U)
+            CREATE_DTF(Vec4w);
         if (depth == CV_32F)
             CREATE_DTF(Vec4f);
     }
@@ -128,12 +137,14 @@ void DTFilterCPU::filter(InputArray src_, OutputArray dst_, int dDepth)
     int cn = src.channels();
     int depth = src.depth();
 
-    CV_Assert(cn <= 4 && (depth == CV_8U || depth == CV_32F));
+    CV_Assert(cn <= 4 && (depth == CV_8U || depth == CV_16U || depth == CV_32F));
 
     if (cn == 1)
     {
         if (depth == CV_8U)
             filter_<Vec1b>(src, dst, dDepth);
+        if (depth == CV_16U)
+            filter_<Vec1w>(src, dst, dDepth);
         if (depth == CV_32F)
             filter_<Vec1f>(src, dst, dDepth);
     }
@@ -141,6 +152,8 @@ void DTFilterCPU::filter(InputArray src_, OutputArray dst_, int dDepth)
     {
         if (depth == CV_8U)
             filter_<Vec2b>(src, dst, dDepth);
+        if (depth == CV_16U)
+            filter_<Vec2w>(src, dst, dDepth);
         if (depth == CV_32F)
             filter_<Vec2f>(src, dst, dDepth);
     }
@@ -148,6 +161,8 @@ void DTFilterCPU::filter(InputArray src_, OutputArray dst_, int dDepth)
     {
         if (depth == CV_8U)
             filter_<Vec3b>(src, dst, dDepth);
+        if (depth == CV_16U)
+            filter_<Vec3w>(src, dst, dDepth);
         if (depth == CV_32F)
             filter_<Vec3f>(src, dst, dDepth);
     }
@@ -155,6 +170,8 @@ void DTFilterCPU::filter(InputArray src_, OutputArray dst_, int dDepth)
     {
         if (depth == CV_8U)
             filter_<Vec4b>(src, dst, dDepth);
+        if (depth == CV_16U)
+            filter_<Vec4w>(src, dst, dDepth);
         if (depth == CV_32F)
             filter_<Vec4f>(src, dst, dDepth);
     }
@@ -192,6 +209,19 @@ Mat DTFilterCPU::getWExtendedMat(int h, int w, int type, int brdleft /*= 0*/, in
 }
 
 
+int DTFilterCPU::getVertBlockCols(int rows, int cols, size_t columnElemSize)
+{
+    //the buffers of a strip of columns should stay in L2 cache, but each thread should get a strip
+    const size_t stripBufSize = 256 * 1024;
+    int numThreads = std::max(1, cv::getNumThreads());
+
+    int blockCols = (int)(stripBufSize / std::max<size_t>(1, rows * columnElemSize));
+    blockCols = std::min(blockCols, (cols + numThreads - 1) / numThreads);
+    blockCols = std::max(blockCols, 8);
+
+    return std::min(blockCols, cols);
+}
+
 Range DTFilterCPU::getWorkRangeByThread(const Range& itemsRange, const Range& rangeThread, int declaredNumThreads)
 {
     if (declaredNumThreads <= 0)
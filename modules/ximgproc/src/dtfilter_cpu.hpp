@@ -137,21 +137,49 @@ protected: /*Wrappers for parallelization*/
     template <typename WorkVec>
     struct FilterNC_horPass : public ParallelLoopBody
     {
-        Mat &src, &idist, &dst;
+        Mat &res, &idist;
         float radius;
 
-        FilterNC_horPass(Mat& src_, Mat& idist_, Mat& dst_);
+        FilterNC_horPass(Mat& res_, Mat& idist_);
         void operator() (const Range& range) const;
+        Range getRange() const { return Range(0, res.rows); }
+    };
+
+    /*Processes the image by strips of adjacent columns, without transposition*/
+    template <typename WorkVec>
+    struct FilterNC_vertPass : public ParallelLoopBody
+    {
+        Mat &res, &idist;
+        float radius;
+        int blockCols;
+
+        FilterNC_vertPass(Mat& res_, Mat& idist_);
+        void operator() (const Range& range) const;
+        Range getRange() const { return Range(0, (res.cols + blockCols - 1) / blockCols); }
     };
 
     template <typename WorkVec>
     struct FilterIC_horPass : public ParallelLoopBody
     {
-        Mat &src, &idist, &dist, &dst, isrcBuf;
+        Mat &res, &idist, &dist;
+        float radius;
+
+        FilterIC_horPass(Mat& res_, Mat& idist_, Mat& dist_);
+        void operator() (const Range& range) const;
+        Range getRange() const { return Range(0, res.rows); }
+    };
+
+    /*Processes the image by strips of adjacent columns, without transposition*/
+    template <typename WorkVec>
+    struct FilterIC_vertPass : public ParallelLoopBody
+    {
+        Mat &res, &idist, &dist;
         float radius;
+        int blockCols;
 
-        FilterIC_horPass(Mat& src_, Mat& idist_, Mat& dist_, Mat& dst_);
+        FilterIC_vertPass(Mat& res_, Mat& idist_, Mat& dist_);
         void operator() (const Range& range) const;
+        Range getRange() const { return Range(0, (res.cols + blockCols - 1) / blockCols); }
     };
 
     template <typename WorkVec>
@@ -203,6 +231,31 @@ protected: /*Wrappers for parallelization*/
         Range getRange() { return Range(0, guide.rows); }
     };
 
+    template <typename GuideVec>
+    struct ComputeIDTVert_ParBody: public ParallelLoopBody
+    {
+        DTFilterCPU &dtf;
+        Mat &guide, &dst;
+        int blockCols;
+
+        ComputeIDTVert_ParBody(DTFilterCPU& dtf_, Mat& guide_, Mat& dst_);
+        void operator() (const Range& range) const;
+        Range getRange() { return Range(0, (guide.cols + blockCols - 1) / blockCols); }
+    };
+
+    template <typename GuideVec>
+    struct ComputeDTandIDTVert_ParBody : public ParallelLoopBody
+    {
+        DTFilterCPU &dtf;
+        Mat &guide, &dist, &idist;
+        IDistType maxRadius;
+        int blockCols;
+
+        ComputeDTandIDTVert_ParBody(DTFilterCPU& dtf_, Mat& guide_, Mat& dist_, Mat& idist_);
+        void operator() (const Range& range) const;
+        Range getRange() { return Range(0, (guide.cols + blockCols - 1) / blockCols); }
+    };
+
     template <typename GuideVec>
     struct ComputeA0DTHor_ParBody : public ParallelLoopBody
     {
@@ -234,8 +287,7 @@ protected: /*Auxiliary implementation functions*/
     static Range getWorkRangeByThread(const Range& itemsRange, const Range& rangeThread, int maxThreads = 0);
     static Range getWorkRangeByThread(int items, const Range& rangeThread, int maxThreads = 0);
 
-    template<typename SrcVec>
-    static void prepareSrcImg_IC(const Mat& src, Mat& inner, Mat& outer);
+    static int getVertBlockCols(int rows, int cols, size_t columnElemSize);
 
     static Mat getWExtendedMat(int h, int w, int type, int brdleft = 0, int brdRight = 0, int cacheAlign = 0);
 
@@ -259,6 +311,20 @@ protected: /*Auxiliary implementation functions*/
         return pos;
     }
 
+    inline static int getLeftBound(const IDistType *idist, size_t step, int pos, IDistType searchValue)
+    {
+        while (idist[pos*step] < searchValue)
+            pos++;
+        return pos;
+    }
+
+    inline static int getRightBound(const IDistType *idist, size_t step, int pos, IDistType searchValue)
+    {
+        while (idist[(pos + 1)*step] < searchValue)
+            pos++;
+        return pos;
+    }
+
     template <typename T, typename T1, typename T2, int n>
     inline static T norm1(const cv::Vec<T1, n>& v1, const cv::Vec<T2, n>& v2)
     {
@@ -89,9 +89,8 @@ void DTFilterCPU::init_(Mat& guide, double sigmaSpatial_, double sigmaColor_, in
             parallel_for_(horBody.getRange(), horBody);
         }
         {
-            Mat guideT = guide.t();
-            ComputeIDTHor_ParBody<GuideVec> horBody(*this, guideT, idistVert);
-            parallel_for_(horBody.getRange(), horBody);
+            ComputeIDTVert_ParBody<GuideVec> vertBody(*this, guide, idistVert);
+            parallel_for_(vertBody.getRange(), vertBody);
         }
     }
     else if (mode == DTF_IC)
@@ -101,9 +100,8 @@ void DTFilterCPU::init_(Mat& guide, double sigmaSpatial_, double sigmaColor_, in
             parallel_for_(horBody.getRange(), horBody);
         }
         {
-            Mat guideT = guide.t();
-            ComputeDTandIDTHor_ParBody<GuideVec> horBody(*this, guideT, distVert, idistVert);
-            parallel_for_(horBody.getRange(), horBody);
+            ComputeDTandIDTVert_ParBody<GuideVec> vertBody(*this, guide, distVert, idistVert);
+            parallel_for_(vertBody.getRange(), vertBody);
         }
     }
     else if (mode == DTF_RF)
@@ -138,8 +136,8 @@ void DTFilterCPU::filter_(const Mat& src, Mat& dst, int dDepth)
     Mat res;
     if (dDepth == -1) dDepth = src.depth();
     
-    //small optimization to avoid extra copying of data
-    bool useDstAsRes = (dDepth == WorkVec::depth && (mode == DTF_NC || mode == DTF_RF));
+    //small optimization to avoid extra copying of data, all the passes work in place
+    bool useDstAsRes = (dDepth == WorkVec::depth);
     if (useDstAsRes)
     {
         dst.create(h, w, WorkVec::type);
@@ -148,34 +146,32 @@ void DTFilterCPU::filter_(const Mat& src, Mat& dst, int dDepth)
 
     if (mode == DTF_NC)
     {
-        Mat resT(src.cols, src.rows, WorkVec::type);
         src.convertTo(res, WorkVec::type);
 
-        FilterNC_horPass<WorkVec> horParBody(res, idistHor, resT);
-        FilterNC_horPass<WorkVec> vertParBody(resT, idistVert, res);
+        FilterNC_horPass<WorkVec> horParBody(res, idistHor);
+        FilterNC_vertPass<WorkVec> vertParBody(res, idistVert);
 
         for (int iter = 1; iter <= numIters; iter++)
         {
             horParBody.radius = vertParBody.radius = getIterRadius(iter);
 
-            parallel_for_(Range(0, res.rows), horParBody);
-            parallel_for_(Range(0, resT.rows), vertParBody);
+            parallel_for_(horParBody.getRange(), horParBody);
+            parallel_for_(vertParBody.getRange(), vertParBody);
         }
     }
     else if (mode == DTF_IC)
     {
-        Mat resT;
-        prepareSrcImg_IC<WorkVec>(src, res, resT);
+        src.convertTo(res, WorkVec::type);
 
-        FilterIC_horPass<WorkVec> horParBody(res, idistHor, distHor, resT);
-        FilterIC_horPass<WorkVec> vertParBody(resT, idistVert, distVert, res);
+        FilterIC_horPass<WorkVec> horParBody(res, idistHor, distHor);
+        FilterIC_vertPass<WorkVec> vertParBody(res, idistVert, distVert);
 
         for (int iter = 1; iter <= numIters; iter++)
         {
             horParBody.radius = vertParBody.radius = getIterRadius(iter);
 
-            parallel_for_(Range(0, res.rows), horParBody);
-            parallel_for_(Range(0, resT.rows), vertParBody);
+            parallel_for_(horParBody.getRange(), horParBody);
+            parallel_for_(vertParBody.getRange(), vertParBody);
         }
     }
     else if (mode == DTF_RF)
@@ -234,67 +230,40 @@ void DTFilterCPU::integrateSparseRow(const SrcVec *src, const float *dist, SrcWo
     }
 }
 
-template<typename WorkVec>
-void DTFilterCPU::prepareSrcImg_IC(const Mat& src, Mat& dst, Mat& dstT)
-{
-    Mat dstOut(src.rows, src.cols + 2, WorkVec::type);
-    Mat dstOutT(src.cols, src.rows + 2, WorkVec::type);
-
-    dst = dstOut(Range::all(), Range(1, src.cols+1));
-    dstT = dstOutT(Range::all(), Range(1, src.rows+1));
-
-    src.convertTo(dst, WorkVec::type);
-
-    WorkVec *line;
-    int ri = dstOut.cols - 1;
-    for (int i = 0; i < src.rows; i++)
-    {
-        line        = dstOut.ptr<WorkVec>(i);
-        line[0]     = line[1];
-        line[ri]    = line[ri - 1];
-    }
-
-    WorkVec *topLine = dst.ptr<WorkVec>(0);
-    WorkVec *bottomLine = dst.ptr<WorkVec>(dst.rows - 1);
-    ri = dstOutT.cols - 1;
-    for (int i = 0; i < src.cols; i++)
-    {
-        line        = dstOutT.ptr<WorkVec>(i);
-        line[0]     = topLine[i];
-        line[ri]    = bottomLine[i]; 
-    }
-}
-
-
 template <typename WorkVec>
-DTFilterCPU::FilterNC_horPass<WorkVec>::FilterNC_horPass(Mat& src_, Mat& idist_, Mat& dst_)
-: src(src_), idist(idist_), dst(dst_), radius(1.0f)
+DTFilterCPU::FilterNC_horPass<WorkVec>::FilterNC_horPass(Mat& res_, Mat& idist_)
+: res(res_), idist(idist_), radius(1.0f)
 {
-    CV_DbgAssert(src.type() == WorkVec::type && dst.type() == WorkVec::type && dst.rows == src.cols && dst.cols == src.rows);
+    CV_DbgAssert(res.type() == WorkVec::type && idist.rows == res.rows && idist.cols == res.cols + 1);
 }
 
 template <typename WorkVec>
 void DTFilterCPU::FilterNC_horPass<WorkVec>::operator()(const Range& range) const
 {
     #ifdef NC_USE_INTEGRAL_SRC
-    std::vector<WorkVec> isrcBuf(src.cols + 1);
+    std::vector<WorkVec> isrcBuf(res.cols + 1);
     WorkVec *isrcLine = &isrcBuf[0];
+    #else
+    std::vector<WorkVec> srcBuf(res.cols);
+    const WorkVec *srcLine = &srcBuf[0];
     #endif
 
     for (int i = range.start; i < range.end; i++)
     {
-        const WorkVec   *srcLine    = src.ptr<WorkVec>(i);
+        WorkVec         *dstLine    = res.ptr<WorkVec>(i);
         IDistType       *idistLine  = idist.ptr<IDistType>(i);
         int leftBound = 0, rightBound = 0;
         WorkVec sum;
 
+        //the row is filtered in place, so the source values are kept aside first
         #ifdef NC_USE_INTEGRAL_SRC
-        integrateRow(srcLine, isrcLine, src.cols);
+        integrateRow(dstLine, isrcLine, res.cols);
         #else
+        std::copy(dstLine, dstLine + res.cols, srcBuf.begin());
         sum = srcLine[0];
         #endif
 
-        for (int j = 0; j < src.cols; j++)
+        for (int j = 0; j < res.cols; j++)
         {
             IDistType curVal = idistLine[j];
             #ifdef NC_USE_INTEGRAL_SRC
@@ -315,48 +284,100 @@ void DTFilterCPU::FilterNC_horPass<WorkVec>::operator()(const Range& range) cons
             }
             #endif
 
-            dst.at<WorkVec>(j, i) = sum / (float)(rightBound + 1 - leftBound);
+            dstLine[j] = sum / (float)(rightBound + 1 - leftBound);
         }
     }
 }
 
 template <typename WorkVec>
-DTFilterCPU::FilterIC_horPass<WorkVec>::FilterIC_horPass(Mat& src_, Mat& idist_, Mat& dist_, Mat& dst_)
-: src(src_), idist(idist_), dist(dist_), dst(dst_), radius(1.0f)
+DTFilterCPU::FilterNC_vertPass<WorkVec>::FilterNC_vertPass(Mat& res_, Mat& idist_)
+: res(res_), idist(idist_), radius(1.0f)
 {
-    CV_DbgAssert(src.type() == WorkVec::type && dst.type() == WorkVec::type && dst.rows == src.cols && dst.cols == src.rows);
+    CV_DbgAssert(res.type() == WorkVec::type && idist.rows == res.rows + 1 && idist.cols == res.cols);
+    blockCols = getVertBlockCols(res.rows, res.cols, 2*sizeof(WorkVec) + sizeof(IDistType));
+}
 
-    #ifdef CV_GET_NUM_THREAD_WORKS_PROPERLY
-    isrcBuf.create(cv::getNumThreads(), src.cols + 1, WorkVec::type);
-    #else
-    isrcBuf.create(src.rows, src.cols + 1, WorkVec::type);
-    #endif
+template <typename WorkVec>
+void DTFilterCPU::FilterNC_vertPass<WorkVec>::operator()(const Range& range) const
+{
+    //integrals of the strip columns, stored row by row: isrc[i*blockCols + jj] for column j0 + jj
+    std::vector<WorkVec> isrcBuf((res.rows + 1) * blockCols);
+    std::vector<int> leftBounds(blockCols), rightBounds(blockCols);
+    WorkVec *isrc = &isrcBuf[0];
+    size_t idistStep = idist.step1();
+
+    for (int b = range.start; b < range.end; b++)
+    {
+        int j0 = b * blockCols;
+        int cols = std::min(blockCols, res.cols - j0);
+
+        for (int jj = 0; jj < cols; jj++)
+            isrc[jj] = WorkVec::all(0);
+
+        for (int i = 0; i < res.rows; i++)
+        {
+            const WorkVec *srcRow   = res.ptr<WorkVec>(i) + j0;
+            const WorkVec *prevSum  = isrc + i*blockCols;
+            WorkVec       *curSum   = isrc + (i + 1)*blockCols;
+
+            for (int jj = 0; jj < cols; jj++)
+                curSum[jj] = prevSum[jj] + srcRow[jj];
+        }
+
+        std::fill(leftBounds.begin(), leftBounds.end(), 0);
+        std::fill(rightBounds.begin(), rightBounds.end(), 0);
+        const IDistType *idistCols = idist.ptr<IDistType>(0) + j0;
+
+        for (int i = 0; i < res.rows; i++)
+        {
+            WorkVec *dstRow = res.ptr<WorkVec>(i) + j0;
+
+            for (int jj = 0; jj < cols; jj++)
+            {
+                const IDistType *idistCol = idistCols + jj;
+                IDistType curVal = idistCol[i*idistStep];
+
+                int leftBound  = leftBounds[jj]  = getLeftBound(idistCol, idistStep, leftBounds[jj], curVal - radius);
+                int rightBound = rightBounds[jj] = getRightBound(idistCol, idistStep, rightBounds[jj], curVal + radius);
+                WorkVec sum = (isrc[(rightBound + 1)*blockCols + jj] - isrc[leftBound*blockCols + jj]);
+
+                dstRow[jj] = sum / (float)(rightBound + 1 - leftBound);
+            }
+        }
+    }
+}
+
+template <typename WorkVec>
+DTFilterCPU::FilterIC_horPass<WorkVec>::FilterIC_horPass(Mat& res_, Mat& idist_, Mat& dist_)
+: res(res_), idist(idist_), dist(dist_), radius(1.0f)
+{
+    CV_DbgAssert(res.type() == WorkVec::type && idist.rows == res.rows && idist.cols == res.cols + 1);
 }
 
 template <typename WorkVec>
 void DTFilterCPU::FilterIC_horPass<WorkVec>::operator()(const Range& range) const
 {
-    #ifdef CV_GET_NUM_THREAD_WORKS_PROPERLY
-    WorkVec *isrcLine = const_cast<WorkVec*>( isrcBuf.ptr<WorkVec>(cv::getThreadNum()) );
-    #else
-    WorkVec *isrcLine = const_cast<WorkVec*>( isrcBuf.ptr<WorkVec>(range.start) );
-    #endif
+    //copy of the source row with the replicated border pixels at [-1] and [cols]
+    std::vector<WorkVec> srcBuf(res.cols + 2), isrcBuf(res.cols + 1);
+    WorkVec *srcLine  = &srcBuf[1];
+    WorkVec *isrcLine = &isrcBuf[0];
 
     for (int i = range.start; i < range.end; i++)
     {
-        WorkVec   *srcLine      = src.ptr<WorkVec>(i);
+        WorkVec   *dstLine      = res.ptr<WorkVec>(i);
         DistType  *distLine     = dist.ptr<DistType>(i);
         IDistType *idistLine    = idist.ptr<IDistType>(i);
 
-        integrateSparseRow(srcLine, distLine, isrcLine, src.cols);
+        std::copy(dstLine, dstLine + res.cols, srcLine);
+        srcLine[-1] = srcLine[0];
+        srcLine[res.cols] = srcLine[res.cols - 1];
+
+        integrateSparseRow(srcLine, distLine, isrcLine, res.cols);
 
         int leftBound = 0, rightBound = 0;
         WorkVec sumL, sumR, sumC;
 
-        srcLine[-1] = srcLine[0];
-        srcLine[src.cols] = srcLine[src.cols - 1];
-
-        for (int j = 0; j < src.cols; j++)
+        for (int j = 0; j < res.cols; j++)
         {
             IDistType curVal = idistLine[j];
             IDistType valueLeft = curVal - radius;
@@ -374,7 +395,85 @@ void DTFilterCPU::FilterIC_horPass<WorkVec>::operator()(const Range& range) cons
             sumR = 0.5f*areaR*((2.0f - dr)*srcLine[rightBound] + dr*srcLine[rightBound + 1]);
             sumC = isrcLine[rightBound] - isrcLine[leftBound];
 
-            dst.at<WorkVec>(j, i) = (sumL + sumC + sumR) / (2.0f * radius);
+            dstLine[j] = (sumL + sumC + sumR) / (2.0f * radius);
+        }
+    }
+}
+
+template <typename WorkVec>
+DTFilterCPU::FilterIC_vertPass<WorkVec>::FilterIC_vertPass(Mat& res_, Mat& idist_, Mat& dist_)
+: res(res_), idist(idist_), dist(dist_), radius(1.0f)
+{
+    CV_DbgAssert(res.type() == WorkVec::type && idist.rows == res.rows + 1 && dist.rows == res.rows + 1);
+    blockCols = getVertBlockCols(res.rows, res.cols, 3*sizeof(WorkVec) + sizeof(IDistType) + sizeof(DistType));
+}
+
+template <typename WorkVec>
+void DTFilterCPU::FilterIC_vertPass<WorkVec>::operator()(const Range& range) const
+{
+    //copy of the strip with the replicated rows -1 and res.rows (src row i is stored at i + 1),
+    //and the sparse integrals of its columns
+    std::vector<WorkVec> srcBuf((res.rows + 2) * blockCols), isrcBuf(res.rows * blockCols);
+    std::vector<int> leftBounds(blockCols), rightBounds(blockCols);
+    WorkVec *src  = &srcBuf[0];
+    WorkVec *isrc = &isrcBuf[0];
+    size_t idistStep = idist.step1();
+
+    for (int b = range.start; b < range.end; b++)
+    {
+        int j0 = b * blockCols;
+        int cols = std::min(blockCols, res.cols - j0);
+
+        for (int i = 0; i < res.rows; i++)
+            std::copy(res.ptr<WorkVec>(i) + j0, res.ptr<WorkVec>(i) + j0 + cols, src + (i + 1)*blockCols);
+        std::copy(src + blockCols, src + blockCols + cols, src);
+        std::copy(src + res.rows*blockCols, src + res.rows*blockCols + cols, src + (res.rows + 1)*blockCols);
+
+        for (int jj = 0; jj < cols; jj++)
+            isrc[jj] = WorkVec::all(0);
+
+        for (int i = 0; i < res.rows - 1; i++)
+        {
+            const WorkVec   *srcRow1    = src + (i + 1)*blockCols;
+            const WorkVec   *srcRow2    = src + (i + 2)*blockCols;
+            const DistType  *distRow    = dist.ptr<DistType>(i + 1) + j0;
+            const WorkVec   *prevSum    = isrc + i*blockCols;
+            WorkVec         *curSum     = isrc + (i + 1)*blockCols;
+
+            for (int jj = 0; jj < cols; jj++)
+                curSum[jj] = prevSum[jj] + distRow[jj] * 0.5f * (srcRow1[jj] + srcRow2[jj]);
+        }
+
+        std::fill(leftBounds.begin(), leftBounds.end(), 0);
+        std::fill(rightBounds.begin(), rightBounds.end(), 0);
+        const IDistType *idistCols = idist.ptr<IDistType>(0) + j0;
+
+        for (int i = 0; i < res.rows; i++)
+        {
+            WorkVec *dstRow = res.ptr<WorkVec>(i) + j0;
+
+            for (int jj = 0; jj < cols; jj++)
+            {
+                const IDistType *idistCol = idistCols + jj;
+                IDistType curVal = idistCol[i*idistStep];
+                IDistType valueLeft = curVal - radius;
+                IDistType valueRight = curVal + radius;
+
+                int leftBound  = leftBounds[jj]  = getLeftBound(idistCol, idistStep, leftBounds[jj], valueLeft);
+                int rightBound = rightBounds[jj] = getRightBound(idistCol, idistStep, rightBounds[jj], valueRight);
+
+                //distance and source rows are shifted by one: row k holds the value of position k - 1
+                float areaL = idistCol[leftBound*idistStep] - valueLeft;
+                float areaR = valueRight - idistCol[rightBound*idistStep];
+                float dl = areaL / dist.ptr<DistType>(leftBound)[j0 + jj];
+                float dr = areaR / dist.ptr<DistType>(rightBound + 1)[j0 + jj];
+
+                WorkVec sumL = 0.5f*areaL*(dl*src[leftBound*blockCols + jj] + (2.0f - dl)*src[(leftBound + 1)*blockCols + jj]);
+                WorkVec sumR = 0.5f*areaR*((2.0f - dr)*src[(rightBound + 1)*blockCols + jj] + dr*src[(rightBound + 2)*blockCols + jj]);
+                WorkVec sumC = isrc[rightBound*blockCols + jj] - isrc[leftBound*blockCols + jj];
+
+                dstRow[jj] = (sumL + sumC + sumR) / (2.0f * radius);
+            }
         }
     }
 }
@@ -531,6 +630,89 @@ void DTFilterCPU::ComputeDTandIDTHor_ParBody<GuideVec>::operator()(const Range&
     }
 }
 
+template <typename GuideVec>
+DTFilterCPU::ComputeIDTVert_ParBody<GuideVec>::ComputeIDTVert_ParBody(DTFilterCPU& dtf_, Mat& guide_, Mat& dst_)
+: dtf(dtf_), guide(guide_), dst(dst_)
+{
+    dst.create(guide.rows + 1, guide.cols, IDistVec::type);
+    blockCols = getVertBlockCols(guide.rows, guide.cols, sizeof(GuideVec) + sizeof(IDistType));
+}
+
+template <typename GuideVec>
+void DTFilterCPU::ComputeIDTVert_ParBody<GuideVec>::operator()(const Range& range) const
+{
+    Range rcols(range.start * blockCols, std::min(range.end * blockCols, guide.cols));
+
+    IDistType *firstRow = dst.ptr<IDistType>(0);
+    for (int j = rcols.start; j < rcols.end; j++)
+        firstRow[j] = (IDistType)0;
+
+    for (int i = 1; i < guide.rows; i++)
+    {
+        const GuideVec  *guideRow1  = guide.ptr<GuideVec>(i - 1);
+        const GuideVec  *guideRow2  = guide.ptr<GuideVec>(i);
+        const IDistType *prevRow    = dst.ptr<IDistType>(i - 1);
+              IDistType *curRow     = dst.ptr<IDistType>(i);
+
+        for (int j = rcols.start; j < rcols.end; j++)
+            curRow[j] = prevRow[j] + dtf.getTransformedDistance(guideRow1[j], guideRow2[j]);
+    }
+
+    IDistType *lastRow = dst.ptr<IDistType>(guide.rows);
+    for (int j = rcols.start; j < rcols.end; j++)
+        lastRow[j] = std::numeric_limits<IDistType>::max();
+}
+
+template <typename GuideVec>
+DTFilterCPU::ComputeDTandIDTVert_ParBody<GuideVec>::ComputeDTandIDTVert_ParBody(DTFilterCPU& dtf_, Mat& guide_, Mat& dist_, Mat& idist_)
+: dtf(dtf_), guide(guide_), dist(dist_), idist(idist_)
+{
+    //row k of dist holds the distance between the guide rows k - 1 and k
+    dist.create(guide.rows + 1, guide.cols, DistVec::type);
+    idist.create(guide.rows + 1, guide.cols, IDistVec::type);
+    maxRadius = dtf.getIterRadius(1);
+    blockCols = getVertBlockCols(guide.rows, guide.cols, sizeof(GuideVec) + sizeof(IDistType) + sizeof(DistType));
+}
+
+template <typename GuideVec>
+void DTFilterCPU::ComputeDTandIDTVert_ParBody<GuideVec>::operator()(const Range& range) const
+{
+    Range rcols(range.start * blockCols, std::min(range.end * blockCols, guide.cols));
+
+    DistType  *distRow  = dist.ptr<DistType>(0);
+    IDistType *idistRow = idist.ptr<IDistType>(0);
+    for (int j = rcols.start; j < rcols.end; j++)
+    {
+        distRow[j] = maxRadius;
+        idistRow[j] = (IDistType)0;
+    }
+
+    for (int i = 0; i < guide.rows - 1; i++)
+    {
+        const GuideVec  *guideRow1  = guide.ptr<GuideVec>(i);
+        const GuideVec  *guideRow2  = guide.ptr<GuideVec>(i + 1);
+        const IDistType *prevRow    = idist.ptr<IDistType>(i);
+              IDistType *curRow     = idist.ptr<IDistType>(i + 1);
+        distRow = dist.ptr<DistType>(i + 1);
+
+        for (int j = rcols.start; j < rcols.end; j++)
+        {
+            DistType curDist = (DistType) dtf.getTransformedDistance(guideRow1[j], guideRow2[j]);
+            distRow[j] = curDist;
+            curRow[j] = prevRow[j] + curDist;
+        }
+    }
+
+    distRow = dist.ptr<DistType>(guide.rows);
+    idistRow = idist.ptr<IDistType>(guide.rows);
+    const IDistType *prevRow = idist.ptr<IDistType>(guide.rows - 1);
+    for (int j = rcols.start; j < rcols.end; j++)
+    {
+        distRow[j] = maxRadius;
+        idistRow[j] = prevRow[j] + maxRadius;
+    }
+}
+
 template <typename GuideVec>
 DTFilterCPU::ComputeA0DTHor_ParBody<GuideVec>::ComputeA0DTHor_ParBody(DTFilterCPU& dtf_, Mat& guide_)
 : dtf(dtf_), guide(guide_)
@@ -49,6 +49,11 @@ int getTotalNumberOfChannels(InputArrayOfArrays src);
 
 void checkSameSizeAndDepth(InputArrayOfArrays src, Size &sz, int &depth);
 
+/*Returns false without filtering for guides with more than 3 channels or when the grid would take more than 64 MiB*/
+bool jointBilateralFilterGrid(const Mat& joint, const Mat& src, Mat& dst, double sigmaColor, double sigmaSpace);
+
+void jointBilateralFilterLattice(const Mat& joint, const Mat& src, Mat& dst, double sigmaColor, double sigmaSpace);
+
 namespace intrinsics
 {  
     void add_(register float *dst, register float *src1, int w);
@@ -128,7 +128,7 @@ class GuidedFilterImpl : public GuidedFilter
 {
 public:
     
-    static Ptr<GuidedFilterImpl> create(InputArray guide, int radius, double eps);
+    static Ptr<GuidedFilterImpl> create(InputArray guide, int radius, double eps, int scale = 1);
 
     void filter(InputArray src, OutputArray dst, int dDepth = -1);
 
@@ -138,6 +138,13 @@ protected:
     double eps;
     int h, w;
 
+    /*With subsampling, the coefficients are computed at the reduced size h x w
+      and upsampled to the size of the guide, fullSize*/
+    int scale;
+    Size fullSize;
+    vector<Mat> guideCnFull;
+    vector<Mat> coefs, coefsUp;
+
     vector<Mat> guideCn;
     vector<Mat> guideCnMean;
 
@@ -145,16 +152,17 @@ protected:
 
     int gCnNum;
 
+    /*Buffers of the strip pipeline, one per worker, kept between filter() calls*/
+    vector<Mat> workspaces;
+
 protected:
 
     GuidedFilterImpl() {}
     
-    void init(InputArray guide, int radius, double eps);
+    void init(InputArray guide, int radius, double eps, int scale);
 
     void computeCovGuide(SymArray2D<Mat>& covars);
 
-    void computeCovGuideAndSrc(vector<Mat>& srcCn, vector<Mat>& srcCnMean, vector<vector<Mat> >& cov);
-
     void getWalkPattern(int eid, int &cn1, int &cn2);
 
     inline void meanFilter(Mat& src, Mat& dst)
@@ -167,7 +175,18 @@ protected:
         src.convertTo(dst, CV_32F);
     }
 
-private: /*Routines to parallelize boxFilter and convertTo*/
+    /*Area subsampling keeps the samples centered as the bilinear upsampling expects*/
+    inline void downsample(Mat& src, Mat& dst)
+    {
+        resize(src, dst, Size(w, h), 0, 0, INTER_AREA);
+    }
+
+    inline void upsample(Mat& src, Mat& dst)
+    {
+        resize(src, dst, fullSize, 0, 0, INTER_LINEAR);
+    }
+
+private: /*Routines to parallelize boxFilter, convertTo and resize*/
     
     typedef void (GuidedFilterImpl::*TransformFunc)(Mat& src, Mat& dst);
 
@@ -203,6 +222,20 @@ private: /*Routines to parallelize boxFilter and convertTo*/
         parallel_for_(pb.getRange(), pb);
     }
 
+    template<typename V>
+    void parDownsample(V &src, V &dst)
+    {
+        GFTransform_ParBody pb(*this, src, dst, &GuidedFilterImpl::downsample);
+        parallel_for_(pb.getRange(), pb);
+    }
+
+    template<typename V>
+    void parUpsample(V &src, V &dst)
+    {
+        GFTransform_ParBody pb(*this, src, dst, &GuidedFilterImpl::upsample);
+        parallel_for_(pb.getRange(), pb);
+    }
+
 private: /*Parallel body classes*/
 
     inline void runParBody(const ParallelLoopBody& pb)
@@ -243,63 +276,33 @@ private: /*Parallel body classes*/
     };
 
 
-    struct MulChannelsGuideAndSrc_ParBody : public ParallelLoopBody
+    /*Fused pipeline of filter(): every strip of rows goes through all the stages at once,
+      the intermediate planes of the strip and of its support stay in the worker's buffer*/
+    struct FilterStrips_ParBody : public ParallelLoopBody
     {
         GuidedFilterImpl &gf;
-        vector<vector<Mat> > &cov;
-        vector<Mat> &srcCn;
+        Mat &src, &dst;
+        int stripRows, stripsNum, workersNum;
+        vector<Mat> *coefs; //if not NULL, the mean beta and alpha planes are stored there instead of dst
 
-        MulChannelsGuideAndSrc_ParBody(GuidedFilterImpl& gf_, vector<Mat>& srcCn_, vector<vector<Mat> >& cov_)
-            : gf(gf_), cov(cov_), srcCn(srcCn_) {}
+        FilterStrips_ParBody(GuidedFilterImpl& gf_, Mat& src_, Mat& dst_, int stripRows_, int stripsNum_, int workersNum_,
+                             vector<Mat> *coefs_ = NULL)
+            : gf(gf_), src(src_), dst(dst_), stripRows(stripRows_), stripsNum(stripsNum_), workersNum(workersNum_),
+              coefs(coefs_) {}
 
         void operator () (const Range& range) const;
-    };
-
-    struct ComputeCovFromSrcChannelsMul_ParBody : public ParallelLoopBody
-    {
-        GuidedFilterImpl &gf;
-        vector<vector<Mat> > &cov;
-        vector<Mat> &srcCnMean;
-
-        ComputeCovFromSrcChannelsMul_ParBody(GuidedFilterImpl& gf_, vector<Mat>& srcCnMean_, vector<vector<Mat> >& cov_)
-            : gf(gf_), cov(cov_), srcCnMean(srcCnMean_) {}
 
-        void operator () (const Range& range) const;
+        void filterStrip(Mat& pool, int planeRows, int r0, int r1) const;
     };
 
-    struct ComputeAlpha_ParBody : public ParallelLoopBody
+    /*Applies the upsampled coefficients to the full size guide*/
+    struct ApplyUpsampledTransform_ParBody : public ParallelLoopBody
     {
         GuidedFilterImpl &gf;
-        vector<vector<Mat> > &alpha;
-        vector<vector<Mat> > &covSrc;
+        Mat &dst;
 
-        ComputeAlpha_ParBody(GuidedFilterImpl& gf_, vector<vector<Mat> >& alpha_, vector<vector<Mat> >& covSrc_)
-            : gf(gf_), alpha(alpha_), covSrc(covSrc_) {}
-
-        void operator () (const Range& range) const;
-    };
-
-    struct ComputeBeta_ParBody : public ParallelLoopBody
-    {
-        GuidedFilterImpl &gf;
-        vector<vector<Mat> > &alpha;
-        vector<Mat> &srcCnMean;
-        vector<Mat> &beta;
-
-        ComputeBeta_ParBody(GuidedFilterImpl& gf_, vector<vector<Mat> >& alpha_, vector<Mat>& srcCnMean_, vector<Mat>& beta_)
-            : gf(gf_), alpha(alpha_), srcCnMean(srcCnMean_), beta(beta_) {}
-
-        void operator () (const Range& range) const;
-    };
-
-    struct ApplyTransform_ParBody : public ParallelLoopBody
-    {
-        GuidedFilterImpl &gf;
-        vector<vector<Mat> > &alpha;
-        vector<Mat> &beta;
-
-        ApplyTransform_ParBody(GuidedFilterImpl& gf_, vector<vector<Mat> >& alpha_, vector<Mat>& beta_)
-            : gf(gf_),  alpha(alpha_), beta(beta_) {}
+        ApplyUpsampledTransform_ParBody(GuidedFilterImpl& gf_, Mat& dst_)
+            : gf(gf_), dst(dst_) {}
 
         void operator () (const Range& range) const;
     };
@@ -459,138 +462,6 @@ void GuidedFilterImpl::ComputeCovGuideInv_ParBody::operator()(const Range& range
     }
 }
 
-void GuidedFilterImpl::MulChannelsGuideAndSrc_ParBody::operator()(const Range& range) const
-{
-    int srcCnNum = (int)srcCn.size();
-
-    for (int i = range.start; i < range.end; i++)
-    {
-        for (int si = 0; si < srcCnNum; si++)
-        {
-            int step    = (si % 2) * 2 - 1;
-            int start   = (si % 2) ? 0 : gf.gCnNum - 1;
-            int end     = (si % 2) ? gf.gCnNum : -1;
-
-            float *srcLine = srcCn[si].ptr<float>(i);
-
-            for (int gi = start; gi != end; gi += step)
-            {
-                float *guideLine = gf.guideCn[gi].ptr<float>(i);
-                float *dstLine = cov[si][gi].ptr<float>(i);
-
-                mul(dstLine, srcLine, guideLine, gf.w);
-            }
-        }
-    }
-}
-
-void GuidedFilterImpl::ComputeCovFromSrcChannelsMul_ParBody::operator()(const Range& range) const
-{
-    int srcCnNum = (int)srcCnMean.size();
-
-    for (int i = range.start; i < range.end; i++)
-    {
-        for (int si = 0; si < srcCnNum; si++)
-        {
-            int step    = (si % 2) * 2 - 1;
-            int start   = (si % 2) ? 0 : gf.gCnNum - 1;
-            int end     = (si % 2) ? gf.gCnNum : -1;
-
-            register float *srcMeanLine = srcCnMean[si].ptr<float>(i);
-
-            for (int gi = start; gi != end; gi += step)
-            {
-                float *guideMeanLine = gf.guideCnMean[gi].ptr<float>(i);
-                float *covLine = cov[si][gi].ptr<float>(i);
-
-                sub_mul(covLine, srcMeanLine, guideMeanLine, gf.w);
-            }
-        }
-    }
-}
-
-void GuidedFilterImpl::ComputeAlpha_ParBody::operator()(const Range& range) const
-{
-    int srcCnNum = (int)covSrc.size();
-
-    for (int i = range.start; i < range.end; i++)
-    {
-        for (int si = 0; si < srcCnNum; si++)
-        {
-            for (int gi = 0; gi < gf.gCnNum; gi++)
-            {
-                float *y, *A, *dstAlpha;
-
-                dstAlpha = alpha[si][gi].ptr<float>(i);
-                for (int k = 0; k < gf.gCnNum; k++)
-                {
-                    y = covSrc[si][k].ptr<float>(i);
-                    A = gf.covarsInv(gi, k).ptr<float>(i);
-
-                    if (k == 0)
-                    {
-                        mul(dstAlpha, A, y, gf.w);
-                    }
-                    else
-                    {
-                        add_mul(dstAlpha, A, y, gf.w);
-                    }
-                }
-            }
-        }
-    }
-}
-
-void GuidedFilterImpl::ComputeBeta_ParBody::operator()(const Range& range) const
-{
-    int srcCnNum = (int)srcCnMean.size();
-    CV_DbgAssert(&srcCnMean == &beta);
-
-    for (int i = range.start; i < range.end; i++)
-    {
-        float *_g[4];
-        for (int gi = 0; gi < gf.gCnNum; gi++)
-            _g[gi] = gf.guideCnMean[gi].ptr<float>(i);
-
-        float *betaDst, *g, *a;
-        for (int si = 0; si < srcCnNum; si++)
-        {
-            betaDst = beta[si].ptr<float>(i);
-            for (int gi = 0; gi < gf.gCnNum; gi++)
-            {
-                a = alpha[si][gi].ptr<float>(i);
-                g = _g[gi];
-
-                sub_mul(betaDst, a, g, gf.w);
-            }
-        }
-    }
-}
-
-void GuidedFilterImpl::ApplyTransform_ParBody::operator()(const Range& range) const
-{
-    int srcCnNum = (int)alpha.size();
-
-    for (int i = range.start; i < range.end; i++)
-    {
-        float *_g[4];
-        for (int gi = 0; gi < gf.gCnNum; gi++)
-            _g[gi] = gf.guideCn[gi].ptr<float>(i);
-
-        float *betaDst, *g, *a;
-        for (int si = 0; si < srcCnNum; si++)
-        {
-            betaDst = beta[si].ptr<float>(i);
-            for (int gi = 0; gi < gf.gCnNum; gi++)
-            {
-                a = alpha[si][gi].ptr<float>(i);
-                g = _g[gi];
-
-                add_mul(betaDst, a, g, gf.w);
-            }
-        }
-    }
-}
 
 GuidedFilterImpl::GFTransform_ParBody::GFTransform_ParBody(GuidedFilterImpl& gf_, vector<Mat>& srcv, vector<Mat>& dstv, TransformFunc func_)
     : gf(gf_), func(func_)
@@ -659,28 +530,45 @@ void GuidedFilterImpl::getWalkPattern(int eid, int &cn1, int &cn2)
     cn2 = wdata[6 * 2 * (gCnNum-1) + 6 + eid];
 }
 
-Ptr<GuidedFilterImpl> GuidedFilterImpl::create(InputArray guide, int radius, double eps)
+Ptr<GuidedFilterImpl> GuidedFilterImpl::create(InputArray guide, int radius, double eps, int scale)
 {
     GuidedFilterImpl *gf = new GuidedFilterImpl();
-    gf->init(guide, radius, eps);
+    gf->init(guide, radius, eps, scale);
     return Ptr<GuidedFilterImpl>(gf);
 }
 
-void GuidedFilterImpl::init(InputArray guide, int radius_, double eps_)
+void GuidedFilterImpl::init(InputArray guide, int radius_, double eps_, int scale_)
 {
-    CV_Assert( !guide.empty() && radius_ >= 0 && eps_ >= 0 );
+    CV_Assert( !guide.empty() && radius_ >= 0 && eps_ >= 0 && scale_ >= 1 );
     CV_Assert( (guide.depth() == CV_32F || guide.depth() == CV_8U || guide.depth() == CV_16U) && (guide.channels() <= 3) );
 
     radius = radius_;
     eps = eps_;
+    scale = scale_;
 
     splitFirstNChannels(guide, guideCn, 3);
     gCnNum = (int)guideCn.size();
-    h = guideCn[0].rows;
-    w = guideCn[0].cols;
+    fullSize = guideCn[0].size();
+    h = fullSize.height;
+    w = fullSize.width;
 
-    guideCnMean.resize(gCnNum);
     parConvertToWorkType(guideCn, guideCn);
+
+    if (scale > 1)
+    {
+        //the statistics of the guide and the coefficients are computed on the subsampled images
+        h = std::max(cvRound((double)h / scale), 1);
+        w = std::max(cvRound((double)w / scale), 1);
+        if (radius > 0)
+            radius = std::max(cvRound((double)radius / scale), 1);
+
+        guideCnFull = guideCn;
+        for (int i = 0; i < gCnNum; i++)
+            guideCn[i].release();
+        parDownsample(guideCnFull, guideCn);
+    }
+
+    guideCnMean.resize(gCnNum);
     parMeanFilter(guideCn, guideCnMean);
     
     SymArray2D<Mat> covars;
@@ -702,88 +590,281 @@ void GuidedFilterImpl::computeCovGuide(SymArray2D<Mat>& covars)
     runParBody(ComputeCovGuideFromChannelsMul_ParBody(*this, covars));
 }
 
-void GuidedFilterImpl::filter(InputArray src, OutputArray dst, int dDepth /*= -1*/)
+void GuidedFilterImpl::filter(InputArray src_, OutputArray dst_, int dDepth /*= -1*/)
 {
-    CV_Assert( !src.empty() && (src.depth() == CV_32F || src.depth() == CV_8U) );
-    if (src.rows() != h || src.cols() != w)
+    CV_Assert( !src_.empty() && (src_.depth() == CV_32F || src_.depth() == CV_8U || src_.depth() == CV_16U) );
+    if (src_.rows() != fullSize.height || src_.cols() != fullSize.width)
     {
         CV_Error(Error::StsBadSize, "Size of filtering image must be equal to size of guide image");
         return;
     }
 
-    if (dDepth == -1) dDepth = src.depth();
-    int srcCnNum = src.channels();
+    if (dDepth == -1) dDepth = src_.depth();
+    int srcCnNum = src_.channels();
 
-    vector<Mat> srcCn(srcCnNum);
-    vector<Mat>& srcCnMean = srcCn;
-    split(src, srcCn);
+    Mat src = src_.getMat();
+    dst_.create(fullSize, CV_MAKE_TYPE(dDepth, srcCnNum));
+    Mat dst = dst_.getMat();
 
-    if (src.depth() != CV_32F)
+    if (scale > 1)
+    {
+        Mat srcLow;
+        resize(src, srcLow, Size(w, h), 0, 0, INTER_AREA);
+        src = srcLow;
+    }
+    else if (src.data == dst.data)
     {
-        parConvertToWorkType(srcCn, srcCn);
+        //the strips of dst are written while the following strips still read src
+        src = src.clone();
     }
 
-    vector<vector<Mat> > covSrcGuide(srcCnNum);
-    computeCovGuideAndSrc(srcCn, srcCnMean, covSrcGuide);
+    //the strip support adds 2*radius rows on both sides, so the strips are made several times
+    //higher than that, unless it leaves some threads idle
+    int threadsNum = std::max(getNumThreads(), 1);
+    int stripRows = std::max(4*radius, 64);
+    stripRows = std::min(stripRows, std::max((h + threadsNum - 1) / threadsNum, 16));
 
-    vector<vector<Mat> > alpha(srcCnNum);
+    int stripsNum = (h + stripRows - 1) / stripRows;
+    int workersNum = std::min(threadsNum, stripsNum);
+    workspaces.resize(workersNum);
+
+    if (scale == 1)
+    {
+        FilterStrips_ParBody pb(*this, src, dst, stripRows, stripsNum, workersNum);
+        parallel_for_(Range(0, workersNum), pb, workersNum);
+        return;
+    }
+
+    //fast guided filter: the mean coefficients are upsampled and applied to the full size guide
+    int coefsNum = srcCnNum * (gCnNum + 1);
+    coefs.resize(coefsNum);
+    coefsUp.resize(coefsNum);
+    for (int i = 0; i < coefsNum; i++)
+        coefs[i].create(h, w, CV_32FC1);
+
+    FilterStrips_ParBody pb(*this, src, dst, stripRows, stripsNum, workersNum, &coefs);
+    parallel_for_(Range(0, workersNum), pb, workersNum);
+
+    parUpsample(coefs, coefsUp);
+    parallel_for_(Range(0, fullSize.height), ApplyUpsampledTransform_ParBody(*this, dst));
+}
+
+void GuidedFilterImpl::ApplyUpsampledTransform_ParBody::operator()(const Range& range) const
+{
+    int srcCnNum = dst.channels();
+    int fw = gf.fullSize.width;
+
+    Mat res(1, fw, CV_32FC(srcCnNum));
+    vector<float> line(fw);
+
+    for (int i = range.start; i < range.end; i++)
+    {
+        float *resLine = res.ptr<float>();
+        for (int si = 0; si < srcCnNum; si++)
+        {
+            int ci = si * (gf.gCnNum + 1);
+            float *betaDst = srcCnNum == 1 ? resLine : &line[0];
+
+            memcpy(betaDst, gf.coefsUp[ci].ptr<float>(i), fw*sizeof(float));
+            for (int gi = 0; gi < gf.gCnNum; gi++)
+                add_mul(betaDst, gf.coefsUp[ci + 1 + gi].ptr<float>(i), gf.guideCnFull[gi].ptr<float>(i), fw);
+
+            if (srcCnNum > 1)
+            {
+                for (int j = 0; j < fw; j++)
+                    resLine[j*srcCnNum + si] = betaDst[j];
+            }
+        }
+
+        Mat dstRow = dst.row(i);
+        res.convertTo(dstRow, dst.depth());
+    }
+}
+
+void GuidedFilterImpl::FilterStrips_ParBody::operator()(const Range& range) const
+{
+    int srcCnNum = src.channels();
+    int planesNum = srcCnNum * (2*gf.gCnNum + 1);
+    int planeRows = std::min(stripRows + 4*gf.radius, gf.h);
+
+    for (int k = range.start; k < range.end; k++)
+    {
+        Mat& pool = gf.workspaces[k];
+        pool.create(planesNum*planeRows, gf.w, CV_32FC1);
+
+        int stripStart = k * stripsNum / workersNum;
+        int stripEnd = (k + 1) * stripsNum / workersNum;
+        for (int si = stripStart; si < stripEnd; si++)
+            filterStrip(pool, planeRows, si*stripRows, std::min((si + 1)*stripRows, gf.h));
+    }
+}
+
+void GuidedFilterImpl::FilterStrips_ParBody::filterStrip(Mat& pool, int planeRows, int r0, int r1) const
+{
+    int R = gf.radius, w = gf.w, gCnNum = gf.gCnNum;
+    int srcCnNum = src.channels();
+
+    //alpha and beta are needed for the rows of the strip extended by radius,
+    //and the products of the channels for these rows extended by radius again
+    Range ra(std::max(r0 - R, 0), std::min(r1 + R, gf.h));
+    Range rb(std::max(ra.start - R, 0), std::min(ra.end + R, gf.h));
+    int rowsNum = rb.size();
+
+    //The planes are standalone matrices of the strip support, so that mean filter reflects
+    //at their bounds only where they coincide with the bounds of the image
+    vector<Mat> srcCn(srcCnNum);
+    vector<vector<Mat> > cov(srcCnNum), alpha(srcCnNum);
+    int pi = 0;
+    for (int si = 0; si < srcCnNum; si++)
+        srcCn[si] = Mat(rowsNum, w, CV_32FC1, pool.ptr<float>((pi++)*planeRows));
+    for (int si = 0; si < srcCnNum; si++)
+    {
+        cov[si].resize(gCnNum);
+        for (int gi = 0; gi < gCnNum; gi++)
+            cov[si][gi] = Mat(rowsNum, w, CV_32FC1, pool.ptr<float>((pi++)*planeRows));
+    }
+    float *alphaBase = pool.ptr<float>(pi*planeRows);
     for (int si = 0; si < srcCnNum; si++)
     {
         alpha[si].resize(gCnNum);
         for (int gi = 0; gi < gCnNum; gi++)
-            alpha[si][gi].create(h, w, CV_32FC1);
+            alpha[si][gi] = Mat(rowsNum, w, CV_32FC1, pool.ptr<float>((pi++)*planeRows));
     }
-    runParBody(ComputeAlpha_ParBody(*this, alpha, covSrcGuide));
-    covSrcGuide.clear();
 
-    vector<Mat>& beta = srcCnMean;
-    runParBody(ComputeBeta_ParBody(*this, alpha, srcCnMean, beta));
+    if (srcCnNum == 1)
+    {
+        src.rowRange(rb).convertTo(srcCn[0], CV_32F);
+    }
+    else
+    {
+        //alpha planes are free yet, they hold the interleaved channels
+        Mat srcWork(rowsNum, w, CV_32FC(srcCnNum), alphaBase);
+        src.rowRange(rb).convertTo(srcWork, CV_32F);
+        split(srcWork, srcCn);
+    }
 
-    parMeanFilter(beta, beta);
-    parMeanFilter(alpha, alpha);
+    for (int i = 0; i < rowsNum; i++)
+    {
+        for (int si = 0; si < srcCnNum; si++)
+            for (int gi = 0; gi < gCnNum; gi++)
+                mul(cov[si][gi].ptr<float>(i), srcCn[si].ptr<float>(i), gf.guideCn[gi].ptr<float>(rb.start + i), w);
+    }
 
-    runParBody(ApplyTransform_ParBody(*this, alpha, beta));
-    if (dDepth != CV_32F)
+    Range ia(ra.start - rb.start, ra.end - rb.start);
+    for (int si = 0; si < srcCnNum; si++)
     {
-        for (int i = 0; i < srcCnNum; i++)
-            beta[i].convertTo(beta[i], dDepth);
+        Mat srcMean = srcCn[si].rowRange(ia);
+        gf.meanFilter(srcMean, srcMean);
+        for (int gi = 0; gi < gCnNum; gi++)
+        {
+            Mat covMean = cov[si][gi].rowRange(ia);
+            gf.meanFilter(covMean, covMean);
+        }
     }
-    merge(beta, dst);
-}
 
-void GuidedFilterImpl::computeCovGuideAndSrc(vector<Mat>& srcCn, vector<Mat>& srcCnMean, vector<vector<Mat> >& cov)
-{
-    int srcCnNum = (int)srcCn.size();
+    for (int i = ia.start; i < ia.end; i++)
+    {
+        int gRow = rb.start + i;
+        for (int si = 0; si < srcCnNum; si++)
+        {
+            float *srcMeanLine = srcCn[si].ptr<float>(i);
+
+            for (int gi = 0; gi < gCnNum; gi++)
+                sub_mul(cov[si][gi].ptr<float>(i), srcMeanLine, gf.guideCnMean[gi].ptr<float>(gRow), w);
+
+            for (int gi = 0; gi < gCnNum; gi++)
+            {
+                float *dstAlpha = alpha[si][gi].ptr<float>(i);
+                for (int k = 0; k < gCnNum; k++)
+                {
+                    float *y = cov[si][k].ptr<float>(i);
+                    float *A = gf.covarsInv(gi, k).ptr<float>(gRow);
+
+                    if (k == 0)
+                        mul(dstAlpha, A, y, w);
+                    else
+                        add_mul(dstAlpha, A, y, w);
+                }
+            }
 
-    cov.resize(srcCnNum);
-    for (int i = 0; i < srcCnNum; i++)
+            //beta replaces the mean of the source
+            for (int gi = 0; gi < gCnNum; gi++)
+                sub_mul(srcMeanLine, alpha[si][gi].ptr<float>(i), gf.guideCnMean[gi].ptr<float>(gRow), w);
+        }
+    }
+
+    Range io(r0 - rb.start, r1 - rb.start);
+    for (int si = 0; si < srcCnNum; si++)
     {
-        cov[i].resize(gCnNum);
-        for (int j = 0; j < gCnNum; j++)
-            cov[i][j].create(h, w, CV_32FC1);
+        Mat betaMean = srcCn[si].rowRange(io);
+        gf.meanFilter(betaMean, betaMean);
+        for (int gi = 0; gi < gCnNum; gi++)
+        {
+            Mat alphaMean = alpha[si][gi].rowRange(io);
+            gf.meanFilter(alphaMean, alphaMean);
+        }
     }
 
-    runParBody(MulChannelsGuideAndSrc_ParBody(*this, srcCn, cov));
+    if (coefs)
+    {
+        for (int si = 0; si < srcCnNum; si++)
+        {
+            int ci = si * (gCnNum + 1);
+            Mat coefStrip = (*coefs)[ci].rowRange(r0, r1);
+            srcCn[si].rowRange(io).copyTo(coefStrip);
+            for (int gi = 0; gi < gCnNum; gi++)
+            {
+                coefStrip = (*coefs)[ci + 1 + gi].rowRange(r0, r1);
+                alpha[si][gi].rowRange(io).copyTo(coefStrip);
+            }
+        }
+        return;
+    }
 
-    parMeanFilter(srcCn, srcCnMean);
-    parMeanFilter(cov, cov);
+    vector<Mat> res(srcCnNum);
+    for (int si = 0; si < srcCnNum; si++)
+    {
+        for (int i = io.start; i < io.end; i++)
+        {
+            float *betaDst = srcCn[si].ptr<float>(i);
+            for (int gi = 0; gi < gCnNum; gi++)
+                add_mul(betaDst, alpha[si][gi].ptr<float>(i), gf.guideCn[gi].ptr<float>(rb.start + i), w);
+        }
+        res[si] = srcCn[si].rowRange(io);
+    }
 
-    runParBody(ComputeCovFromSrcChannelsMul_ParBody(*this, srcCnMean, cov));
+    Mat dstStrip = dst.rowRange(r0, r1);
+    if (srcCnNum == 1)
+    {
+        res[0].convertTo(dstStrip, dst.depth());
+    }
+    else if (dst.depth() == CV_32F)
+    {
+        merge(res, dstStrip);
+    }
+    else
+    {
+        //the products are not needed anymore, their planes hold the interleaved result
+        Mat resWork(r1 - r0, w, CV_32FC(srcCnNum), cov[0][0].data);
+        merge(res, resWork);
+        resWork.convertTo(dstStrip, dst.depth());
+    }
 }
 
+
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 
 CV_EXPORTS_W
-Ptr<GuidedFilter> createGuidedFilter(InputArray guide, int radius, double eps)
+Ptr<GuidedFilter> createGuidedFilter(InputArray guide, int radius, double eps, int scale)
 {
-    return Ptr<GuidedFilter>(GuidedFilterImpl::create(guide, radius, eps));
+    return Ptr<GuidedFilter>(GuidedFilterImpl::create(guide, radius, eps, scale));
 }
 
 CV_EXPORTS_W
-void guidedFilter(InputArray guide, InputArray src, OutputArray dst, int radius, double eps, int dDepth)
+void guidedFilter(InputArray guide, InputArray src, OutputArray dst, int radius, double eps, int dDepth, int scale)
 {
-    Ptr<GuidedFilter> gf = createGuidedFilter(guide, radius, eps);
+    Ptr<GuidedFilter> gf = createGuidedFilter(guide, radius, eps, scale);
     gf->filter(src, dst, dDepth);
 }
 
@@ -35,6 +35,7 @@
  */
 
 #include "precomp.hpp"
+#include "edgeaware_filters_common.hpp"
 #include <climits>
 #include <iostream>
 using namespace std;
@@ -50,14 +51,12 @@ namespace ximgproc
 
 typedef Vec<float, 1> Vec1f;
 typedef Vec<uchar, 1> Vec1b;
+typedef Vec<ushort, 1> Vec1w;
 
 #ifndef SQR
 #define SQR(a) ((a)*(a))
 #endif
 
-void jointBilateralFilter_32f(Mat& joint, Mat& src, Mat& dst, int radius, double sigmaColor, double sigmaSpace, int borderType);
-
-void jointBilateralFilter_8u(Mat& joint, Mat& src, Mat& dst, int radius, double sigmaColor, double sigmaSpace, int borderType);
 
 template<typename JointVec, typename SrcVec>
 class JointBilateralFilter_32f : public ParallelLoopBody
@@ -119,91 +118,6 @@ public:
     }
 };
 
-void jointBilateralFilter_32f(Mat& joint, Mat& src, Mat& dst, int radius, double sigmaColor, double sigmaSpace, int borderType)
-{
-    CV_DbgAssert(joint.depth() == CV_32F && src.depth() == CV_32F);
-    
-    int d = 2*radius + 1;
-    int jCn = joint.channels();
-    const int kExpNumBinsPerChannel = 1 << 12;
-    double minValJoint, maxValJoint;
-
-    minMaxLoc(joint, &minValJoint, &maxValJoint);
-    if (abs(maxValJoint - minValJoint) < FLT_EPSILON)
-    {
-        //TODO: make circle pattern instead of square
-        GaussianBlur(src, dst, Size(d, d), sigmaSpace, 0, borderType);
-        return;
-    }
-    float colorRange = (float)(maxValJoint - minValJoint) * jCn;
-    colorRange = std::max(0.01f, colorRange);
-
-    int kExpNumBins = kExpNumBinsPerChannel * jCn;
-    vector<float> expLUTv(kExpNumBins + 2);
-    float *expLUT = &expLUTv[0];
-    float scaleIndex = kExpNumBins/colorRange;
-
-    double gaussColorCoeff = -0.5 / (sigmaColor*sigmaColor);
-    double gaussSpaceCoeff = -0.5 / (sigmaSpace*sigmaSpace);
-
-    for (int i = 0; i < kExpNumBins + 2; i++)
-    {
-        double val = i / scaleIndex;
-        expLUT[i] = (float) std::exp(val * val * gaussColorCoeff);
-    }
-
-    Mat jointTemp, srcTemp;
-    copyMakeBorder(joint, jointTemp, radius, radius, radius, radius, borderType);
-    copyMakeBorder(src, srcTemp, radius, radius, radius, radius, borderType);
-    size_t srcElemStep = srcTemp.step / srcTemp.elemSize();
-    size_t jElemStep = jointTemp.step / jointTemp.elemSize();
-    CV_Assert(srcElemStep == jElemStep);
-
-    vector<float> spaceWeightsv(d*d);
-    vector<int> spaceOfsJointv(d*d);
-    float *spaceWeights = &spaceWeightsv[0];
-    int *spaceOfsJoint = &spaceOfsJointv[0];
-
-    int maxk = 0;
-    for (int i = -radius; i <= radius; i++)
-    {
-        for (int j = -radius; j <= radius; j++)
-        {
-            double r2 = i*i + j*j;
-            if (r2 > SQR(radius))
-                continue;
-
-            spaceWeights[maxk] = (float) std::exp(r2 * gaussSpaceCoeff);
-            spaceOfsJoint[maxk] = (int) (i*jElemStep + j);
-            maxk++;
-        }
-    }
-
-    Range range(0, joint.rows);
-    if (joint.type() == CV_32FC1)
-    {
-        if (src.type() == CV_32FC1)
-        {
-            parallel_for_(range, JointBilateralFilter_32f<Vec1f, Vec1f>(jointTemp, srcTemp, dst, radius, maxk, scaleIndex, spaceOfsJoint, spaceWeights, expLUT));
-        }
-        if (src.type() == CV_32FC3)
-        {
-            parallel_for_(range, JointBilateralFilter_32f<Vec1f, Vec3f>(jointTemp, srcTemp, dst, radius, maxk, scaleIndex, spaceOfsJoint, spaceWeights, expLUT));
-        }
-    }
-
-    if (joint.type() == CV_32FC3)
-    {
-        if (src.type() == CV_32FC1)
-        {
-            parallel_for_(range, JointBilateralFilter_32f<Vec3f, Vec1f>(jointTemp, srcTemp, dst, radius, maxk, scaleIndex, spaceOfsJoint, spaceWeights, expLUT));
-        }
-        if (src.type() == CV_32FC3)
-        {
-            parallel_for_(range, JointBilateralFilter_32f<Vec3f, Vec3f>(jointTemp, srcTemp, dst, radius, maxk, scaleIndex, spaceOfsJoint, spaceWeights, expLUT));
-        }
-    }
-}
 
 template<typename JointVec, typename SrcVec>
 class JointBilateralFilter_8u : public ParallelLoopBody
@@ -265,37 +179,242 @@ public:
     }
 };
 
-void jointBilateralFilter_8u(Mat& joint, Mat& src, Mat& dst, int radius, double sigmaColor, double sigmaSpace, int borderType)
+
+template<int cn>
+static inline float colorWeight(const Vec<uchar, cn>& jointPix0, const uchar *jointPix, const float *expLUT, float /*scaleIndex*/)
 {
-    CV_DbgAssert(joint.depth() == CV_8U && src.depth() == CV_8U);
+    int alpha = 0;
+    for (int c = 0; c < cn; c++)
+        alpha += std::abs((int)jointPix0[c] - (int)jointPix[c]);
+    return expLUT[alpha];
+}
 
-    int d = 2 * radius + 1;
-    int jCn = joint.channels();
+template<int cn>
+static inline float colorWeight(const Vec<ushort, cn>& jointPix0, const ushort *jointPix, const float *expLUT, float scaleIndex)
+{
+    int dist = 0;
+    for (int c = 0; c < cn; c++)
+        dist += std::abs((int)jointPix0[c] - (int)jointPix[c]);
+    float alpha = dist * scaleIndex;
+    int idx = (int)(alpha);
+    alpha -= idx;
+    return expLUT[idx] + alpha*(expLUT[idx + 1] - expLUT[idx]);
+}
+
+template<int cn>
+static inline float colorWeight(const Vec<float, cn>& jointPix0, const float *jointPix, const float *expLUT, float scaleIndex)
+{
+    float alpha = 0.0f;
+    for (int c = 0; c < cn; c++)
+        alpha += std::abs(jointPix0[c] - jointPix[c]);
+    alpha *= scaleIndex;
+    int idx = (int)(alpha);
+    alpha -= idx;
+    return expLUT[idx] + alpha*(expLUT[idx + 1] - expLUT[idx]);
+}
+
+/*Filters several sources with any number of channels at once: the weights of the window
+  are computed once per pixel and applied to every source*/
+template<typename JointVec>
+class JointBilateralFilterShared_ParBody : public ParallelLoopBody
+{
+    typedef typename JointVec::value_type T;
+
+    Mat &joint;
+    vector<Mat> &srcs, &dsts;
+    int radius, maxk, maxCn;
+    float scaleIndex;
+    int *spaceOfs;
+    float *spaceWeights, *expLUT;
+
+public:
+
+    JointBilateralFilterShared_ParBody(Mat& joint_, vector<Mat>& srcs_, vector<Mat>& dsts_, int radius_,
+        int maxk_, float scaleIndex_, int *spaceOfs_, float *spaceWeights_, float *expLUT_)
+        :
+        joint(joint_), srcs(srcs_), dsts(dsts_), radius(radius_), maxk(maxk_),
+        scaleIndex(scaleIndex_), spaceOfs(spaceOfs_), spaceWeights(spaceWeights_), expLUT(expLUT_)
+    {
+        CV_DbgAssert(joint.type() == JointVec::type && srcs.size() == dsts.size());
+
+        maxCn = 1;
+        for (size_t s = 0; s < srcs.size(); s++)
+        {
+            CV_DbgAssert(srcs[s].type() == dsts[s].type() && srcs[s].depth() == DataType<T>::depth);
+            CV_DbgAssert(srcs[s].size() == joint.size() && srcs[s].rows == dsts[s].rows + 2*radius);
+            maxCn = std::max(maxCn, srcs[s].channels());
+        }
+    }
+
+    void operator () (const Range& range) const
+    {
+        vector<float> weightsBuf(maxk), srcSumBuf(maxCn);
+        float *weights = &weightsBuf[0];
+        float *srcSum = &srcSumBuf[0];
+
+        for (int i = radius + range.start; i < radius + range.end; i++)
+        {
+            for (int j = radius; j < joint.cols - radius; j++)
+            {
+                JointVec *jointCenterPixPtr = joint.ptr<JointVec>(i) + j;
+                JointVec jointPix0 = *jointCenterPixPtr;
+                float wSum = 0.0f;
+
+                for (int k = 0; k < maxk; k++)
+                {
+                    T *jointPix = reinterpret_cast<T*>(jointCenterPixPtr + spaceOfs[k]);
+                    weights[k] = spaceWeights[k] * colorWeight(jointPix0, jointPix, expLUT, scaleIndex);
+                    wSum += weights[k];
+                }
+                float wSumInv = 1.0f / wSum;
+
+                for (size_t s = 0; s < srcs.size(); s++)
+                {
+                    int cnNum = srcs[s].channels();
+                    T *srcCenterPixPtr = srcs[s].ptr<T>(i) + j*cnNum;
+
+                    for (int cn = 0; cn < cnNum; cn++)
+                        srcSum[cn] = 0.0f;
+
+                    for (int k = 0; k < maxk; k++)
+                    {
+                        T *srcPix = srcCenterPixPtr + spaceOfs[k]*cnNum;
+                        for (int cn = 0; cn < cnNum; cn++)
+                            srcSum[cn] += weights[k]*srcPix[cn];
+                    }
+
+                    T *dstPix = dsts[s].ptr<T>(i - radius) + (j - radius)*cnNum;
+                    for (int cn = 0; cn < cnNum; cn++)
+                        dstPix[cn] = saturate_cast<T>(srcSum[cn]*wSumInv);
+                }
+            }
+        }
+    }
+};
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+class JointBilateralFilterImpl : public JointBilateralFilter
+{
+public:
+
+    static Ptr<JointBilateralFilterImpl> create(InputArray joint, int d, double sigmaColor, double sigmaSpace, int borderType);
+
+    void filter(InputArray src, OutputArray dst);
+
+    void filterMultiple(InputArrayOfArrays srcs, OutputArrayOfArrays dsts);
+
+protected:
+
+    int radius;
+    double sigmaSpace;
+    int borderType;
+
+    Size sz;
+    int jointType;
+
+    /*Constant 16-bit or floating point guide, the filter degenerates into the gaussian blur*/
+    bool flatJoint;
+
+    /*Guide with the border of radius pixels and the kernel tables computed for it*/
+    Mat jointTemp;
+    int maxk;
+    float scaleIndex;
+    vector<float> expLUT;
+    vector<float> spaceWeights;
+    vector<int> spaceOfs;
+
+protected:
+
+    JointBilateralFilterImpl() {}
+
+    void init(InputArray joint, int d, double sigmaColor, double sigmaSpace, int borderType);
+
+    void makeSrcBorder(const Mat& src, Mat& srcTemp);
+
+    void filterFlat(const Mat& src, OutputArray dst);
+
+    void filterShared(vector<Mat>& srcsTemp, vector<Mat>& dsts);
+};
+
+Ptr<JointBilateralFilterImpl> JointBilateralFilterImpl::create(InputArray joint, int d, double sigmaColor, double sigmaSpace, int borderType)
+{
+    JointBilateralFilterImpl *jbf = new JointBilateralFilterImpl();
+    jbf->init(joint, d, sigmaColor, sigmaSpace, borderType);
+    return Ptr<JointBilateralFilterImpl>(jbf);
+}
+
+void JointBilateralFilterImpl::init(InputArray joint_, int d, double sigmaColor, double sigmaSpace_, int borderType_)
+{
+    Mat joint = joint_.getMat();
+    CV_Assert( !joint.empty() && (joint.depth() == CV_8U || joint.depth() == CV_16U || joint.depth() == CV_32F) );
+    if (joint.channels() != 1 && joint.channels() != 3)
+        CV_Error(Error::BadNumChannels, "Unsupported number of channels");
+
+    if (sigmaColor <= 0)
+        sigmaColor = 1;
+    if (sigmaSpace_ <= 0)
+        sigmaSpace_ = 1;
+
+    if (d <= 0)
+        radius = cvRound(sigmaSpace_*1.5);
+    else
+        radius = d / 2;
+    radius = std::max(radius, 1);
+
+    sigmaSpace = sigmaSpace_;
+    borderType = borderType_;
+    sz = joint.size();
+    jointType = joint.type();
+    flatJoint = false;
+    maxk = 0;
+    scaleIndex = 1.0f;
 
+    int jCn = joint.channels();
     double gaussColorCoeff = -0.5 / (sigmaColor*sigmaColor);
     double gaussSpaceCoeff = -0.5 / (sigmaSpace*sigmaSpace);
 
-    vector<float> expLUTv(jCn*256);
-    float *expLUT = &expLUTv[0];
-
-    for (int i = 0; i < (int)expLUTv.size(); i++)
+    if (joint.depth() == CV_8U)
     {
-        expLUT[i] = (float)std::exp(i * i * gaussColorCoeff);
+        expLUT.resize(jCn*256);
+        for (int i = 0; i < (int)expLUT.size(); i++)
+        {
+            expLUT[i] = (float)std::exp(i * i * gaussColorCoeff);
+        }
+    }
+    else
+    {
+        const int kExpNumBinsPerChannel = 1 << 12;
+        double minValJoint, maxValJoint;
+
+        minMaxLoc(joint, &minValJoint, &maxValJoint);
+        if (abs(maxValJoint - minValJoint) < FLT_EPSILON)
+        {
+            flatJoint = true;
+            return;
+        }
+        float colorRange = (float)(maxValJoint - minValJoint) * jCn;
+        colorRange = std::max(0.01f, colorRange);
+
+        int kExpNumBins = kExpNumBinsPerChannel * jCn;
+        expLUT.resize(kExpNumBins + 2);
+        scaleIndex = kExpNumBins/colorRange;
+
+        for (int i = 0; i < kExpNumBins + 2; i++)
+        {
+            double val = i / scaleIndex;
+            expLUT[i] = (float) std::exp(val * val * gaussColorCoeff);
+        }
     }
 
-    Mat jointTemp, srcTemp;
     copyMakeBorder(joint, jointTemp, radius, radius, radius, radius, borderType);
-    copyMakeBorder(src, srcTemp, radius, radius, radius, radius, borderType);
-    size_t srcElemStep = srcTemp.step / srcTemp.elemSize();
     size_t jElemStep = jointTemp.step / jointTemp.elemSize();
-    CV_Assert(srcElemStep == jElemStep);
 
-    vector<float> spaceWeightsv(d*d);
-    vector<int> spaceOfsJointv(d*d);
-    float *spaceWeights = &spaceWeightsv[0];
-    int *spaceOfsJoint = &spaceOfsJointv[0];
+    int d2 = 2*radius + 1;
+    spaceWeights.resize(d2*d2);
+    spaceOfs.resize(d2*d2);
 
-    int maxk = 0;
     for (int i = -radius; i <= radius; i++)
     {
         for (int j = -radius; j <= radius; j++)
@@ -304,99 +423,213 @@ void jointBilateralFilter_8u(Mat& joint, Mat& src, Mat& dst, int radius, double
             if (r2 > SQR(radius))
                 continue;
 
-            spaceWeights[maxk] = (float)std::exp(r2 * gaussSpaceCoeff);
-            spaceOfsJoint[maxk] = (int)(i*jElemStep + j);
+            spaceWeights[maxk] = (float) std::exp(r2 * gaussSpaceCoeff);
+            spaceOfs[maxk] = (int) (i*jElemStep + j);
             maxk++;
         }
     }
+}
 
-    Range range(0, src.rows);
-    if (joint.type() == CV_8UC1)
+void JointBilateralFilterImpl::makeSrcBorder(const Mat& src, Mat& srcTemp)
+{
+    CV_Assert(src.size() == sz && src.depth() == CV_MAT_DEPTH(jointType));
+
+    copyMakeBorder(src, srcTemp, radius, radius, radius, radius, borderType);
+    size_t srcElemStep = srcTemp.step / srcTemp.elemSize();
+    size_t jElemStep = jointTemp.step / jointTemp.elemSize();
+    CV_Assert(srcElemStep == jElemStep);
+}
+
+void JointBilateralFilterImpl::filterFlat(const Mat& src, OutputArray dst)
+{
+    CV_Assert(src.size() == sz && src.depth() == CV_MAT_DEPTH(jointType));
+
+    //TODO: make circle pattern instead of square
+    int d = 2*radius + 1;
+    GaussianBlur(src, dst, Size(d, d), sigmaSpace, 0, borderType);
+}
+
+void JointBilateralFilterImpl::filter(InputArray src_, OutputArray dst_)
+{
+    Mat src = src_.getMat();
+
+    if (flatJoint)
     {
-        if (src.type() == CV_8UC1)
-        {
-            parallel_for_(range, JointBilateralFilter_8u<Vec1b, Vec1b>(jointTemp, srcTemp, dst, radius, maxk, spaceOfsJoint, spaceWeights, expLUT));
-        }
-        if (src.type() == CV_8UC3)
-        {
-            parallel_for_(range, JointBilateralFilter_8u<Vec1b, Vec3b>(jointTemp, srcTemp, dst, radius, maxk, spaceOfsJoint, spaceWeights, expLUT));
-        }
+        filterFlat(src, dst_);
+        return;
     }
 
-    if (joint.type() == CV_8UC3)
+    //the bordered copy of the source is taken first, so dst may be the same image
+    Mat srcTemp;
+    makeSrcBorder(src, srcTemp);
+
+    dst_.create(sz, src.type());
+    Mat dst = dst_.getMat();
+
+    int srcType = src.type();
+    if (srcType != CV_8UC1 && srcType != CV_8UC3 && srcType != CV_32FC1 && srcType != CV_32FC3)
     {
-        if (src.type() == CV_8UC1)
-        {
-            parallel_for_(range, JointBilateralFilter_8u<Vec3b, Vec1b>(jointTemp, srcTemp, dst, radius, maxk, spaceOfsJoint, spaceWeights, expLUT));
-        }
-        if (src.type() == CV_8UC3)
-        {
-            parallel_for_(range, JointBilateralFilter_8u<Vec3b, Vec3b>(jointTemp, srcTemp, dst, radius, maxk, spaceOfsJoint, spaceWeights, expLUT));
-        }
+        vector<Mat> srcsTemp(1, srcTemp), dsts(1, dst);
+        filterShared(srcsTemp, dsts);
+        return;
+    }
+
+    Range range(0, sz.height);
+    int *pSpaceOfs = &spaceOfs[0];
+    float *pSpaceWeights = &spaceWeights[0];
+    float *pExpLUT = &expLUT[0];
+
+    if (jointType == CV_8UC1)
+    {
+        if (srcType == CV_8UC1)
+            parallel_for_(range, JointBilateralFilter_8u<Vec1b, Vec1b>(jointTemp, srcTemp, dst, radius, maxk, pSpaceOfs, pSpaceWeights, pExpLUT));
+        if (srcType == CV_8UC3)
+            parallel_for_(range, JointBilateralFilter_8u<Vec1b, Vec3b>(jointTemp, srcTemp, dst, radius, maxk, pSpaceOfs, pSpaceWeights, pExpLUT));
+    }
+
+    if (jointType == CV_8UC3)
+    {
+        if (srcType == CV_8UC1)
+            parallel_for_(range, JointBilateralFilter_8u<Vec3b, Vec1b>(jointTemp, srcTemp, dst, radius, maxk, pSpaceOfs, pSpaceWeights, pExpLUT));
+        if (srcType == CV_8UC3)
+            parallel_for_(range, JointBilateralFilter_8u<Vec3b, Vec3b>(jointTemp, srcTemp, dst, radius, maxk, pSpaceOfs, pSpaceWeights, pExpLUT));
+    }
+
+    if (jointType == CV_32FC1)
+    {
+        if (srcType == CV_32FC1)
+            parallel_for_(range, JointBilateralFilter_32f<Vec1f, Vec1f>(jointTemp, srcTemp, dst, radius, maxk, scaleIndex, pSpaceOfs, pSpaceWeights, pExpLUT));
+        if (srcType == CV_32FC3)
+            parallel_for_(range, JointBilateralFilter_32f<Vec1f, Vec3f>(jointTemp, srcTemp, dst, radius, maxk, scaleIndex, pSpaceOfs, pSpaceWeights, pExpLUT));
+    }
+
+    if (jointType == CV_32FC3)
+    {
+        if (srcType == CV_32FC1)
+            parallel_for_(range, JointBilateralFilter_32f<Vec3f, Vec1f>(jointTemp, srcTemp, dst, radius, maxk, scaleIndex, pSpaceOfs, pSpaceWeights, pExpLUT));
+        if (srcType == CV_32FC3)
+            parallel_for_(range, JointBilateralFilter_32f<Vec3f, Vec3f>(jointTemp, srcTemp, dst, radius, maxk, scaleIndex, pSpaceOfs, pSpaceWeights, pExpLUT));
     }
 }
 
-void jointBilateralFilter(InputArray joint_, InputArray src_, OutputArray dst_, int d, double sigmaColor, double sigmaSpace, int borderType)
+void JointBilateralFilterImpl::filterMultiple(InputArrayOfArrays srcs_, OutputArrayOfArrays dsts_)
 {
-    CV_Assert(!src_.empty());
+    CV_Assert(dsts_.kind() == _InputArray::STD_VECTOR_MAT);
+
+    vector<Mat> srcs;
+    srcs_.getMatVector(srcs);
+    CV_Assert(!srcs.empty());
+
+    int srcsNum = (int)srcs.size();
+    vector<Mat> srcsTemp(srcsNum), dsts(srcsNum);
 
-    if (joint_.empty())
+    //bordered copies of all the sources are taken before the outputs are allocated, so they may alias
+    if (!flatJoint)
     {
-        bilateralFilter(src_, dst_, d, sigmaColor, sigmaSpace, borderType);
-        return;
+        for (int s = 0; s < srcsNum; s++)
+            makeSrcBorder(srcs[s], srcsTemp[s]);
     }
 
-    Mat src = src_.getMat();
-    Mat joint = joint_.getMat();
+    dsts_.create(srcsNum, 1, 0);
+    for (int s = 0; s < srcsNum; s++)
+    {
+        dsts_.create(sz, srcs[s].type(), s);
+        dsts[s] = dsts_.getMat(s);
+    }
 
-    if (src.data == joint.data)
+    if (flatJoint)
     {
-        bilateralFilter(src_, dst_, d, sigmaColor, sigmaSpace, borderType);
+        for (int s = 0; s < srcsNum; s++)
+            filterFlat(srcs[s], dsts[s]);
         return;
     }
 
+    filterShared(srcsTemp, dsts);
+}
+
+void JointBilateralFilterImpl::filterShared(vector<Mat>& srcsTemp, vector<Mat>& dsts)
+{
+    Range range(0, sz.height);
+    int *pSpaceOfs = &spaceOfs[0];
+    float *pSpaceWeights = &spaceWeights[0];
+    float *pExpLUT = &expLUT[0];
+
+    if (jointType == CV_8UC1)
+        parallel_for_(range, JointBilateralFilterShared_ParBody<Vec1b>(jointTemp, srcsTemp, dsts, radius, maxk, scaleIndex, pSpaceOfs, pSpaceWeights, pExpLUT));
+    else if (jointType == CV_8UC3)
+        parallel_for_(range, JointBilateralFilterShared_ParBody<Vec3b>(jointTemp, srcsTemp, dsts, radius, maxk, scaleIndex, pSpaceOfs, pSpaceWeights, pExpLUT));
+    else if (jointType == CV_16UC1)
+        parallel_for_(range, JointBilateralFilterShared_ParBody<Vec1w>(jointTemp, srcsTemp, dsts, radius, maxk, scaleIndex, pSpaceOfs, pSpaceWeights, pExpLUT));
+    else if (jointType == CV_16UC3)
+        parallel_for_(range, JointBilateralFilterShared_ParBody<Vec3w>(jointTemp, srcsTemp, dsts, radius, maxk, scaleIndex, pSpaceOfs, pSpaceWeights, pExpLUT));
+    else if (jointType == CV_32FC1)
+        parallel_for_(range, JointBilateralFilterShared_ParBody<Vec1f>(jointTemp, srcsTemp, dsts, radius, maxk, scaleIndex, pSpaceOfs, pSpaceWeights, pExpLUT));
+    else
+        parallel_for_(range, JointBilateralFilterShared_ParBody<Vec3f>(jointTemp, srcsTemp, dsts, radius, maxk, scaleIndex, pSpaceOfs, pSpaceWeights, pExpLUT));
+}
+
+static void jointBilateralFilterFast(InputArray joint_, InputArray src_, OutputArray dst_, double sigmaColor, double sigmaSpace, int engine)
+{
+    Mat src = src_.getMat();
+    Mat joint = joint_.empty() ? src : joint_.getMat();
+
     CV_Assert(src.size() == joint.size());
-    CV_Assert(src.depth() == joint.depth() && (src.depth() == CV_8U || src.depth() == CV_32F) );
+    CV_Assert((src.depth() == CV_8U || src.depth() == CV_16U || src.depth() == CV_32F) &&
+              (joint.depth() == CV_8U || joint.depth() == CV_16U || joint.depth() == CV_32F));
 
     if (sigmaColor <= 0)
         sigmaColor = 1;
     if (sigmaSpace <= 0)
         sigmaSpace = 1;
 
-    int radius;
-    if (d <= 0)
-        radius = cvRound(sigmaSpace*1.5);
-    else
-        radius = d / 2;
-    radius = std::max(radius, 1);
+    Mat jointf, srcf, dstf;
+    joint.convertTo(jointf, CV_32F);
+    src.convertTo(srcf, CV_32F);
 
-    dst_.create(src.size(), src.type());
-    Mat dst = dst_.getMat();
+    //the lattice takes over when the grid would be too large
+    if (engine != JBF_BILATERAL_GRID || !jointBilateralFilterGrid(jointf, srcf, dstf, sigmaColor, sigmaSpace))
+        jointBilateralFilterLattice(jointf, srcf, dstf, sigmaColor, sigmaSpace);
 
-    if (dst.data == joint.data)
-        joint = joint.clone();
-    if (dst.data == src.data)
-        src = src.clone();
+    dstf.convertTo(dst_, src.depth());
+}
 
-    int jointCnNum = joint.channels();
-    int srcCnNum = src.channels();
+void jointBilateralFilter(InputArray joint_, InputArray src_, OutputArray dst_, int d, double sigmaColor, double sigmaSpace, int borderType, int engine)
+{
+    CV_Assert(!src_.empty());
+    CV_Assert(engine == JBF_BRUTE_FORCE || engine == JBF_BILATERAL_GRID || engine == JBF_PERMUTOHEDRAL);
 
-    if ( (srcCnNum == 1 || srcCnNum == 3) && (jointCnNum == 1 || jointCnNum == 3) )
+    if (engine != JBF_BRUTE_FORCE)
     {
-        if (joint.depth() == CV_8U)
-        {
-            jointBilateralFilter_8u(joint, src, dst, radius, sigmaColor, sigmaSpace, borderType);
-        }
-        else
-        {
-            jointBilateralFilter_32f(joint, src, dst, radius, sigmaColor, sigmaSpace, borderType);
-        }
+        jointBilateralFilterFast(joint_, src_, dst_, sigmaColor, sigmaSpace, engine);
+        return;
     }
-    else
+
+    Mat src = src_.getMat();
+    Mat joint = joint_.empty() ? src : joint_.getMat();
+
+    //bilateralFilter has no 16-bit version, such images are their own guide
+    if (src.data == joint.data && src.depth() != CV_16U)
     {
-        CV_Error(Error::BadNumChannels, "Unsupported number of channels");
+        bilateralFilter(src_, dst_, d, sigmaColor, sigmaSpace, borderType);
+        return;
     }
+
+    CV_Assert(src.size() == joint.size());
+    CV_Assert(src.depth() == joint.depth() && (src.depth() == CV_8U || src.depth() == CV_16U || src.depth() == CV_32F) );
+
+    //the guide is copied into the filter, so dst may be the same image as joint or src
+    Ptr<JointBilateralFilter> jbf = createJointBilateralFilter(joint, d, sigmaColor, sigmaSpace, borderType);
+    jbf->filter(src, dst_);
 }
 
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+CV_EXPORTS_W
+Ptr<JointBilateralFilter> createJointBilateralFilter(InputArray joint, int d, double sigmaColor, double sigmaSpace, int borderType)
+{
+    return Ptr<JointBilateralFilter>(JointBilateralFilterImpl::create(joint, d, sigmaColor, sigmaSpace, borderType));
+}
+
+}
 }
-}
\ No newline at end of file
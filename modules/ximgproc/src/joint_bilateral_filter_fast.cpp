@@ -0,0 +1,692 @@
+/*
+ *  By downloading, copying, installing or using the software you agree to this license.
+ *  If you do not agree to this license, do not download, install,
+ *  copy or use the software.
+ *  
+ *  
+ *  License Agreement
+ *  For Open Source Computer Vision Library
+ *  (3 - clause BSD License)
+ *  
+ *  Redistribution and use in source and binary forms, with or without modification,
+ *  are permitted provided that the following conditions are met :
+ *  
+ *  *Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *  
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and / or other materials provided with the distribution.
+ *  
+ *  * Neither the names of the copyright holders nor the names of the contributors
+ *  may be used to endorse or promote products derived from this software
+ *  without specific prior written permission.
+ *  
+ *  This software is provided by the copyright holders and contributors "as is" and
+ *  any express or implied warranties, including, but not limited to, the implied
+ *  warranties of merchantability and fitness for a particular purpose are disclaimed.
+ *  In no event shall copyright holders or contributors be liable for any direct,
+ *  indirect, incidental, special, exemplary, or consequential damages
+ *  (including, but not limited to, procurement of substitute goods or services;
+ *  loss of use, data, or profits; or business interruption) however caused
+ *  and on any theory of liability, whether in contract, strict liability,
+ *  or tort(including negligence or otherwise) arising in any way out of
+ *  the use of this software, even if advised of the possibility of such damage.
+ */
+
+#include "precomp.hpp"
+#include "edgeaware_filters_common.hpp"
+#include <cfloat>
+#include <climits>
+#include <cstring>
+#include <vector>
+using std::vector;
+
+namespace cv
+{
+namespace ximgproc
+{
+
+/*Engines of jointBilateralFilter whose cost doesn't depend on the spatial radius.
+  Both of them filter with gaussian kernels of sigmaSpace in the image plane and of sigmaColor
+  (euclidean distance) in the guide space, the source is normalized by the filtered weights*/
+
+static void getChannelsRange(const Mat& guide, vector<float>& minVal, vector<float>& maxVal)
+{
+    int cn = guide.channels();
+    minVal.assign(cn, FLT_MAX);
+    maxVal.assign(cn, -FLT_MAX);
+
+    for (int i = 0; i < guide.rows; i++)
+    {
+        const float *guideRow = guide.ptr<float>(i);
+        for (int j = 0; j < guide.cols*cn; j += cn)
+        {
+            for (int c = 0; c < cn; c++)
+            {
+                minVal[c] = std::min(minVal[c], guideRow[j + c]);
+                maxVal[c] = std::max(maxVal[c], guideRow[j + c]);
+            }
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//Bilateral grid [Paris and Durand 2006, Chen et al. 2007]
+//////////////////////////////////////////////////////////////////////////
+
+/*Dense grid of (y, x, guide channels) cells, sampled at sigmaSpace and sigmaColor,
+  each cell holds the sum of the splatted source values followed by their count*/
+struct BilateralGridLayout
+{
+    enum { PAD = 2, MAX_DIMS = 5 };
+
+    int ndims, vcn;
+    int dims[MAX_DIMS];
+    size_t steps[MAX_DIMS];
+    float invSpace, invColor;
+    float minVal[MAX_DIMS - 2];
+
+    size_t total() const { return steps[0] * dims[0]; }
+};
+
+class BilateralGridSplat_ParBody : public ParallelLoopBody
+{
+    const BilateralGridLayout &grid;
+    const Mat &guide, &src;
+    float *cells;
+
+public:
+
+    BilateralGridSplat_ParBody(const BilateralGridLayout& grid_, const Mat& guide_, const Mat& src_, float *cells_)
+        : grid(grid_), guide(guide_), src(src_), cells(cells_) {}
+
+    /*range is the range of the grid rows, so the tasks never write to the same cells*/
+    void operator () (const Range& range) const
+    {
+        int gcn = guide.channels(), scn = src.channels();
+
+        for (int i = 0; i < guide.rows; i++)
+        {
+            int gy = cvRound(i * grid.invSpace) + BilateralGridLayout::PAD;
+            if (gy < range.start || gy >= range.end)
+                continue;
+
+            const float *guideRow = guide.ptr<float>(i);
+            const float *srcRow = src.ptr<float>(i);
+
+            for (int j = 0; j < guide.cols; j++, guideRow += gcn, srcRow += scn)
+            {
+                size_t idx = gy*grid.steps[0] + (cvRound(j * grid.invSpace) + BilateralGridLayout::PAD)*grid.steps[1];
+                for (int c = 0; c < gcn; c++)
+                    idx += (cvRound((guideRow[c] - grid.minVal[c]) * grid.invColor) + BilateralGridLayout::PAD)*grid.steps[2 + c];
+
+                float *cell = cells + idx;
+                for (int c = 0; c < scn; c++)
+                    cell[c] += srcRow[c];
+                cell[scn] += 1.0f;
+            }
+        }
+    }
+};
+
+/*Convolution of one axis of the grid with the [1 4 6 4 1]/16 kernel (sigma of one cell)*/
+class BilateralGridBlur_ParBody : public ParallelLoopBody
+{
+    const BilateralGridLayout &grid;
+    float *cells;
+    int n, chunk, numChunks;
+    size_t stride;
+
+public:
+
+    BilateralGridBlur_ParBody(const BilateralGridLayout& grid_, float *cells_, int axis)
+        : grid(grid_), cells(cells_)
+    {
+        n = grid.dims[axis];
+        stride = grid.steps[axis];
+        chunk = (int)std::min<size_t>(stride, 4096);
+        numChunks = (int)((stride + chunk - 1) / chunk);
+    }
+
+    Range getRange() const { return Range(0, (int)(grid.total() / (n*stride)) * numChunks); }
+
+    void operator () (const Range& range) const
+    {
+        //lines of the chunk with two zero lines at both ends
+        vector<float> buf((n + 4) * chunk, 0.0f);
+
+        for (int t = range.start; t < range.end; t++)
+        {
+            int outer = t / numChunks;
+            size_t c0 = (size_t)(t % numChunks) * chunk;
+            int cw = (int)std::min<size_t>(chunk, stride - c0);
+            float *base = cells + (size_t)outer*n*stride + c0;
+
+            for (int k = 0; k < n; k++)
+                std::memcpy(&buf[(k + 2)*chunk], base + k*stride, cw*sizeof(float));
+
+            for (int k = 0; k < n; k++)
+            {
+                const float *r0 = &buf[k*chunk], *r1 = r0 + chunk, *r2 = r1 + chunk, *r3 = r2 + chunk, *r4 = r3 + chunk;
+                float *dstLine = base + k*stride;
+
+                for (int s = 0; s < cw; s++)
+                    dstLine[s] = (r0[s] + r4[s] + 4.0f*(r1[s] + r3[s]) + 6.0f*r2[s]) * (1.0f/16);
+            }
+        }
+    }
+};
+
+class BilateralGridSlice_ParBody : public ParallelLoopBody
+{
+    const BilateralGridLayout &grid;
+    const Mat &guide, &src;
+    Mat &dst;
+    const float *cells;
+
+public:
+
+    BilateralGridSlice_ParBody(const BilateralGridLayout& grid_, const Mat& guide_, const Mat& src_, Mat& dst_, const float *cells_)
+        : grid(grid_), guide(guide_), src(src_), dst(dst_), cells(cells_) {}
+
+    void operator () (const Range& range) const
+    {
+        int gcn = guide.channels(), scn = src.channels();
+        int numCorners = 1 << grid.ndims;
+        int ipos[BilateralGridLayout::MAX_DIMS];
+        float frac[BilateralGridLayout::MAX_DIMS];
+        vector<float> acc(grid.vcn);
+
+        for (int i = range.start; i < range.end; i++)
+        {
+            const float *guideRow = guide.ptr<float>(i);
+            const float *srcRow = src.ptr<float>(i);
+            float *dstRow = dst.ptr<float>(i);
+
+            for (int j = 0; j < guide.cols; j++, guideRow += gcn, srcRow += scn, dstRow += scn)
+            {
+                float pos[BilateralGridLayout::MAX_DIMS];
+                pos[0] = i * grid.invSpace;
+                pos[1] = j * grid.invSpace;
+                for (int c = 0; c < gcn; c++)
+                    pos[2 + c] = (guideRow[c] - grid.minVal[c]) * grid.invColor;
+
+                size_t baseIdx = 0;
+                for (int a = 0; a < grid.ndims; a++)
+                {
+                    ipos[a] = cvFloor(pos[a]);
+                    frac[a] = pos[a] - ipos[a];
+                    baseIdx += (ipos[a] + BilateralGridLayout::PAD) * grid.steps[a];
+                }
+
+                std::fill(acc.begin(), acc.end(), 0.0f);
+                for (int corner = 0; corner < numCorners; corner++)
+                {
+                    size_t idx = baseIdx;
+                    float w = 1.0f;
+                    for (int a = 0; a < grid.ndims; a++)
+                    {
+                        if (corner & (1 << a))
+                        {
+                            idx += grid.steps[a];
+                            w *= frac[a];
+                        }
+                        else
+                        {
+                            w *= 1.0f - frac[a];
+                        }
+                    }
+
+                    const float *cell = cells + idx;
+                    for (int c = 0; c < grid.vcn; c++)
+                        acc[c] += w * cell[c];
+                }
+
+                if (acc[scn] > FLT_EPSILON)
+                {
+                    float norm = 1.0f / acc[scn];
+                    for (int c = 0; c < scn; c++)
+                        dstRow[c] = acc[c] * norm;
+                }
+                else
+                {
+                    for (int c = 0; c < scn; c++)
+                        dstRow[c] = srcRow[c];
+                }
+            }
+        }
+    }
+};
+
+bool jointBilateralFilterGrid(const Mat& joint, const Mat& src, Mat& dst, double sigmaColor, double sigmaSpace)
+{
+    //the grid has no dimensions for the 4th and later guide channels
+    if (joint.channels() > BilateralGridLayout::MAX_DIMS - 2)
+        return false;
+    CV_DbgAssert(joint.depth() == CV_32F && src.depth() == CV_32F && joint.size() == src.size());
+
+    int gcn = joint.channels();
+    vector<float> minVal, maxVal;
+    getChannelsRange(joint, minVal, maxVal);
+
+    BilateralGridLayout grid;
+    grid.ndims = 2 + gcn;
+    grid.vcn = src.channels() + 1;
+    grid.invSpace = (float)(1.0 / sigmaSpace);
+    grid.invColor = (float)(1.0 / sigmaColor);
+
+    //two extra cells for rounding and interpolation, and the zero padding of the blur kernel,
+    //the extents are checked in double as they overflow int for a tiny sigmaColor
+    const double extra = 2 + 2*BilateralGridLayout::PAD;
+    const double maxCells = (double)(1 << 24);
+    double extents[BilateralGridLayout::MAX_DIMS];
+    extents[0] = std::floor((joint.rows - 1) * grid.invSpace) + extra;
+    extents[1] = std::floor((joint.cols - 1) * grid.invSpace) + extra;
+    for (int c = 0; c < gcn; c++)
+        extents[2 + c] = std::floor((maxVal[c] - minVal[c]) * grid.invColor) + extra;
+
+    double cellCount = grid.vcn;
+    for (int a = 0; a < grid.ndims; a++)
+        cellCount *= extents[a];
+    if (cellCount > maxCells)
+        return false;
+
+    for (int a = 0; a < grid.ndims; a++)
+        grid.dims[a] = (int)extents[a];
+    for (int c = 0; c < gcn; c++)
+        grid.minVal[c] = minVal[c];
+
+    grid.steps[grid.ndims - 1] = grid.vcn;
+    for (int a = grid.ndims - 2; a >= 0; a--)
+        grid.steps[a] = grid.steps[a + 1] * grid.dims[a + 1];
+
+    vector<float> cells(grid.total(), 0.0f);
+
+    parallel_for_(Range(0, grid.dims[0]), BilateralGridSplat_ParBody(grid, joint, src, &cells[0]));
+
+    for (int a = 0; a < grid.ndims; a++)
+    {
+        BilateralGridBlur_ParBody blurBody(grid, &cells[0], a);
+        parallel_for_(blurBody.getRange(), blurBody);
+    }
+
+    dst.create(src.size(), src.type());
+    parallel_for_(Range(0, src.rows), BilateralGridSlice_ParBody(grid, joint, src, dst, &cells[0]));
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//Permutohedral lattice [Adams et al. 2010]
+//////////////////////////////////////////////////////////////////////////
+
+/*Sparse lattice of dimension d, the vertices are stored in a hash table by their first d coordinates*/
+class PermutohedralLattice
+{
+public:
+
+    PermutohedralLattice(int d_, int vd_, int expectedVertices) : d(d_), vd(vd_), numVertices(0)
+    {
+        size_t capacity = 1 << 15;
+        while (capacity < 2*(size_t)expectedVertices)
+            capacity <<= 1;
+        table.assign(capacity, -1);
+    }
+
+    int getNumVertices() const { return numVertices; }
+
+    const int* getKey(int vertex) const { return &keys[(size_t)vertex*d]; }
+
+    float* getValues() { return &values[0]; }
+
+    int find(const int *key) const
+    {
+        size_t mask = table.size() - 1;
+        for (size_t h = hash(key) & mask; ; h = (h + 1) & mask)
+        {
+            int vertex = table[h];
+            if (vertex < 0 || std::equal(key, key + d, &keys[(size_t)vertex*d]))
+                return vertex;
+        }
+    }
+
+    int insert(const int *key)
+    {
+        size_t mask = table.size() - 1;
+        size_t h = hash(key) & mask;
+        for (; table[h] >= 0; h = (h + 1) & mask)
+        {
+            if (std::equal(key, key + d, &keys[(size_t)table[h]*d]))
+                return table[h];
+        }
+
+        int vertex = numVertices++;
+        table[h] = vertex;
+        keys.insert(keys.end(), key, key + d);
+        values.resize((size_t)numVertices*vd, 0.0f);
+
+        if (2*(size_t)numVertices > table.size())
+            grow();
+
+        return vertex;
+    }
+
+private:
+
+    int d, vd, numVertices;
+    vector<int> table, keys;
+    vector<float> values;
+
+    size_t hash(const int *key) const
+    {
+        size_t k = 0;
+        for (int i = 0; i < d; i++)
+        {
+            k += (size_t)key[i];
+            k *= 2531011;
+        }
+        return k;
+    }
+
+    void grow()
+    {
+        table.assign(table.size() * 2, -1);
+        size_t mask = table.size() - 1;
+        for (int vertex = 0; vertex < numVertices; vertex++)
+        {
+            size_t h = hash(&keys[(size_t)vertex*d]) & mask;
+            while (table[h] >= 0)
+                h = (h + 1) & mask;
+            table[h] = vertex;
+        }
+    }
+};
+
+/*Embedding of the pixel features into the lattice: vertices of the enclosing simplex and barycentric weights*/
+class PermutohedralEmbedding
+{
+public:
+
+    explicit PermutohedralEmbedding(int d_) : d(d_)
+    {
+        scaleFactor.resize(d);
+        //the lattice blur is a gaussian of unit standard deviation in the feature space
+        float invStdDev = std::sqrt(2.0f / 3.0f) * (d + 1);
+        for (int i = 0; i < d; i++)
+            scaleFactor[i] = invStdDev / std::sqrt((float)(i + 1)*(i + 2));
+
+        canonical.resize((d + 1)*(d + 1));
+        for (int i = 0; i <= d; i++)
+        {
+            for (int j = 0; j <= d - i; j++)
+                canonical[i*(d + 1) + j] = i;
+            for (int j = d - i + 1; j <= d; j++)
+                canonical[i*(d + 1) + j] = i - (d + 1);
+        }
+
+        elevated.resize(d + 1);
+        greedy.resize(d + 1);
+        rank.resize(d + 1);
+        barycentric.resize(d + 2);
+    }
+
+    /*keys: (d+1) x d coordinates of the simplex vertices, weights: (d+1) barycentric weights*/
+    void embed(const float *position, int *keys, float *weights)
+    {
+        elevated[d] = -d * position[d - 1] * scaleFactor[d - 1];
+        for (int i = d - 1; i > 0; i--)
+            elevated[i] = elevated[i + 1] - i * position[i - 1] * scaleFactor[i - 1] + (i + 2) * position[i] * scaleFactor[i];
+        elevated[0] = elevated[1] + 2 * position[0] * scaleFactor[0];
+
+        //closest remainder-0 point
+        float scale = 1.0f / (d + 1);
+        int sum = 0;
+        for (int i = 0; i <= d; i++)
+        {
+            float v = elevated[i] * scale;
+            float up = std::ceil(v) * (d + 1);
+            float down = std::floor(v) * (d + 1);
+            greedy[i] = (int)((up - elevated[i] < elevated[i] - down) ? up : down);
+            sum += greedy[i];
+        }
+        sum /= d + 1;
+
+        //permutation between the enclosing simplex and the canonical one
+        std::fill(rank.begin(), rank.end(), 0);
+        for (int i = 0; i < d; i++)
+        {
+            for (int j = i + 1; j <= d; j++)
+            {
+                if (elevated[i] - greedy[i] < elevated[j] - greedy[j])
+                    rank[i]++;
+                else
+                    rank[j]++;
+            }
+        }
+
+        if (sum > 0)
+        {
+            for (int i = 0; i <= d; i++)
+            {
+                if (rank[i] >= d + 1 - sum)
+                {
+                    greedy[i] -= d + 1;
+                    rank[i] += sum - (d + 1);
+                }
+                else
+                    rank[i] += sum;
+            }
+        }
+        else if (sum < 0)
+        {
+            for (int i = 0; i <= d; i++)
+            {
+                if (rank[i] < -sum)
+                {
+                    greedy[i] += d + 1;
+                    rank[i] += (d + 1) + sum;
+                }
+                else
+                    rank[i] += sum;
+            }
+        }
+
+        std::fill(barycentric.begin(), barycentric.end(), 0.0f);
+        for (int i = 0; i <= d; i++)
+        {
+            float delta = (elevated[i] - greedy[i]) * scale;
+            barycentric[d - rank[i]] += delta;
+            barycentric[d + 1 - rank[i]] -= delta;
+        }
+        barycentric[0] += 1.0f + barycentric[d + 1];
+
+        for (int remainder = 0; remainder <= d; remainder++)
+        {
+            int *key = keys + remainder*d;
+            for (int i = 0; i < d; i++)
+                key[i] = greedy[i] + canonical[remainder*(d + 1) + rank[i]];
+            weights[remainder] = barycentric[remainder];
+        }
+    }
+
+private:
+
+    int d;
+    vector<float> scaleFactor, elevated, barycentric;
+    vector<int> canonical, greedy, rank;
+};
+
+static inline void getLatticePosition(const float *guidePix, int gcn, int i, int j, float invSpace, float invColor, float *position)
+{
+    position[0] = j * invSpace;
+    position[1] = i * invSpace;
+    for (int c = 0; c < gcn; c++)
+        position[2 + c] = guidePix[c] * invColor;
+}
+
+/*Blur of the lattice along one of its d+1 axes with the [1 2 1]/4 kernel*/
+class PermutohedralBlur_ParBody : public ParallelLoopBody
+{
+    const PermutohedralLattice &lattice;
+    const float *src;
+    float *dst;
+    int d, vd, axis;
+
+public:
+
+    PermutohedralBlur_ParBody(const PermutohedralLattice& lattice_, const float *src_, float *dst_, int d_, int vd_, int axis_)
+        : lattice(lattice_), src(src_), dst(dst_), d(d_), vd(vd_), axis(axis_) {}
+
+    void operator () (const Range& range) const
+    {
+        vector<int> n1(d + 1), n2(d + 1);
+
+        for (int vertex = range.start; vertex < range.end; vertex++)
+        {
+            const int *key = lattice.getKey(vertex);
+            for (int k = 0; k < d; k++)
+            {
+                n1[k] = key[k] + 1;
+                n2[k] = key[k] - 1;
+            }
+            if (axis < d)
+            {
+                n1[axis] = key[axis] - d;
+                n2[axis] = key[axis] + d;
+            }
+
+            int v1 = lattice.find(&n1[0]);
+            int v2 = lattice.find(&n2[0]);
+
+            const float *val = src + (size_t)vertex*vd;
+            float *dstVal = dst + (size_t)vertex*vd;
+            for (int c = 0; c < vd; c++)
+                dstVal[c] = 0.5f * val[c];
+            if (v1 >= 0)
+            {
+                const float *val1 = src + (size_t)v1*vd;
+                for (int c = 0; c < vd; c++)
+                    dstVal[c] += 0.25f * val1[c];
+            }
+            if (v2 >= 0)
+            {
+                const float *val2 = src + (size_t)v2*vd;
+                for (int c = 0; c < vd; c++)
+                    dstVal[c] += 0.25f * val2[c];
+            }
+        }
+    }
+};
+
+class PermutohedralSlice_ParBody : public ParallelLoopBody
+{
+    const Mat &src;
+    Mat &dst;
+    const int *vertices;
+    const float *weights, *values;
+    int d, vd;
+
+public:
+
+    PermutohedralSlice_ParBody(const Mat& src_, Mat& dst_, const int *vertices_, const float *weights_, const float *values_, int d_, int vd_)
+        : src(src_), dst(dst_), vertices(vertices_), weights(weights_), values(values_), d(d_), vd(vd_) {}
+
+    void operator () (const Range& range) const
+    {
+        int scn = src.channels();
+        vector<float> acc(vd);
+
+        for (int i = range.start; i < range.end; i++)
+        {
+            const float *srcRow = src.ptr<float>(i);
+            float *dstRow = dst.ptr<float>(i);
+            size_t pix = (size_t)i*src.cols*(d + 1);
+
+            for (int j = 0; j < src.cols; j++, pix += d + 1)
+            {
+                std::fill(acc.begin(), acc.end(), 0.0f);
+                for (int r = 0; r <= d; r++)
+                {
+                    const float *val = values + (size_t)vertices[pix + r]*vd;
+                    for (int c = 0; c < vd; c++)
+                        acc[c] += weights[pix + r] * val[c];
+                }
+
+                if (acc[scn] > FLT_EPSILON)
+                {
+                    float norm = 1.0f / acc[scn];
+                    for (int c = 0; c < scn; c++)
+                        dstRow[j*scn + c] = acc[c] * norm;
+                }
+                else
+                {
+                    for (int c = 0; c < scn; c++)
+                        dstRow[j*scn + c] = srcRow[j*scn + c];
+                }
+            }
+        }
+    }
+};
+
+void jointBilateralFilterLattice(const Mat& joint, const Mat& src, Mat& dst, double sigmaColor, double sigmaSpace)
+{
+    CV_DbgAssert(joint.depth() == CV_32F && src.depth() == CV_32F && joint.size() == src.size());
+
+    int gcn = joint.channels(), scn = src.channels();
+    int d = 2 + gcn, vd = scn + 1;
+    float invSpace = (float)(1.0 / sigmaSpace);
+    float invColor = (float)(1.0 / sigmaColor);
+    size_t numPixels = src.total();
+
+    PermutohedralLattice lattice(d, vd, (int)std::min<size_t>(numPixels / 8, INT_MAX / 4));
+    PermutohedralEmbedding embedding(d);
+
+    //vertices and weights of every pixel are kept for the slicing
+    vector<int> pixVertices(numPixels*(d + 1));
+    vector<float> pixWeights(numPixels*(d + 1));
+    vector<float> position(d), value(vd);
+    vector<int> keys((d + 1)*d);
+
+    value[scn] = 1.0f;
+    for (int i = 0, pix = 0; i < src.rows; i++)
+    {
+        const float *guideRow = joint.ptr<float>(i);
+        const float *srcRow = src.ptr<float>(i);
+
+        for (int j = 0; j < src.cols; j++, pix++)
+        {
+            getLatticePosition(guideRow + j*gcn, gcn, i, j, invSpace, invColor, &position[0]);
+            embedding.embed(&position[0], &keys[0], &pixWeights[(size_t)pix*(d + 1)]);
+
+            for (int c = 0; c < scn; c++)
+                value[c] = srcRow[j*scn + c];
+
+            for (int r = 0; r <= d; r++)
+            {
+                int vertex = lattice.insert(&keys[r*d]);
+                float w = pixWeights[(size_t)pix*(d + 1) + r];
+                float *val = lattice.getValues() + (size_t)vertex*vd;
+
+                pixVertices[(size_t)pix*(d + 1) + r] = vertex;
+                for (int c = 0; c < vd; c++)
+                    val[c] += w * value[c];
+            }
+        }
+    }
+
+    int numVertices = lattice.getNumVertices();
+    vector<float> blurred((size_t)numVertices*vd);
+    float *cur = lattice.getValues(), *next = &blurred[0];
+
+    for (int axis = 0; axis <= d; axis++)
+    {
+        parallel_for_(Range(0, numVertices), PermutohedralBlur_ParBody(lattice, cur, next, d, vd, axis));
+        std::swap(cur, next);
+    }
+
+    dst.create(src.size(), src.type());
+    parallel_for_(Range(0, src.rows), PermutohedralSlice_ParBody(src, dst, &pixVertices[0], &pixWeights[0], cur, d, vd));
+}
+
+}
+}
@@ -91,6 +91,42 @@ TEST(AdaptiveManifoldTest, SplatSurfaceAccuracy)
     }
 }
 
+TEST(AdaptiveManifoldTest, MultiThreadReproducibility)
+{
+    if (cv::getNumberOfCPUs() == 1)
+        return;
+
+    RNG rnd(0);
+    int prevThreads = cv::getNumThreads();
+
+    for (int i = 0; i < 3; i++)
+    {
+        Size sz(rnd.uniform(256, 512), rnd.uniform(256, 512));
+
+        Mat guide(sz, CV_MAKE_TYPE(CV_32F, rnd.uniform(1, 8)));
+        Mat src(sz, CV_MAKE_TYPE(CV_8U, rnd.uniform(1, 4)));
+        randu(guide, 0, 1);
+        randu(src, 0, 255);
+
+        double sigma_s = rnd.uniform(8.0, 64.0);
+        double sigma_r = rnd.uniform(0.1, 0.5);
+        bool adjust_outliers = (i % 2 == 1);
+
+        //the subtrees are forked at a fixed depth and their sums are merged in a fixed order
+        cv::setNumThreads(cv::getNumberOfCPUs());
+        Mat resMultithread;
+        amFilter(guide, src, resMultithread, sigma_s, sigma_r, adjust_outliers);
+
+        cv::setNumThreads(1);
+        Mat resSingleThread;
+        amFilter(guide, src, resSingleThread, sigma_s, sigma_r, adjust_outliers);
+
+        EXPECT_EQ(0, cvtest::norm(resSingleThread, resMultithread, NORM_INF));
+    }
+
+    cv::setNumThreads(prevThreads);
+}
+
 TEST(AdaptiveManifoldTest, AuthorsReferenceAccuracy)
 {
     String srcImgPath = "cv/edgefilter/kodim23.png";
@@ -163,6 +163,31 @@ INSTANTIATE_TEST_CASE_P(FullSet, DomainTransformTest,
     Combine(Values(szODD, szQVGA), ModeType::all(), SupportedTypes::all(), SupportedTypes::all())
 );
 
+TEST(DomainTransformTest, Depth16U_MatchesFloat)
+{
+    Mat original = imread(getOpenCVExtraDir() + "cv/edgefilter/statue.png");
+    ASSERT_FALSE(original.empty());
+
+    //the guide keeps its 8-bit values, so sigmaColor has the same meaning for both depths
+    Mat guide16, guide32, src16, src32;
+    Mat gray = convertTypeAndSize(original, CV_8UC1, szQVGA);
+    gray.convertTo(guide16, CV_16U);
+    gray.convertTo(guide32, CV_32F);
+    convertTypeAndSize(original, CV_8UC3, szQVGA).convertTo(src16, CV_16U, 257.0);
+    src16.convertTo(src32, CV_32F);
+
+    for (int mode = DTF_NC; mode <= DTF_RF; mode++)
+    {
+        Mat res16, res32;
+        dtFilter(guide16, src16, res16, 30.0, 20.0, mode);
+        dtFilter(guide32, src32, res32, 30.0, 20.0, mode);
+        res32.convertTo(res32, CV_16U);
+
+        ASSERT_EQ(CV_16UC3, res16.type());
+        EXPECT_LE(cv::norm(res16, res32, NORM_INF), 1.0) << "mode " << mode;
+    }
+}
+
 template<typename SrcVec>
 Mat getChessMat1px(Size sz, double whiteIntensity = 255)
 {
@@ -387,6 +387,65 @@ TEST_P(GuidedFilterTest, accuracy)
     }
 }
 
+TEST(GuidedFilterWorkspace, reuse_and_inplace)
+{
+    Mat guide = imread(getOpenCVExtraDir() + "cv/shared/lena.png");
+    ASSERT_FALSE(guide.empty());
+
+    Mat src1 = convertTypeAndSize(guide, CV_8UC1, guide.size());
+    Mat src3 = guide.clone();
+    Ptr<GuidedFilter> gf = createGuidedFilter(guide, 7, 100.0);
+
+    //the buffers left by a filtering of a different layout must not affect the result
+    Mat res1, res3, res1Again;
+    gf->filter(src1, res1);
+    gf->filter(src3, res3, CV_32F);
+    gf->filter(src1, res1Again);
+    EXPECT_EQ(0, cv::norm(res1, res1Again, NORM_INF));
+
+    Mat inplace = src1.clone();
+    gf->filter(inplace, inplace);
+    EXPECT_EQ(0, cv::norm(res1, inplace, NORM_INF));
+}
+
+TEST(GuidedFilterFast, close_to_full_resolution)
+{
+    Mat guide = imread(getOpenCVExtraDir() + "cv/shared/lena.png");
+    Mat src = imread(getOpenCVExtraDir() + "cv/shared/baboon.png");
+    ASSERT_TRUE(!guide.empty() && !src.empty());
+    resize(src, src, guide.size());
+
+    Mat res, resFast;
+    guidedFilter(guide, src, res, 8, 100.0);
+    guidedFilter(guide, src, resFast, 8, 100.0, -1, 2);
+
+    ASSERT_EQ(res.type(), resFast.type());
+    ASSERT_EQ(res.size(), resFast.size());
+    //RMS difference in gray levels, 3 is a PSNR of about 38.6 dB
+    double rms = cv::norm(res, resFast, NORM_L2) / sqrt((double)res.total() * res.channels());
+    EXPECT_LE(rms, 3.0);
+}
+
+TEST(GuidedFilterDepth16U, matches_float_source)
+{
+    Mat guide = imread(getOpenCVExtraDir() + "cv/shared/lena.png");
+    ASSERT_FALSE(guide.empty());
+
+    //16-bit source covering the full range, as depth maps do
+    Mat src16, src32;
+    convertTypeAndSize(guide, CV_8UC1, guide.size()).convertTo(src16, CV_16U, 257.0);
+    src16.convertTo(src32, CV_32F);
+
+    Ptr<GuidedFilter> gf = createGuidedFilter(guide, 7, 100.0);
+    Mat res16, res32;
+    gf->filter(src16, res16);
+    gf->filter(src32, res32);
+    res32.convertTo(res32, CV_16U);
+
+    ASSERT_EQ(CV_16UC1, res16.type());
+    EXPECT_LE(cv::norm(res16, res32, NORM_INF), 1.0);
+}
+
 INSTANTIATE_TEST_CASE_P(TypicalSet, GuidedFilterTest, 
     Combine(
     Values(1, 2, 3),
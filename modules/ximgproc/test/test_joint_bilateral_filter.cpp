@@ -289,4 +289,182 @@ INSTANTIATE_TEST_CASE_P(Set1, JointBilateralFilterTest_BilateralRef,
     )
 );
 
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+typedef tuple<int, int> JBFMultipleTestParam;
+typedef TestWithParam<JBFMultipleTestParam> JointBilateralFilterTest_Multiple;
+
+TEST_P(JointBilateralFilterTest_Multiple, MatchesSingleCalls)
+{
+    JBFMultipleTestParam param = GetParam();
+    int depth   = get<0>(param);
+    int jCn     = get<1>(param);
+
+    Size sz(160, 120);
+    RNG rnd(depth + 10*jCn);
+    Mat joint(sz, CV_MAKE_TYPE(depth, jCn));
+    rnd.fill(joint, RNG::UNIFORM, 0, 255);
+
+    //sources with the channel numbers of depth, confidence, labels, color and flow maps
+    int srcCns[] = {1, 1, 1, 3, 2};
+    vector<Mat> srcs;
+    for (size_t i = 0; i < sizeof(srcCns)/sizeof(srcCns[0]); i++)
+    {
+        Mat src(sz, CV_MAKE_TYPE(depth, srcCns[i]));
+        rnd.fill(src, RNG::UNIFORM, 0, 255);
+        srcs.push_back(src);
+    }
+
+    double sigmaC = 20.0, sigmaS = 5.0;
+    Ptr<JointBilateralFilter> jbf = createJointBilateralFilter(joint, 0, sigmaC, sigmaS);
+
+    cv::setNumThreads(cv::getNumberOfCPUs());
+    vector<Mat> dsts;
+    jbf->filterMultiple(srcs, dsts);
+    ASSERT_EQ(srcs.size(), dsts.size());
+
+    for (size_t i = 0; i < srcs.size(); i++)
+    {
+        Mat res, resFn;
+        jbf->filter(srcs[i], res);
+        ASSERT_EQ(srcs[i].type(), dsts[i].type());
+        EXPECT_EQ(0, cvtest::norm(dsts[i], res, NORM_INF)) << "source " << i;
+
+        if (srcs[i].channels() == 1 || srcs[i].channels() == 3)
+        {
+            jointBilateralFilter(joint, srcs[i], resFn, 0, sigmaC, sigmaS);
+            EXPECT_EQ(0, cvtest::norm(resFn, res, NORM_INF)) << "source " << i;
+        }
+    }
+    cv::setNumThreads(1);
+}
+
+INSTANTIATE_TEST_CASE_P(TypicalSet, JointBilateralFilterTest_Multiple,
+    Combine(
+    Values(CV_8U, CV_32F),
+    Values(1, 3))
+);
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+TEST(JointBilateralFilterTest_Depth16U, MatchesFloat)
+{
+    Size sz(160, 120);
+    RNG rnd(0x16);
+
+    for (int jCn = 1; jCn <= 3; jCn += 2)
+    {
+        Mat joint16(sz, CV_16UC(jCn)), src16(sz, CV_16UC1), joint32, src32;
+        rnd.fill(joint16, RNG::UNIFORM, 0, 4096);
+        rnd.fill(src16, RNG::UNIFORM, 0, 65536);
+        joint16.convertTo(joint32, CV_32F);
+        src16.convertTo(src32, CV_32F);
+
+        //both depths share the interpolated color weights table built over the guide range
+        Mat res16, res32;
+        jointBilateralFilter(joint16, src16, res16, 0, 300.0, 4.0);
+        jointBilateralFilter(joint32, src32, res32, 0, 300.0, 4.0);
+        res32.convertTo(res32, CV_16U);
+
+        ASSERT_EQ(CV_16UC1, res16.type());
+        EXPECT_LE(cvtest::norm(res16, res32, NORM_INF), 1.0) << "guide channels " << jCn;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+typedef tuple<int, int, int, int> JBFEngineTestParam;
+typedef TestWithParam<JBFEngineTestParam> JointBilateralFilterTest_FastEngines;
+
+TEST_P(JointBilateralFilterTest_FastEngines, StepEdgePreserved)
+{
+    JBFEngineTestParam param = GetParam();
+    int engine  = get<0>(param);
+    int depth   = get<1>(param);
+    int jCn     = get<2>(param);
+    int srcCn   = get<3>(param);
+
+    Size sz(320, 240);
+    Rect left(0, 0, sz.width / 2, sz.height), right(sz.width / 2, 0, sz.width - sz.width / 2, sz.height);
+
+    Mat joint(sz, CV_MAKE_TYPE(depth, jCn)), clean(sz, CV_MAKE_TYPE(CV_32F, srcCn)), noise(clean.size(), clean.type()), src;
+    joint(left).setTo(Scalar::all(40));
+    joint(right).setTo(Scalar::all(200));
+    clean(left).setTo(Scalar::all(60));
+    clean(right).setTo(Scalar::all(180));
+
+    //the noise of the source has to be smoothed out, the clean guide keeps the halves apart
+    const double noiseSigma = 8.0;
+    RNG rng(0x7531);
+    rng.fill(noise, RNG::NORMAL, 0.0, noiseSigma);
+    add(clean, noise, src);
+    src.convertTo(src, depth);
+
+    //the spatial kernel is far wider than the regions, but the guide step is 8 sigmaColor high
+    cv::setNumThreads(cv::getNumberOfCPUs());
+    Mat res;
+    jointBilateralFilter(joint, src, res, 0, 20.0, 64.0, BORDER_DEFAULT, engine);
+    ASSERT_EQ(src.type(), res.type());
+
+    Rect halves[] = { left, right };
+    double levels[] = { 60.0, 180.0 };
+    for (int h = 0; h < 2; h++)
+    {
+        Scalar mean, stddev;
+        meanStdDev(res(halves[h]), mean, stddev);
+        for (int c = 0; c < srcCn; c++)
+        {
+            EXPECT_NEAR(levels[h], mean[c], 1.0);
+            EXPECT_LE(stddev[c], noiseSigma / 4);
+        }
+    }
+
+    //the columns along the edge are not blended with the other half
+    Mat edgeColumns = res(Rect(left.width - 2, 0, 4, sz.height)), expected;
+    clean(Rect(left.width - 2, 0, 4, sz.height)).convertTo(expected, depth);
+    EXPECT_LE(cvtest::norm(edgeColumns, expected, NORM_INF), 4 * noiseSigma);
+}
+
+TEST(JointBilateralFilterTest_Grid, FallsBackToLatticeWhenTooLarge)
+{
+    Size sz(160, 120);
+    Mat joint(sz, CV_32FC3), src(sz, CV_32FC1);
+    RNG rng(0x2468);
+    rng.fill(joint, RNG::UNIFORM, 0.0, 1000.0);
+    rng.fill(src, RNG::UNIFORM, 0.0, 255.0);
+
+    //about 1000^3 cells, far over the memory limit of the grid
+    Mat resGrid, resLattice;
+    jointBilateralFilter(joint, src, resGrid, 0, 1.0, 8.0, BORDER_DEFAULT, JBF_BILATERAL_GRID);
+    jointBilateralFilter(joint, src, resLattice, 0, 1.0, 8.0, BORDER_DEFAULT, JBF_PERMUTOHEDRAL);
+
+    EXPECT_EQ(0, cvtest::norm(resGrid, resLattice, NORM_INF));
+}
+
+TEST(JointBilateralFilterTest_Grid, FallsBackToLatticeFor4ChannelGuide)
+{
+    Size sz(160, 120);
+    Mat joint(sz, CV_8UC4), src(sz, CV_8UC1);
+    RNG rng(0x1357);
+    rng.fill(joint, RNG::UNIFORM, 0, 256);
+    rng.fill(src, RNG::UNIFORM, 0, 256);
+
+    Mat resGrid, resLattice;
+    jointBilateralFilter(joint, src, resGrid, 0, 30.0, 8.0, BORDER_DEFAULT, JBF_BILATERAL_GRID);
+    jointBilateralFilter(joint, src, resLattice, 0, 30.0, 8.0, BORDER_DEFAULT, JBF_PERMUTOHEDRAL);
+
+    EXPECT_EQ(0, cvtest::norm(resGrid, resLattice, NORM_INF));
+}
+
+INSTANTIATE_TEST_CASE_P(TypicalSet, JointBilateralFilterTest_FastEngines,
+    Combine(
+    Values((int)JBF_BILATERAL_GRID, (int)JBF_PERMUTOHEDRAL),
+    Values(CV_8U, CV_32F),
+    Values(1, 3),
+    Values(1, 3))
+);
+
 }
\ No newline at end of file